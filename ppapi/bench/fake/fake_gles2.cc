@@ -0,0 +1,88 @@
+// No-op GLES2 entry points for the headless benchmark build. The headless
+// plugin never creates an mpv render context, so these only have to satisfy
+// the GL_CALLBACKS table in pepper.cc at link time.
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+void GL_APIENTRY glActiveTexture(GLenum) {}
+void GL_APIENTRY glAttachShader(GLuint, GLuint) {}
+void GL_APIENTRY glBeginQueryEXT(GLenum, GLuint) {}
+void GL_APIENTRY glBindAttribLocation(GLuint, GLuint, const GLchar*) {}
+void GL_APIENTRY glBindBuffer(GLenum, GLuint) {}
+void GL_APIENTRY glBindFramebuffer(GLenum, GLuint) {}
+void GL_APIENTRY glBindTexture(GLenum, GLuint) {}
+void GL_APIENTRY glBlendFuncSeparate(GLenum, GLenum, GLenum, GLenum) {}
+void GL_APIENTRY glBufferData(GLenum, GLsizeiptr, const void*, GLenum) {}
+void GL_APIENTRY glBufferSubData(GLenum, GLintptr, GLsizeiptr, const void*) {}
+GLenum GL_APIENTRY glCheckFramebufferStatus(GLenum) {
+  return 0;
+}
+void GL_APIENTRY glClear(GLbitfield) {}
+void GL_APIENTRY glClearColor(GLfloat, GLfloat, GLfloat, GLfloat) {}
+void GL_APIENTRY glCompileShader(GLuint) {}
+GLuint GL_APIENTRY glCreateProgram(void) {
+  return 0;
+}
+GLuint GL_APIENTRY glCreateShader(GLenum) {
+  return 0;
+}
+void GL_APIENTRY glDeleteBuffers(GLsizei, const GLuint*) {}
+void GL_APIENTRY glDeleteFramebuffers(GLsizei, const GLuint*) {}
+void GL_APIENTRY glDeleteProgram(GLuint) {}
+void GL_APIENTRY glDeleteQueriesEXT(GLsizei, const GLuint*) {}
+void GL_APIENTRY glDeleteShader(GLuint) {}
+void GL_APIENTRY glDeleteTextures(GLsizei, const GLuint*) {}
+void GL_APIENTRY glDisable(GLenum) {}
+void GL_APIENTRY glDisableVertexAttribArray(GLuint) {}
+void GL_APIENTRY glDrawArrays(GLenum, GLint, GLsizei) {}
+void GL_APIENTRY glEnable(GLenum) {}
+void GL_APIENTRY glEnableVertexAttribArray(GLuint) {}
+void GL_APIENTRY glEndQueryEXT(GLenum) {}
+void GL_APIENTRY glFinish(void) {}
+void GL_APIENTRY glFlush(void) {}
+void GL_APIENTRY glFramebufferTexture2D(GLenum, GLenum, GLenum, GLuint, GLint) {}
+void GL_APIENTRY glGenBuffers(GLsizei, GLuint*) {}
+void GL_APIENTRY glGenFramebuffers(GLsizei, GLuint*) {}
+void GL_APIENTRY glGenQueriesEXT(GLsizei, GLuint*) {}
+void GL_APIENTRY glGenTextures(GLsizei, GLuint*) {}
+GLint GL_APIENTRY glGetAttribLocation(GLuint, const GLchar*) {
+  return 0;
+}
+GLenum GL_APIENTRY glGetError(void) {
+  return 0;
+}
+void GL_APIENTRY glGetFramebufferAttachmentParameteriv(GLenum, GLenum, GLenum, GLint*) {}
+void GL_APIENTRY glGetIntegerv(GLenum, GLint*) {}
+void GL_APIENTRY glGetProgramInfoLog(GLuint, GLsizei, GLsizei*, GLchar*) {}
+void GL_APIENTRY glGetProgramiv(GLuint, GLenum, GLint*) {}
+void GL_APIENTRY glGetQueryObjectuivEXT(GLuint, GLenum, GLuint*) {}
+void GL_APIENTRY glGetShaderInfoLog(GLuint, GLsizei, GLsizei*, GLchar*) {}
+void GL_APIENTRY glGetShaderiv(GLuint, GLenum, GLint*) {}
+const GLubyte* GL_APIENTRY glGetString(GLenum) {
+  return reinterpret_cast<const GLubyte*>("");
+}
+GLint GL_APIENTRY glGetUniformLocation(GLuint, const GLchar*) {
+  return 0;
+}
+GLboolean GL_APIENTRY glIsQueryEXT(GLuint) {
+  return GL_FALSE;
+}
+void GL_APIENTRY glLinkProgram(GLuint) {}
+void GL_APIENTRY glPixelStorei(GLenum, GLint) {}
+void GL_APIENTRY glReadPixels(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void*) {}
+void GL_APIENTRY glScissor(GLint, GLint, GLsizei, GLsizei) {}
+void GL_APIENTRY glShaderSource(GLuint, GLsizei, const GLchar*const*, const GLint*) {}
+void GL_APIENTRY glTexImage2D(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*) {}
+void GL_APIENTRY glTexParameteri(GLenum, GLenum, GLint) {}
+void GL_APIENTRY glTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void*) {}
+void GL_APIENTRY glUniform1f(GLint, GLfloat) {}
+void GL_APIENTRY glUniform1i(GLint, GLint) {}
+void GL_APIENTRY glUniform2f(GLint, GLfloat, GLfloat) {}
+void GL_APIENTRY glUniform3f(GLint, GLfloat, GLfloat, GLfloat) {}
+void GL_APIENTRY glUniformMatrix2fv(GLint, GLsizei, GLboolean, const GLfloat*) {}
+void GL_APIENTRY glUniformMatrix3fv(GLint, GLsizei, GLboolean, const GLfloat*) {}
+void GL_APIENTRY glUseProgram(GLuint) {}
+void GL_APIENTRY glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) {}
+void GL_APIENTRY glViewport(GLint, GLint, GLsizei, GLsizei) {}
@@ -0,0 +1,811 @@
+#include "fake_ppapi.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "ppapi/c/ppb_var.h"
+#include "ppapi/cpp/core.h"
+#include "ppapi/cpp/graphics_2d.h"
+#include "ppapi/cpp/graphics_3d.h"
+#include "ppapi/cpp/image_data.h"
+#include "ppapi/cpp/instance.h"
+#include "ppapi/cpp/message_loop.h"
+#include "ppapi/cpp/module.h"
+#include "ppapi/cpp/tcp_socket.h"
+#include "ppapi/cpp/var_array.h"
+#include "ppapi/cpp/var_array_buffer.h"
+#include "ppapi/cpp/var_dictionary.h"
+#include "ppapi/lib/gl/gles2/gl2ext_ppapi.h"
+
+namespace fake_ppapi {
+namespace {
+
+struct Task {
+  pp::CompletionCallback callback;
+  int32_t result;
+  Clock::time_point queued_at;
+};
+
+// Ordered by (due time, sequence) so equal delays run FIFO.
+using TaskKey = std::tuple<Clock::time_point, uint64_t>;
+
+struct TaskQueue {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::map<TaskKey, Task> tasks;
+  uint64_t sequence = 0;
+  bool quit = false;
+  Clock::time_point current_queued_at;
+};
+
+struct MainLoop : TaskQueue {
+  std::thread::id main_thread = std::this_thread::get_id();
+};
+
+MainLoop& loop() {
+  static MainLoop instance;
+  return instance;
+}
+
+// The queue of the calling thread: the main loop, or the pp::MessageLoop
+// attached to a background thread.
+thread_local TaskQueue* t_queue = nullptr;
+
+TaskQueue& current_queue() {
+  return t_queue ? *t_queue : loop();
+}
+
+// Keeps the attached loop alive for MessageLoop::GetCurrent().
+thread_local std::shared_ptr<void> t_current_loop;
+
+MessageSink& sink() {
+  static MessageSink instance;
+  return instance;
+}
+
+std::atomic<int32_t> g_swap_interval{16};
+std::atomic<uint64_t> g_swap_count{0};
+std::atomic<PP_Resource> g_next_resource{1};
+
+std::mutex g_swap_observer_mutex;
+SwapObserver g_swap_observer;
+
+void Swapped() {
+  g_swap_count++;
+  std::lock_guard<std::mutex> lock(g_swap_observer_mutex);
+  if (g_swap_observer)
+    g_swap_observer();
+}
+
+void Post(TaskQueue& l,
+          int64_t delay_ms,
+          const pp::CompletionCallback& cb,
+          int32_t result) {
+  auto now = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(l.mutex);
+    l.tasks.emplace(TaskKey(now + std::chrono::milliseconds(delay_ms),
+                            l.sequence++),
+                    Task{cb, result, now});
+  }
+  l.cv.notify_one();
+}
+
+void Post(int64_t delay_ms, const pp::CompletionCallback& cb, int32_t result) {
+  Post(loop(), delay_ms, cb, result);
+}
+
+// Pops the next task due before |deadline|, waiting for it if necessary.
+// Returns false once |deadline| passes or the queue is told to quit.
+bool NextTask(TaskQueue& l, Clock::time_point deadline, Task* out) {
+  std::unique_lock<std::mutex> lock(l.mutex);
+  for (;;) {
+    if (l.quit)
+      return false;
+    auto now = Clock::now();
+    if (!l.tasks.empty()) {
+      auto it = l.tasks.begin();
+      auto due = std::get<0>(it->first);
+      if (due <= now) {
+        *out = std::move(it->second);
+        l.tasks.erase(it);
+        return true;
+      }
+      if (due < deadline) {
+        l.cv.wait_until(lock, due);
+        continue;
+      }
+    }
+    if (now >= deadline)
+      return false;
+    l.cv.wait_until(lock, deadline);
+  }
+}
+
+bool NextTask(Clock::time_point deadline, Task* out) {
+  return NextTask(loop(), deadline, out);
+}
+
+void RunTask(TaskQueue& l, const Task& task) {
+  l.current_queued_at = task.queued_at;
+  task.callback.Run(task.result);
+  l.current_queued_at = Clock::time_point();
+}
+
+void RunTask(const Task& task) {
+  RunTask(loop(), task);
+}
+
+}  // namespace
+
+void SetMessageSink(MessageSink s) {
+  sink() = std::move(s);
+}
+
+void SetSwapInterval(int32_t milliseconds) {
+  g_swap_interval = milliseconds;
+}
+
+void SetSwapObserver(SwapObserver observer) {
+  std::lock_guard<std::mutex> lock(g_swap_observer_mutex);
+  g_swap_observer = std::move(observer);
+}
+
+void RunUntil(Clock::time_point deadline, const std::function<bool()>& done) {
+  Task task;
+  while (!(done && done()) && NextTask(deadline, &task))
+    RunTask(task);
+}
+
+void RunUntilIdle() {
+  Task task;
+  while (NextTask(Clock::now(), &task))
+    RunTask(task);
+}
+
+Clock::time_point CurrentTaskQueuedAt() {
+  return loop().current_queued_at;
+}
+
+uint64_t SwapCount() {
+  return g_swap_count;
+}
+
+pp::View MakeView(int32_t width, int32_t height, bool visible) {
+  return pp::View(pp::Rect(0, 0, width, height), 1.0f, visible);
+}
+
+}  // namespace fake_ppapi
+
+namespace pp {
+
+namespace {
+
+Module* g_module = nullptr;
+
+using VarString = std::string;
+using VarArrayData = std::vector<Var>;
+using VarDictionaryData = std::map<std::string, Var>;
+using VarArrayBufferData = std::vector<uint8_t>;
+
+template <typename T>
+T* data_of(const std::shared_ptr<void>& ref) {
+  return static_cast<T*>(ref.get());
+}
+
+}  // namespace
+
+// Var
+
+Var::Var() = default;
+
+Var::Var(Null) : type_(Type::kNull) {}
+
+Var::Var(bool b) : type_(Type::kBool) {
+  value_.b = b;
+}
+
+Var::Var(int32_t i) : type_(Type::kInt) {
+  value_.i = i;
+}
+
+Var::Var(double d) : type_(Type::kDouble) {
+  value_.d = d;
+}
+
+Var::Var(const char* utf8_str) : Var(std::string(utf8_str ? utf8_str : "")) {}
+
+Var::Var(const std::string& utf8_str)
+    : type_(Type::kString), ref_(std::make_shared<VarString>(utf8_str)) {}
+
+bool Var::operator==(const Var& other) const {
+  if (type_ != other.type_)
+    return false;
+  switch (type_) {
+    case Type::kUndefined:
+    case Type::kNull:
+      return true;
+    case Type::kBool:
+      return value_.b == other.value_.b;
+    case Type::kInt:
+      return value_.i == other.value_.i;
+    case Type::kDouble:
+      return value_.d == other.value_.d;
+    case Type::kString:
+      return *data_of<VarString>(ref_) == *data_of<VarString>(other.ref_);
+    default:
+      return ref_ == other.ref_;
+  }
+}
+
+bool Var::AsBool() const {
+  return is_bool() && value_.b;
+}
+
+int32_t Var::AsInt() const {
+  if (is_int())
+    return value_.i;
+  if (is_double())
+    return static_cast<int32_t>(value_.d);
+  return 0;
+}
+
+double Var::AsDouble() const {
+  if (is_double())
+    return value_.d;
+  if (is_int())
+    return value_.i;
+  return 0.0;
+}
+
+std::string Var::AsString() const {
+  return is_string() ? *data_of<VarString>(ref_) : std::string();
+}
+
+std::string Var::DebugString() const {
+  switch (type_) {
+    case Type::kUndefined: return "Var(UNDEFINED)";
+    case Type::kNull: return "Var(NULL)";
+    case Type::kBool: return value_.b ? "Var(true)" : "Var(false)";
+    case Type::kInt: return "Var(" + std::to_string(value_.i) + ")";
+    case Type::kDouble: return "Var(" + std::to_string(value_.d) + ")";
+    case Type::kString: return "Var<'" + AsString() + "'>";
+    case Type::kArray: return "Var(ARRAY)";
+    case Type::kDictionary: return "Var(DICTIONARY)";
+    case Type::kArrayBuffer: return "Var(ARRAY_BUFFER)";
+  }
+  return "Var(?)";
+}
+
+PP_Var Var::pp_var() const {
+  PP_Var var{};
+  switch (type_) {
+    case Type::kUndefined: var.type = PP_VARTYPE_UNDEFINED; break;
+    case Type::kNull: var.type = PP_VARTYPE_NULL; break;
+    case Type::kBool: var.type = PP_VARTYPE_BOOL; var.value.as_bool = value_.b; break;
+    case Type::kInt: var.type = PP_VARTYPE_INT32; var.value.as_int = value_.i; break;
+    case Type::kDouble: var.type = PP_VARTYPE_DOUBLE; var.value.as_double = value_.d; break;
+    case Type::kString: var.type = PP_VARTYPE_STRING; break;
+    case Type::kArray: var.type = PP_VARTYPE_ARRAY; break;
+    case Type::kDictionary: var.type = PP_VARTYPE_DICTIONARY; break;
+    case Type::kArrayBuffer: var.type = PP_VARTYPE_ARRAY_BUFFER; break;
+  }
+  if (ref_)
+    var.value.as_id = reinterpret_cast<intptr_t>(ref_.get());
+  return var;
+}
+
+// VarArray
+
+VarArray::VarArray() {
+  type_ = Type::kArray;
+  ref_ = std::make_shared<VarArrayData>();
+}
+
+VarArray::VarArray(const Var& var) : Var(var) {
+  if (!var.is_array()) {
+    type_ = Type::kNull;
+    ref_.reset();
+  }
+}
+
+uint32_t VarArray::GetLength() const {
+  return ref_ ? static_cast<uint32_t>(data_of<VarArrayData>(ref_)->size()) : 0;
+}
+
+Var VarArray::Get(uint32_t index) const {
+  if (!ref_ || index >= GetLength())
+    return Var();
+  return (*data_of<VarArrayData>(ref_))[index];
+}
+
+bool VarArray::Set(uint32_t index, const Var& value) {
+  if (!ref_)
+    return false;
+  auto* values = data_of<VarArrayData>(ref_);
+  if (index >= values->size())
+    values->resize(index + 1);
+  (*values)[index] = value;
+  return true;
+}
+
+bool VarArray::SetLength(uint32_t length) {
+  if (!ref_)
+    return false;
+  data_of<VarArrayData>(ref_)->resize(length);
+  return true;
+}
+
+// VarDictionary
+
+VarDictionary::VarDictionary() {
+  type_ = Type::kDictionary;
+  ref_ = std::make_shared<VarDictionaryData>();
+}
+
+VarDictionary::VarDictionary(const Var& var) : Var(var) {
+  if (!var.is_dictionary()) {
+    type_ = Type::kNull;
+    ref_.reset();
+  }
+}
+
+Var VarDictionary::Get(const Var& key) const {
+  if (!ref_ || !key.is_string())
+    return Var();
+  auto* values = data_of<VarDictionaryData>(ref_);
+  auto it = values->find(key.AsString());
+  return it == values->end() ? Var() : it->second;
+}
+
+bool VarDictionary::Set(const Var& key, const Var& value) {
+  if (!ref_ || !key.is_string())
+    return false;
+  (*data_of<VarDictionaryData>(ref_))[key.AsString()] = value;
+  return true;
+}
+
+void VarDictionary::Delete(const Var& key) {
+  if (ref_ && key.is_string())
+    data_of<VarDictionaryData>(ref_)->erase(key.AsString());
+}
+
+bool VarDictionary::HasKey(const Var& key) const {
+  return ref_ && key.is_string() &&
+         data_of<VarDictionaryData>(ref_)->count(key.AsString()) > 0;
+}
+
+VarArray VarDictionary::GetKeys() const {
+  VarArray keys;
+  if (ref_) {
+    uint32_t i = 0;
+    for (const auto& entry : *data_of<VarDictionaryData>(ref_))
+      keys.Set(i++, Var(entry.first));
+  }
+  return keys;
+}
+
+// VarArrayBuffer
+
+VarArrayBuffer::VarArrayBuffer() : VarArrayBuffer(0u) {}
+
+VarArrayBuffer::VarArrayBuffer(const Var& var) : Var(var) {
+  if (!var.is_array_buffer()) {
+    type_ = Type::kNull;
+    ref_.reset();
+  }
+}
+
+VarArrayBuffer::VarArrayBuffer(uint32_t size_in_bytes) {
+  type_ = Type::kArrayBuffer;
+  ref_ = std::make_shared<VarArrayBufferData>(size_in_bytes);
+}
+
+uint32_t VarArrayBuffer::ByteLength() const {
+  return ref_ ? static_cast<uint32_t>(
+                    data_of<VarArrayBufferData>(ref_)->size())
+              : 0;
+}
+
+void* VarArrayBuffer::Map() {
+  return ref_ ? data_of<VarArrayBufferData>(ref_)->data() : nullptr;
+}
+
+// Core
+
+void Core::CallOnMainThread(int32_t delay_in_milliseconds,
+                            const CompletionCallback& callback,
+                            int32_t result) {
+  fake_ppapi::Post(delay_in_milliseconds, callback, result);
+}
+
+bool Core::IsMainThread() {
+  return std::this_thread::get_id() == fake_ppapi::loop().main_thread;
+}
+
+PP_Time Core::GetTime() {
+  return std::chrono::duration<double>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+PP_TimeTicks Core::GetTimeTicks() {
+  return std::chrono::duration<double>(
+             fake_ppapi::Clock::now().time_since_epoch())
+      .count();
+}
+
+// MessageLoop
+
+namespace {
+
+fake_ppapi::TaskQueue* queue_of(const std::shared_ptr<void>& ref) {
+  return static_cast<fake_ppapi::TaskQueue*>(ref.get());
+}
+
+}  // namespace
+
+MessageLoop::MessageLoop(const InstanceHandle&)
+    : queue_(std::make_shared<fake_ppapi::TaskQueue>()) {}
+
+MessageLoop MessageLoop::GetForMainThread() {
+  // The main loop lives forever; share it without ownership.
+  return MessageLoop(std::shared_ptr<void>(
+      std::shared_ptr<void>(), static_cast<void*>(&fake_ppapi::loop())));
+}
+
+MessageLoop MessageLoop::GetCurrent() {
+  if (Module::Get()->core()->IsMainThread())
+    return GetForMainThread();
+  return MessageLoop(fake_ppapi::t_current_loop);
+}
+
+int32_t MessageLoop::AttachToCurrentThread() {
+  if (!queue_ || fake_ppapi::t_queue ||
+      Module::Get()->core()->IsMainThread())
+    return PP_ERROR_INPROGRESS;
+  fake_ppapi::t_queue = queue_of(queue_);
+  fake_ppapi::t_current_loop = queue_;
+  return PP_OK;
+}
+
+int32_t MessageLoop::Run() {
+  fake_ppapi::TaskQueue* queue = queue_of(queue_);
+  if (!queue || fake_ppapi::t_queue != queue)
+    return PP_ERROR_BADRESOURCE;
+  fake_ppapi::Task task;
+  while (fake_ppapi::NextTask(*queue, fake_ppapi::Clock::time_point::max(),
+                              &task)) {
+    fake_ppapi::RunTask(*queue, task);
+  }
+
+  std::map<fake_ppapi::TaskKey, fake_ppapi::Task> aborted;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    aborted.swap(queue->tasks);
+    queue->quit = false;
+  }
+  for (auto& entry : aborted)
+    entry.second.callback.Run(PP_ERROR_ABORTED);
+  fake_ppapi::t_queue = nullptr;
+  fake_ppapi::t_current_loop.reset();
+  return PP_OK;
+}
+
+int32_t MessageLoop::PostWork(const CompletionCallback& callback,
+                              int64_t delay_ms) {
+  fake_ppapi::TaskQueue* queue = queue_of(queue_);
+  if (!queue)
+    return PP_ERROR_BADRESOURCE;
+  fake_ppapi::Post(*queue, delay_ms, callback, PP_OK);
+  return PP_OK;
+}
+
+int32_t MessageLoop::PostQuit(bool) {
+  fake_ppapi::TaskQueue* queue = queue_of(queue_);
+  if (!queue || queue == &fake_ppapi::loop())
+    return PP_ERROR_BADRESOURCE;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->quit = true;
+  }
+  queue->cv.notify_all();
+  return PP_OK;
+}
+
+// Module
+
+Module::Module() {
+  g_module = this;
+  // The module is created on the main thread; pin it before plugin
+  // threads start asking IsMainThread().
+  fake_ppapi::loop();
+}
+
+Module::~Module() {
+  if (g_module == this)
+    g_module = nullptr;
+}
+
+Module* Module::Get() {
+  return g_module;
+}
+
+namespace {
+
+void VarAddRef(PP_Var) {}
+
+void VarRelease(PP_Var) {}
+
+PP_Var VarFromUtf8(const char*, uint32_t) {
+  // Would need to own the string; pepper.cc never creates vars this way.
+  return PP_Var{};
+}
+
+const char* VarToUtf8(PP_Var var, uint32_t* len) {
+  if (var.type != PP_VARTYPE_STRING) {
+    *len = 0;
+    return nullptr;
+  }
+  auto* str = reinterpret_cast<VarString*>(var.value.as_id);
+  *len = static_cast<uint32_t>(str->size());
+  return str->data();
+}
+
+const PPB_Var kVarInterface = {
+  &VarAddRef,
+  &VarRelease,
+  &VarFromUtf8,
+  &VarToUtf8,
+};
+
+}  // namespace
+
+static const void* GetInterface(const char* interface_name) {
+  if (!strcmp(interface_name, PPB_VAR_INTERFACE))
+    return &kVarInterface;
+  return nullptr;
+}
+
+PPB_GetInterface Module::get_browser_interface() const {
+  return &GetInterface;
+}
+
+const void* Module::GetBrowserInterface(const char* interface_name) {
+  return GetInterface(interface_name);
+}
+
+// Instance
+
+InstanceHandle::InstanceHandle(Instance* instance)
+    : pp_instance_(instance->pp_instance()) {}
+
+Instance::Instance(PP_Instance instance) : pp_instance_(instance) {}
+
+Instance::~Instance() = default;
+
+bool Instance::BindGraphics(const Graphics2D& graphics) {
+  return !graphics.is_null();
+}
+
+bool Instance::BindGraphics(const Graphics3D& graphics) {
+  return !graphics.is_null();
+}
+
+int32_t Instance::RequestInputEvents(uint32_t) {
+  return PP_OK;
+}
+
+int32_t Instance::RequestFilteringInputEvents(uint32_t) {
+  return PP_OK;
+}
+
+void Instance::ClearInputEventRequest(uint32_t) {}
+
+void Instance::PostMessage(const Var& message) {
+  if (fake_ppapi::sink())
+    fake_ppapi::sink()(pp_instance_, message);
+}
+
+// ImageData
+
+ImageData::ImageData(const InstanceHandle&,
+                     PP_ImageDataFormat format,
+                     const Size& size,
+                     bool init_to_zero)
+    : format_(format), size_(size) {
+  if (size.IsEmpty())
+    return;
+  pixels_ = std::make_shared<std::vector<uint8_t>>(
+      static_cast<size_t>(size.width()) * size.height() * 4);
+  if (!init_to_zero)
+    std::fill(pixels_->begin(), pixels_->end(), 0xcd);
+}
+
+// Graphics2D
+
+Graphics2D::Graphics2D(const InstanceHandle&, const Size& size, bool)
+    : resource_(size.IsEmpty() ? 0 : fake_ppapi::g_next_resource++),
+      size_(size) {}
+
+void Graphics2D::PaintImageData(const ImageData&, const Point&, const Rect&) {}
+
+int32_t Graphics2D::Flush(const CompletionCallback& cc) {
+  fake_ppapi::Swapped();
+  fake_ppapi::Post(fake_ppapi::current_queue(), fake_ppapi::g_swap_interval,
+                   cc, PP_OK);
+  return PP_OK_COMPLETIONPENDING;
+}
+
+bool Graphics2D::SetScale(float scale) {
+  return scale > 0;
+}
+
+// Graphics3D
+
+Graphics3D::Graphics3D(const InstanceHandle&, const int32_t[])
+    : resource_(fake_ppapi::g_next_resource++) {}
+
+int32_t Graphics3D::ResizeBuffers(int32_t width, int32_t height) {
+  return width < 0 || height < 0 ? PP_ERROR_BADARGUMENT : PP_OK;
+}
+
+int32_t Graphics3D::SwapBuffers(const CompletionCallback& cc) {
+  fake_ppapi::Swapped();
+  fake_ppapi::Post(fake_ppapi::current_queue(), fake_ppapi::g_swap_interval,
+                   cc, PP_OK);
+  return PP_OK_COMPLETIONPENDING;
+}
+
+// TCPSocket
+
+namespace {
+
+// The OS socket, shared with the helper threads of pending calls.
+struct Socket {
+  std::atomic<int> fd{-1};
+  std::atomic<bool> closed{false};
+
+  void Close() {
+    closed = true;
+    int old = fd.exchange(-1);
+    if (old >= 0) {
+      shutdown(old, SHUT_RDWR);
+      close(old);
+    }
+  }
+};
+
+// Runs |work| on its own thread, completes with its result on the main
+// loop.
+int32_t Complete(std::function<int32_t()> work,
+                 const CompletionCallback& callback) {
+  std::thread([work, callback] {
+    fake_ppapi::Post(0, callback, work());
+  }).detach();
+  return PP_OK_COMPLETIONPENDING;
+}
+
+}  // namespace
+
+// Shared by copies of the TCPSocket; the socket closes with the last one,
+// like a resource whose last reference went away. Pending calls then fail.
+struct TCPSocket::State {
+  std::shared_ptr<Socket> socket = std::make_shared<Socket>();
+  ~State() { socket->Close(); }
+};
+
+TCPSocket::TCPSocket(const InstanceHandle&)
+    : state_(std::make_shared<State>()) {}
+
+TCPSocket::~TCPSocket() = default;
+
+int32_t TCPSocket::Connect(const NetAddress& addr,
+                           const CompletionCallback& callback) {
+  PP_NetAddress_IPv4 ipv4;
+  if (!state_ || !addr.DescribeAsIPv4Address(&ipv4))
+    return PP_ERROR_BADARGUMENT;
+  std::shared_ptr<Socket> socket = state_->socket;
+  return Complete([socket, ipv4]() -> int32_t {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = ipv4.port;
+    memcpy(&sa.sin_addr, ipv4.addr, 4);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) < 0) {
+      close(fd);
+      return PP_ERROR_CONNECTION_REFUSED;
+    }
+    socket->fd = fd;
+    if (socket->closed) {
+      socket->Close();
+      return PP_ERROR_ABORTED;
+    }
+    return PP_OK;
+  }, callback);
+}
+
+int32_t TCPSocket::Read(char* buffer,
+                        int32_t bytes_to_read,
+                        const CompletionCallback& callback) {
+  if (!state_ || state_->socket->fd < 0)
+    return PP_ERROR_FAILED;
+  std::shared_ptr<Socket> socket = state_->socket;
+  int fd = socket->fd;
+  return Complete([socket, fd, buffer, bytes_to_read]() -> int32_t {
+    ssize_t n = recv(fd, buffer, bytes_to_read, 0);
+    if (socket->closed)
+      return PP_ERROR_ABORTED;
+    return n < 0 ? PP_ERROR_CONNECTION_RESET : static_cast<int32_t>(n);
+  }, callback);
+}
+
+int32_t TCPSocket::Write(const char* buffer,
+                         int32_t bytes_to_write,
+                         const CompletionCallback& callback) {
+  if (!state_ || state_->socket->fd < 0)
+    return PP_ERROR_FAILED;
+  std::shared_ptr<Socket> socket = state_->socket;
+  int fd = socket->fd;
+  return Complete([socket, fd, buffer, bytes_to_write]() -> int32_t {
+    ssize_t n = send(fd, buffer, bytes_to_write, MSG_NOSIGNAL);
+    if (socket->closed)
+      return PP_ERROR_ABORTED;
+    return n < 0 ? PP_ERROR_CONNECTION_RESET : static_cast<int32_t>(n);
+  }, callback);
+}
+
+void TCPSocket::Close() {
+  if (state_)
+    state_->socket->Close();
+}
+
+int32_t TCPSocket::SetOption(PP_TCPSocket_Option name,
+                             const Var& value,
+                             const CompletionCallback& callback) {
+  if (!state_ || state_->socket->fd < 0)
+    return PP_ERROR_FAILED;
+  if (name == PP_TCPSOCKET_OPTION_NO_DELAY) {
+    int flag = value.AsBool() ? 1 : 0;
+    setsockopt(state_->socket->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+  }
+  fake_ppapi::Post(0, callback, PP_OK);
+  return PP_OK_COMPLETIONPENDING;
+}
+
+}  // namespace pp
+
+// gl2ext_ppapi
+
+GLboolean GL_APIENTRY glInitializePPAPI(PPB_GetInterface) {
+  return GL_TRUE;
+}
+
+GLboolean GL_APIENTRY glTerminatePPAPI(void) {
+  return GL_TRUE;
+}
+
+// Per thread, like the real library.
+static thread_local PP_Resource g_current_context = 0;
+
+void GL_APIENTRY glSetCurrentContextPPAPI(PP_Resource context) {
+  g_current_context = context;
+}
+
+PP_Resource GL_APIENTRY glGetCurrentContextPPAPI(void) {
+  return g_current_context;
+}
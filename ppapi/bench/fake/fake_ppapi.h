@@ -0,0 +1,47 @@
+// Harness-side controls for the fake PPAPI layer. The plugin code never
+// includes this file; it only sees the ppapi/ headers next to it.
+
+#ifndef FAKE_PPAPI_FAKE_PPAPI_H_
+#define FAKE_PPAPI_FAKE_PPAPI_H_
+
+#include <chrono>
+#include <functional>
+
+#include "ppapi/cpp/var.h"
+#include "ppapi/cpp/view.h"
+
+namespace fake_ppapi {
+
+using Clock = std::chrono::steady_clock;
+
+// Receives every pp::Instance::PostMessage() call.
+using MessageSink = std::function<void(PP_Instance, const pp::Var&)>;
+void SetMessageSink(MessageSink sink);
+
+// Delay before Graphics3D::SwapBuffers() or Graphics2D::Flush() completes,
+// in milliseconds.
+void SetSwapInterval(int32_t milliseconds);
+
+// Called from whichever thread swaps or flushes, before the completion is
+// queued.
+using SwapObserver = std::function<void()>;
+void SetSwapObserver(SwapObserver observer);
+
+// Runs main-thread callbacks until |deadline| or |done| returns true.
+void RunUntil(Clock::time_point deadline,
+              const std::function<bool()>& done = nullptr);
+// Runs every callback that is already due, then returns.
+void RunUntilIdle();
+
+// Time at which the main-thread callback currently running was queued, i.e.
+// when the plugin asked to be woken up. Clock::time_point() outside a task.
+Clock::time_point CurrentTaskQueuedAt();
+
+// Number of SwapBuffers() and Flush() calls since start.
+uint64_t SwapCount();
+
+pp::View MakeView(int32_t width, int32_t height, bool visible = true);
+
+}  // namespace fake_ppapi
+
+#endif  // FAKE_PPAPI_FAKE_PPAPI_H_
@@ -0,0 +1,36 @@
+// Fake PPAPI C types for the headless benchmark build.
+// Only the subset referenced by pepper.cc is declared here.
+
+#ifndef FAKE_PPAPI_C_PP_TYPES_H_
+#define FAKE_PPAPI_C_PP_TYPES_H_
+
+#include <stdint.h>
+
+typedef int32_t PP_Instance;
+typedef int32_t PP_Resource;
+typedef double PP_Time;
+typedef double PP_TimeTicks;
+
+typedef const void* (*PPB_GetInterface)(const char* interface_name);
+
+enum {
+  PP_OK = 0,
+  PP_OK_COMPLETIONPENDING = -1,
+  PP_ERROR_FAILED = -2,
+  PP_ERROR_ABORTED = -3,
+  PP_ERROR_BADARGUMENT = -4,
+  PP_ERROR_BADRESOURCE = -5,
+  PP_ERROR_INPROGRESS = -11,
+  PP_ERROR_CONNECTION_CLOSED = -100,
+  PP_ERROR_CONNECTION_RESET = -101,
+  PP_ERROR_CONNECTION_REFUSED = -102,
+  PP_ERROR_CONNECTION_FAILED = -104,
+};
+
+enum {
+  PP_GRAPHICS3DATTRIB_ALPHA_SIZE = 0x3021,
+  PP_GRAPHICS3DATTRIB_DEPTH_SIZE = 0x3025,
+  PP_GRAPHICS3DATTRIB_NONE = 0x3038,
+};
+
+#endif  // FAKE_PPAPI_C_PP_TYPES_H_
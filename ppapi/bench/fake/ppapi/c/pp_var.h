@@ -0,0 +1,34 @@
+#ifndef FAKE_PPAPI_C_PP_VAR_H_
+#define FAKE_PPAPI_C_PP_VAR_H_
+
+#include "ppapi/c/pp_types.h"
+
+typedef enum {
+  PP_VARTYPE_UNDEFINED = 0,
+  PP_VARTYPE_NULL = 1,
+  PP_VARTYPE_BOOL = 2,
+  PP_VARTYPE_INT32 = 3,
+  PP_VARTYPE_DOUBLE = 4,
+  PP_VARTYPE_STRING = 5,
+  PP_VARTYPE_OBJECT = 6,
+  PP_VARTYPE_ARRAY = 7,
+  PP_VARTYPE_DICTIONARY = 8,
+  PP_VARTYPE_ARRAY_BUFFER = 9,
+  PP_VARTYPE_RESOURCE = 10,
+} PP_VarType;
+
+union PP_VarValue {
+  int32_t as_bool;
+  int32_t as_int;
+  double as_double;
+  int64_t as_id;
+};
+
+// In the fake, as_id of reference types is the address of the payload.
+struct PP_Var {
+  PP_VarType type;
+  int32_t padding;
+  union PP_VarValue value;
+};
+
+#endif  // FAKE_PPAPI_C_PP_VAR_H_
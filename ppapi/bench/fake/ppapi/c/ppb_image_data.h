@@ -0,0 +1,9 @@
+#ifndef FAKE_PPAPI_C_PPB_IMAGE_DATA_H_
+#define FAKE_PPAPI_C_PPB_IMAGE_DATA_H_
+
+typedef enum {
+  PP_IMAGEDATAFORMAT_BGRA_PREMUL,
+  PP_IMAGEDATAFORMAT_RGBA_PREMUL
+} PP_ImageDataFormat;
+
+#endif  // FAKE_PPAPI_C_PPB_IMAGE_DATA_H_
@@ -0,0 +1,13 @@
+// Fake PPB_NetAddress types for the headless benchmark build.
+
+#ifndef FAKE_PPAPI_C_PPB_NET_ADDRESS_H_
+#define FAKE_PPAPI_C_PPB_NET_ADDRESS_H_
+
+#include <stdint.h>
+
+struct PP_NetAddress_IPv4 {
+  uint16_t port;  // network byte order
+  uint8_t addr[4];
+};
+
+#endif  // FAKE_PPAPI_C_PPB_NET_ADDRESS_H_
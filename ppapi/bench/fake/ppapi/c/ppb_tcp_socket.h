@@ -0,0 +1,12 @@
+// Fake PPB_TCPSocket types for the headless benchmark build.
+
+#ifndef FAKE_PPAPI_C_PPB_TCP_SOCKET_H_
+#define FAKE_PPAPI_C_PPB_TCP_SOCKET_H_
+
+typedef enum {
+  PP_TCPSOCKET_OPTION_NO_DELAY = 0,
+  PP_TCPSOCKET_OPTION_SEND_BUFFER_SIZE = 1,
+  PP_TCPSOCKET_OPTION_RECV_BUFFER_SIZE = 2,
+} PP_TCPSocket_Option;
+
+#endif  // FAKE_PPAPI_C_PPB_TCP_SOCKET_H_
@@ -0,0 +1,18 @@
+#ifndef FAKE_PPAPI_C_PPB_VAR_H_
+#define FAKE_PPAPI_C_PPB_VAR_H_
+
+#include "ppapi/c/pp_var.h"
+
+#define PPB_VAR_INTERFACE_1_2 "PPB_Var;1.2"
+#define PPB_VAR_INTERFACE PPB_VAR_INTERFACE_1_2
+
+struct PPB_Var_1_2 {
+  void (*AddRef)(struct PP_Var var);
+  void (*Release)(struct PP_Var var);
+  struct PP_Var (*VarFromUtf8)(const char* data, uint32_t len);
+  const char* (*VarToUtf8)(struct PP_Var var, uint32_t* len);
+};
+
+typedef struct PPB_Var_1_2 PPB_Var;
+
+#endif  // FAKE_PPAPI_C_PPB_VAR_H_
@@ -0,0 +1,30 @@
+#ifndef FAKE_PPAPI_CPP_COMPLETION_CALLBACK_H_
+#define FAKE_PPAPI_CPP_COMPLETION_CALLBACK_H_
+
+#include <functional>
+#include <utility>
+
+#include "ppapi/c/pp_types.h"
+
+namespace pp {
+
+class CompletionCallback {
+ public:
+  CompletionCallback() = default;
+  explicit CompletionCallback(std::function<void(int32_t)> fn)
+      : fn_(std::move(fn)) {}
+
+  void Run(int32_t result) const {
+    if (fn_)
+      fn_(result);
+  }
+
+  bool IsOptional() const { return !fn_; }
+
+ private:
+  std::function<void(int32_t)> fn_;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_COMPLETION_CALLBACK_H_
@@ -0,0 +1,23 @@
+#ifndef FAKE_PPAPI_CPP_CORE_H_
+#define FAKE_PPAPI_CPP_CORE_H_
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/cpp/completion_callback.h"
+
+namespace pp {
+
+// Main-thread callbacks are queued on the fake main loop driven by
+// fake_ppapi::RunUntil(); see fake_ppapi.h.
+class Core {
+ public:
+  void CallOnMainThread(int32_t delay_in_milliseconds,
+                        const CompletionCallback& callback,
+                        int32_t result = 0);
+  bool IsMainThread();
+  PP_Time GetTime();
+  PP_TimeTicks GetTimeTicks();
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_CORE_H_
@@ -0,0 +1,39 @@
+#ifndef FAKE_PPAPI_CPP_GRAPHICS_2D_H_
+#define FAKE_PPAPI_CPP_GRAPHICS_2D_H_
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/cpp/image_data.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/cpp/point.h"
+#include "ppapi/cpp/rect.h"
+
+namespace pp {
+
+// Flush completes like Graphics3D::SwapBuffers, after the swap interval,
+// and counts as a swap.
+class Graphics2D {
+ public:
+  Graphics2D() = default;
+  Graphics2D(const InstanceHandle& instance,
+             const Size& size,
+             bool is_always_opaque);
+
+  void PaintImageData(const ImageData& image,
+                      const Point& top_left,
+                      const Rect& src_rect);
+  int32_t Flush(const CompletionCallback& cc);
+  bool SetScale(float scale);
+
+  const Size& size() const { return size_; }
+  PP_Resource pp_resource() const { return resource_; }
+  bool is_null() const { return resource_ == 0; }
+
+ private:
+  PP_Resource resource_{0};
+  Size size_;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_GRAPHICS_2D_H_
@@ -0,0 +1,29 @@
+#ifndef FAKE_PPAPI_CPP_GRAPHICS_3D_H_
+#define FAKE_PPAPI_CPP_GRAPHICS_3D_H_
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/cpp/instance_handle.h"
+
+namespace pp {
+
+// SwapBuffers completes on the fake main loop after the interval set by
+// fake_ppapi::SetSwapInterval(), standing in for the compositor's vsync.
+class Graphics3D {
+ public:
+  Graphics3D() = default;
+  Graphics3D(const InstanceHandle& instance, const int32_t attrib_list[]);
+
+  int32_t ResizeBuffers(int32_t width, int32_t height);
+  int32_t SwapBuffers(const CompletionCallback& cc);
+
+  PP_Resource pp_resource() const { return resource_; }
+  bool is_null() const { return resource_ == 0; }
+
+ private:
+  PP_Resource resource_{0};
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_GRAPHICS_3D_H_
@@ -0,0 +1,40 @@
+#ifndef FAKE_PPAPI_CPP_IMAGE_DATA_H_
+#define FAKE_PPAPI_CPP_IMAGE_DATA_H_
+
+#include <memory>
+#include <vector>
+
+#include "ppapi/c/ppb_image_data.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/cpp/rect.h"
+
+namespace pp {
+
+// Heap backed; copies share the pixels like the real resource.
+class ImageData {
+ public:
+  ImageData() = default;
+  ImageData(const InstanceHandle& instance,
+            PP_ImageDataFormat format,
+            const Size& size,
+            bool init_to_zero);
+
+  static PP_ImageDataFormat GetNativeImageDataFormat() {
+    return PP_IMAGEDATAFORMAT_BGRA_PREMUL;
+  }
+
+  bool is_null() const { return !pixels_; }
+  PP_ImageDataFormat format() const { return format_; }
+  Size size() const { return size_; }
+  int32_t stride() const { return size_.width() * 4; }
+  void* data() const { return pixels_ ? pixels_->data() : nullptr; }
+
+ private:
+  PP_ImageDataFormat format_{PP_IMAGEDATAFORMAT_BGRA_PREMUL};
+  Size size_;
+  std::shared_ptr<std::vector<uint8_t>> pixels_;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_IMAGE_DATA_H_
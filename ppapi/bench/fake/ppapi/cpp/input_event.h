@@ -0,0 +1,158 @@
+#ifndef FAKE_PPAPI_CPP_INPUT_EVENT_H_
+#define FAKE_PPAPI_CPP_INPUT_EVENT_H_
+
+#include <memory>
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/cpp/point.h"
+#include "ppapi/cpp/var.h"
+
+typedef enum {
+  PP_INPUTEVENT_TYPE_UNDEFINED = -1,
+  PP_INPUTEVENT_TYPE_MOUSEDOWN = 0,
+  PP_INPUTEVENT_TYPE_MOUSEUP = 1,
+  PP_INPUTEVENT_TYPE_MOUSEMOVE = 2,
+  PP_INPUTEVENT_TYPE_MOUSEENTER = 3,
+  PP_INPUTEVENT_TYPE_MOUSELEAVE = 4,
+  PP_INPUTEVENT_TYPE_WHEEL = 5,
+  PP_INPUTEVENT_TYPE_RAWKEYDOWN = 6,
+  PP_INPUTEVENT_TYPE_KEYDOWN = 7,
+  PP_INPUTEVENT_TYPE_KEYUP = 8,
+  PP_INPUTEVENT_TYPE_CHAR = 9,
+} PP_InputEvent_Type;
+
+typedef enum {
+  PP_INPUTEVENT_MODIFIER_SHIFTKEY = 1 << 0,
+  PP_INPUTEVENT_MODIFIER_CONTROLKEY = 1 << 1,
+  PP_INPUTEVENT_MODIFIER_ALTKEY = 1 << 2,
+  PP_INPUTEVENT_MODIFIER_METAKEY = 1 << 3,
+  PP_INPUTEVENT_MODIFIER_ISKEYPAD = 1 << 4,
+  PP_INPUTEVENT_MODIFIER_ISAUTOREPEAT = 1 << 5,
+  PP_INPUTEVENT_MODIFIER_LEFTBUTTONDOWN = 1 << 6,
+  PP_INPUTEVENT_MODIFIER_MIDDLEBUTTONDOWN = 1 << 7,
+  PP_INPUTEVENT_MODIFIER_RIGHTBUTTONDOWN = 1 << 8,
+} PP_InputEvent_Modifier;
+
+typedef enum {
+  PP_INPUTEVENT_MOUSEBUTTON_NONE = -1,
+  PP_INPUTEVENT_MOUSEBUTTON_LEFT = 0,
+  PP_INPUTEVENT_MOUSEBUTTON_MIDDLE = 1,
+  PP_INPUTEVENT_MOUSEBUTTON_RIGHT = 2,
+} PP_InputEvent_MouseButton;
+
+typedef enum {
+  PP_INPUTEVENT_CLASS_MOUSE = 1 << 0,
+  PP_INPUTEVENT_CLASS_KEYBOARD = 1 << 1,
+  PP_INPUTEVENT_CLASS_WHEEL = 1 << 2,
+} PP_InputEvent_Class;
+
+namespace pp {
+
+// One struct holds the fields of every event class; the typed wrappers
+// read theirs, like the resource behind the real ones.
+class InputEvent {
+ public:
+  struct Data {
+    PP_InputEvent_Type type{PP_INPUTEVENT_TYPE_UNDEFINED};
+    PP_TimeTicks time{0};
+    uint32_t modifiers{0};
+    PP_InputEvent_MouseButton button{PP_INPUTEVENT_MOUSEBUTTON_NONE};
+    Point position;
+    int32_t click_count{0};
+    Point movement;
+    FloatPoint delta;
+    FloatPoint ticks;
+    bool scroll_by_page{false};
+    uint32_t key_code{0};
+    Var text;
+  };
+
+  InputEvent() = default;
+  explicit InputEvent(PP_InputEvent_Type type)
+      : data_(std::make_shared<Data>()) {
+    data_->type = type;
+  }
+
+  PP_InputEvent_Type GetType() const {
+    return data_ ? data_->type : PP_INPUTEVENT_TYPE_UNDEFINED;
+  }
+  PP_TimeTicks GetTimeStamp() const { return data_ ? data_->time : 0; }
+  uint32_t GetModifiers() const { return data_ ? data_->modifiers : 0; }
+  bool is_null() const { return !data_; }
+
+ protected:
+  std::shared_ptr<Data> data_;
+};
+
+class MouseInputEvent : public InputEvent {
+ public:
+  explicit MouseInputEvent(const InputEvent& event) : InputEvent(event) {}
+  MouseInputEvent(const InstanceHandle&,
+                  PP_InputEvent_Type type,
+                  PP_TimeTicks time_stamp,
+                  uint32_t modifiers,
+                  PP_InputEvent_MouseButton mouse_button,
+                  const Point& mouse_position,
+                  int32_t click_count,
+                  const Point& mouse_movement)
+      : InputEvent(type) {
+    data_->time = time_stamp;
+    data_->modifiers = modifiers;
+    data_->button = mouse_button;
+    data_->position = mouse_position;
+    data_->click_count = click_count;
+    data_->movement = mouse_movement;
+  }
+
+  PP_InputEvent_MouseButton GetButton() const { return data_->button; }
+  Point GetPosition() const { return data_->position; }
+  int32_t GetClickCount() const { return data_->click_count; }
+  Point GetMovement() const { return data_->movement; }
+};
+
+class WheelInputEvent : public InputEvent {
+ public:
+  explicit WheelInputEvent(const InputEvent& event) : InputEvent(event) {}
+  WheelInputEvent(const InstanceHandle&,
+                  PP_TimeTicks time_stamp,
+                  uint32_t modifiers,
+                  const FloatPoint& wheel_delta,
+                  const FloatPoint& wheel_ticks,
+                  bool scroll_by_page)
+      : InputEvent(PP_INPUTEVENT_TYPE_WHEEL) {
+    data_->time = time_stamp;
+    data_->modifiers = modifiers;
+    data_->delta = wheel_delta;
+    data_->ticks = wheel_ticks;
+    data_->scroll_by_page = scroll_by_page;
+  }
+
+  FloatPoint GetDelta() const { return data_->delta; }
+  FloatPoint GetTicks() const { return data_->ticks; }
+  bool GetScrollByPage() const { return data_->scroll_by_page; }
+};
+
+class KeyboardInputEvent : public InputEvent {
+ public:
+  explicit KeyboardInputEvent(const InputEvent& event) : InputEvent(event) {}
+  KeyboardInputEvent(const InstanceHandle&,
+                     PP_InputEvent_Type type,
+                     PP_TimeTicks time_stamp,
+                     uint32_t modifiers,
+                     uint32_t key_code,
+                     const Var& character_text)
+      : InputEvent(type) {
+    data_->time = time_stamp;
+    data_->modifiers = modifiers;
+    data_->key_code = key_code;
+    data_->text = character_text;
+  }
+
+  uint32_t GetKeyCode() const { return data_->key_code; }
+  Var GetCharacterText() const { return data_->text; }
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_INPUT_EVENT_H_
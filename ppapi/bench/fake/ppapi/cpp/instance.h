@@ -0,0 +1,44 @@
+#ifndef FAKE_PPAPI_CPP_INSTANCE_H_
+#define FAKE_PPAPI_CPP_INSTANCE_H_
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/cpp/graphics_2d.h"
+#include "ppapi/cpp/graphics_3d.h"
+#include "ppapi/cpp/input_event.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/cpp/var.h"
+#include "ppapi/cpp/view.h"
+
+namespace pp {
+
+class Instance {
+ public:
+  explicit Instance(PP_Instance instance);
+  virtual ~Instance();
+
+  PP_Instance pp_instance() const { return pp_instance_; }
+
+  virtual bool Init(uint32_t argc, const char* argn[], const char* argv[]) {
+    return true;
+  }
+  virtual void DidChangeView(const View& view) {}
+  virtual void DidChangeFocus(bool has_focus) {}
+  virtual bool HandleInputEvent(const InputEvent& event) { return false; }
+  virtual void HandleMessage(const Var& message) {}
+
+  bool BindGraphics(const Graphics2D& graphics);
+  bool BindGraphics(const Graphics3D& graphics);
+  int32_t RequestInputEvents(uint32_t event_classes);
+  int32_t RequestFilteringInputEvents(uint32_t event_classes);
+  void ClearInputEventRequest(uint32_t event_classes);
+
+  // Delivered to the sink installed with fake_ppapi::SetMessageSink().
+  void PostMessage(const Var& message);
+
+ private:
+  PP_Instance pp_instance_;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_INSTANCE_H_
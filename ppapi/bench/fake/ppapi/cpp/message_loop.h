@@ -0,0 +1,39 @@
+#ifndef FAKE_PPAPI_CPP_MESSAGE_LOOP_H_
+#define FAKE_PPAPI_CPP_MESSAGE_LOOP_H_
+
+#include <memory>
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/cpp/instance_handle.h"
+
+namespace pp {
+
+// A task queue a background thread attaches to and runs. Graphics3D and
+// Graphics2D completions go to the loop of the thread that started them.
+// Work still queued when the loop quits runs with PP_ERROR_ABORTED.
+class MessageLoop {
+ public:
+  MessageLoop() = default;
+  explicit MessageLoop(const InstanceHandle& instance);
+
+  static MessageLoop GetForMainThread();
+  static MessageLoop GetCurrent();
+
+  int32_t AttachToCurrentThread();
+  int32_t Run();
+  int32_t PostWork(const CompletionCallback& callback, int64_t delay_ms = 0);
+  int32_t PostQuit(bool should_destroy);
+
+  bool is_null() const { return !queue_; }
+
+ private:
+  explicit MessageLoop(std::shared_ptr<void> queue)
+      : queue_(std::move(queue)) {}
+
+  std::shared_ptr<void> queue_;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_MESSAGE_LOOP_H_
@@ -0,0 +1,33 @@
+#ifndef FAKE_PPAPI_CPP_MODULE_H_
+#define FAKE_PPAPI_CPP_MODULE_H_
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/cpp/core.h"
+
+namespace pp {
+
+class Instance;
+
+class Module {
+ public:
+  Module();
+  virtual ~Module();
+
+  static Module* Get();
+
+  PPB_GetInterface get_browser_interface() const;
+  Core* core() { return &core_; }
+  const void* GetBrowserInterface(const char* interface_name);
+
+  virtual Instance* CreateInstance(PP_Instance instance) = 0;
+
+ private:
+  Core core_;
+};
+
+// Implemented by the plugin.
+Module* CreateModule();
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_MODULE_H_
@@ -0,0 +1,29 @@
+#ifndef FAKE_PPAPI_CPP_NET_ADDRESS_H_
+#define FAKE_PPAPI_CPP_NET_ADDRESS_H_
+
+#include "ppapi/c/ppb_net_address.h"
+#include "ppapi/cpp/instance_handle.h"
+
+namespace pp {
+
+// IPv4 only.
+class NetAddress {
+ public:
+  NetAddress() = default;
+  NetAddress(const InstanceHandle& instance, const PP_NetAddress_IPv4& ipv4)
+      : ipv4_(ipv4), null_(false) {}
+
+  bool DescribeAsIPv4Address(PP_NetAddress_IPv4* ipv4) const {
+    *ipv4 = ipv4_;
+    return !null_;
+  }
+  bool is_null() const { return null_; }
+
+ private:
+  PP_NetAddress_IPv4 ipv4_{};
+  bool null_{true};
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_NET_ADDRESS_H_
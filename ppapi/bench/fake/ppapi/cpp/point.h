@@ -0,0 +1,36 @@
+#ifndef FAKE_PPAPI_CPP_POINT_H_
+#define FAKE_PPAPI_CPP_POINT_H_
+
+#include "ppapi/c/pp_types.h"
+
+namespace pp {
+
+class Point {
+ public:
+  Point() = default;
+  Point(int32_t x, int32_t y) : x_(x), y_(y) {}
+
+  int32_t x() const { return x_; }
+  int32_t y() const { return y_; }
+
+ private:
+  int32_t x_{0};
+  int32_t y_{0};
+};
+
+class FloatPoint {
+ public:
+  FloatPoint() = default;
+  FloatPoint(float x, float y) : x_(x), y_(y) {}
+
+  float x() const { return x_; }
+  float y() const { return y_; }
+
+ private:
+  float x_{0};
+  float y_{0};
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_POINT_H_
@@ -0,0 +1,44 @@
+#ifndef FAKE_PPAPI_CPP_RECT_H_
+#define FAKE_PPAPI_CPP_RECT_H_
+
+#include "ppapi/c/pp_types.h"
+
+namespace pp {
+
+class Size {
+ public:
+  Size() = default;
+  Size(int32_t w, int32_t h) : width_(w), height_(h) {}
+
+  int32_t width() const { return width_; }
+  int32_t height() const { return height_; }
+  bool IsEmpty() const { return width_ <= 0 || height_ <= 0; }
+
+ private:
+  int32_t width_{0};
+  int32_t height_{0};
+};
+
+class Rect {
+ public:
+  Rect() = default;
+  Rect(int32_t x, int32_t y, int32_t w, int32_t h)
+      : x_(x), y_(y), width_(w), height_(h) {}
+
+  int32_t x() const { return x_; }
+  int32_t y() const { return y_; }
+  int32_t width() const { return width_; }
+  int32_t height() const { return height_; }
+  Size size() const { return Size(width_, height_); }
+  bool IsEmpty() const { return width_ <= 0 || height_ <= 0; }
+
+ private:
+  int32_t x_{0};
+  int32_t y_{0};
+  int32_t width_{0};
+  int32_t height_{0};
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_RECT_H_
@@ -0,0 +1,45 @@
+#ifndef FAKE_PPAPI_CPP_TCP_SOCKET_H_
+#define FAKE_PPAPI_CPP_TCP_SOCKET_H_
+
+#include <memory>
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/c/ppb_tcp_socket.h"
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/cpp/net_address.h"
+#include "ppapi/cpp/var.h"
+
+namespace pp {
+
+// A real socket. Each call blocks on a helper thread and completes on the
+// fake main loop, like the browser's socket service would.
+class TCPSocket {
+ public:
+  TCPSocket() = default;
+  explicit TCPSocket(const InstanceHandle& instance);
+  ~TCPSocket();
+
+  int32_t Connect(const NetAddress& addr, const CompletionCallback& callback);
+  int32_t Read(char* buffer,
+               int32_t bytes_to_read,
+               const CompletionCallback& callback);
+  int32_t Write(const char* buffer,
+                int32_t bytes_to_write,
+                const CompletionCallback& callback);
+  void Close();
+  int32_t SetOption(PP_TCPSocket_Option name,
+                    const Var& value,
+                    const CompletionCallback& callback);
+
+  bool is_null() const { return !state_; }
+
+  struct State;
+
+ private:
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_TCP_SOCKET_H_
@@ -0,0 +1,78 @@
+#ifndef FAKE_PPAPI_CPP_VAR_H_
+#define FAKE_PPAPI_CPP_VAR_H_
+
+#include <memory>
+#include <string>
+
+#include "ppapi/c/pp_types.h"
+#include "ppapi/c/pp_var.h"
+
+namespace pp {
+
+// Reference-semantics value like the real pp::Var: strings, arrays,
+// dictionaries and array buffers are heap objects shared between copies,
+// so allocation counts in the benchmark track those of the browser.
+class Var {
+ public:
+  struct Null {};
+
+  enum class Type {
+    kUndefined,
+    kNull,
+    kBool,
+    kInt,
+    kDouble,
+    kString,
+    kArray,
+    kDictionary,
+    kArrayBuffer,
+  };
+
+  Var();
+  Var(Null);
+  Var(bool b);
+  Var(int32_t i);
+  Var(double d);
+  Var(const char* utf8_str);
+  Var(const std::string& utf8_str);
+
+  bool operator==(const Var& other) const;
+
+  bool is_undefined() const { return type_ == Type::kUndefined; }
+  bool is_null() const { return type_ == Type::kNull; }
+  bool is_bool() const { return type_ == Type::kBool; }
+  bool is_string() const { return type_ == Type::kString; }
+  bool is_object() const { return false; }
+  bool is_array() const { return type_ == Type::kArray; }
+  bool is_dictionary() const { return type_ == Type::kDictionary; }
+  bool is_resource() const { return false; }
+  bool is_int() const { return type_ == Type::kInt; }
+  bool is_double() const { return type_ == Type::kDouble; }
+  bool is_number() const { return is_int() || is_double(); }
+  bool is_array_buffer() const { return type_ == Type::kArrayBuffer; }
+
+  bool AsBool() const;
+  int32_t AsInt() const;
+  double AsDouble() const;
+  std::string AsString() const;
+
+  std::string DebugString() const;
+
+  Type type() const { return type_; }
+
+  // By value here; the real one returns a reference to the held PP_Var.
+  PP_Var pp_var() const;
+
+ protected:
+  Type type_{Type::kUndefined};
+  union {
+    bool b;
+    int32_t i;
+    double d;
+  } value_{};
+  std::shared_ptr<void> ref_;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_VAR_H_
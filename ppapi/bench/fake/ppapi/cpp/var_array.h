@@ -0,0 +1,21 @@
+#ifndef FAKE_PPAPI_CPP_VAR_ARRAY_H_
+#define FAKE_PPAPI_CPP_VAR_ARRAY_H_
+
+#include "ppapi/cpp/var.h"
+
+namespace pp {
+
+class VarArray : public Var {
+ public:
+  VarArray();
+  explicit VarArray(const Var& var);
+
+  uint32_t GetLength() const;
+  Var Get(uint32_t index) const;
+  bool Set(uint32_t index, const Var& value);
+  bool SetLength(uint32_t length);
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_VAR_ARRAY_H_
@@ -0,0 +1,21 @@
+#ifndef FAKE_PPAPI_CPP_VAR_ARRAY_BUFFER_H_
+#define FAKE_PPAPI_CPP_VAR_ARRAY_BUFFER_H_
+
+#include "ppapi/cpp/var.h"
+
+namespace pp {
+
+class VarArrayBuffer : public Var {
+ public:
+  VarArrayBuffer();
+  explicit VarArrayBuffer(const Var& var);
+  explicit VarArrayBuffer(uint32_t size_in_bytes);
+
+  uint32_t ByteLength() const;
+  void* Map();
+  void Unmap() {}
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_VAR_ARRAY_BUFFER_H_
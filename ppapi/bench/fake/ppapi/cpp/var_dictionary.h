@@ -0,0 +1,23 @@
+#ifndef FAKE_PPAPI_CPP_VAR_DICTIONARY_H_
+#define FAKE_PPAPI_CPP_VAR_DICTIONARY_H_
+
+#include "ppapi/cpp/var.h"
+#include "ppapi/cpp/var_array.h"
+
+namespace pp {
+
+class VarDictionary : public Var {
+ public:
+  VarDictionary();
+  explicit VarDictionary(const Var& var);
+
+  Var Get(const Var& key) const;
+  bool Set(const Var& key, const Var& value);
+  void Delete(const Var& key);
+  bool HasKey(const Var& key) const;
+  VarArray GetKeys() const;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_VAR_DICTIONARY_H_
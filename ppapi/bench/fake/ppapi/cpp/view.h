@@ -0,0 +1,31 @@
+#ifndef FAKE_PPAPI_CPP_VIEW_H_
+#define FAKE_PPAPI_CPP_VIEW_H_
+
+#include "ppapi/cpp/rect.h"
+
+namespace pp {
+
+class View {
+ public:
+  View() = default;
+  // Fake-only constructor; the browser builds views from a PP_Resource.
+  View(const Rect& rect, float device_scale, bool visible)
+      : rect_(rect), device_scale_(device_scale), visible_(visible) {}
+
+  Rect GetRect() const { return rect_; }
+  bool IsFullscreen() const { return false; }
+  bool IsVisible() const { return visible_; }
+  bool IsPageVisible() const { return visible_; }
+  Rect GetClipRect() const { return visible_ ? rect_ : Rect(); }
+  float GetDeviceScale() const { return device_scale_; }
+  float GetCSSScale() const { return 1.0f; }
+
+ private:
+  Rect rect_;
+  float device_scale_{1.0f};
+  bool visible_{true};
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_CPP_VIEW_H_
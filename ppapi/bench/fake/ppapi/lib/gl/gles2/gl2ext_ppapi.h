@@ -0,0 +1,13 @@
+#ifndef FAKE_PPAPI_LIB_GL_GLES2_GL2EXT_PPAPI_H_
+#define FAKE_PPAPI_LIB_GL_GLES2_GL2EXT_PPAPI_H_
+
+#include <GLES2/gl2.h>
+
+#include "ppapi/c/pp_types.h"
+
+GLboolean GL_APIENTRY glInitializePPAPI(PPB_GetInterface get_browser_interface);
+GLboolean GL_APIENTRY glTerminatePPAPI(void);
+void GL_APIENTRY glSetCurrentContextPPAPI(PP_Resource context);
+PP_Resource GL_APIENTRY glGetCurrentContextPPAPI(void);
+
+#endif  // FAKE_PPAPI_LIB_GL_GLES2_GL2EXT_PPAPI_H_
@@ -0,0 +1,57 @@
+#ifndef FAKE_PPAPI_UTILITY_COMPLETION_CALLBACK_FACTORY_H_
+#define FAKE_PPAPI_UTILITY_COMPLETION_CALLBACK_FACTORY_H_
+
+#include <memory>
+
+#include "ppapi/cpp/completion_callback.h"
+
+namespace pp {
+
+// Callbacks created by the factory are dropped once the factory is
+// destroyed, matching CancelAll() semantics of the real utility.
+template <typename T>
+class CompletionCallbackFactory {
+ public:
+  explicit CompletionCallbackFactory(T* object = nullptr)
+      : object_(object), alive_(std::make_shared<bool>(true)) {}
+
+  ~CompletionCallbackFactory() { CancelAll(); }
+
+  void Initialize(T* object) { object_ = object; }
+  T* GetObject() { return object_; }
+
+  void CancelAll() {
+    *alive_ = false;
+    alive_ = std::make_shared<bool>(true);
+  }
+
+  template <typename Method>
+  CompletionCallback NewCallback(Method method) {
+    T* object = object_;
+    std::weak_ptr<bool> alive = alive_;
+    return CompletionCallback([object, method, alive](int32_t result) {
+      auto flag = alive.lock();
+      if (flag && *flag)
+        (object->*method)(result);
+    });
+  }
+
+  template <typename Method, typename A>
+  CompletionCallback NewCallback(Method method, const A& a) {
+    T* object = object_;
+    std::weak_ptr<bool> alive = alive_;
+    return CompletionCallback([object, method, alive, a](int32_t result) {
+      auto flag = alive.lock();
+      if (flag && *flag)
+        (object->*method)(result, a);
+    });
+  }
+
+ private:
+  T* object_;
+  std::shared_ptr<bool> alive_;
+};
+
+}  // namespace pp
+
+#endif  // FAKE_PPAPI_UTILITY_COMPLETION_CALLBACK_FACTORY_H_
@@ -0,0 +1,1577 @@
+// Headless benchmark for MPVInstance.
+//
+// Links pepper.cc against the fake PPAPI layer in fake/ and drives the plugin
+// the way mpv-client.js does: requests go through HandleMessage(), mpv
+// wakeups are pumped on the fake main loop. Reports request throughput,
+// request-to-reply and event-to-PostMessage latency, heap allocations per
+// message on the plugin main thread, the gaps between swaps, and with
+// --restarts the time from creating an instance to its first frame, with
+// --scrub the time to get seek-bar thumbnails, with --grab frames read
+// back for the page, with --burst a screenshot of every frame, with
+// --stream the rate media pushed from the page reaches the player, with
+// --scrcpy how many touch moves reach a local fake scrcpy server, with
+// --input keys and wheel zoom handled in the plugin, with --log mpv's log
+// at the given levels fetched in batches. --budget turns on dynamic
+// resolution with that render budget, --quality the adaptive quality
+// governor, --cache the module's demuxer cache budget in MiB with the
+// instance focused. --stats prints the plugin's own stage timings at the
+// end, with each tile's cache allocation, --trace writes its span trace.
+//
+//   mpv-bench [--requests N] [--seconds S] [--no-observe] [--batch] [--limits]
+//             [--typed] [--binary] [--diff] [--profiles N] [--type-names]
+//             [--sw] [--resize] [--busy MS] [--tiles N] [--restarts N]
+//             [--scrub N] [--grab N] [--burst DIR] [--stream MB]
+//             [--scrcpy N] [--input N] [--log LEVELS] [--budget MS]
+//             [--quality] [--cache MB] [--stats] [--trace FILE] [file ...]
+//
+// MPVJS_POOL=0 turns the plugin's player pool off for comparison.
+//
+// Without files it plays a lavfi test source, which needs no sample media.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../event_encoder.h"
+#include "fake_ppapi.h"
+#include "ppapi/cpp/input_event.h"
+#include "ppapi/cpp/instance.h"
+#include "ppapi/cpp/module.h"
+#include "ppapi/cpp/var_array.h"
+#include "ppapi/cpp/var_array_buffer.h"
+#include "ppapi/cpp/var_dictionary.h"
+
+namespace {
+
+thread_local uint64_t t_allocs = 0;
+thread_local bool t_count_allocs = true;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (t_count_allocs)
+    ++t_allocs;
+  if (void* p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+namespace {
+
+using fake_ppapi::Clock;
+
+const char* kDefaultSource = "av://lavfi:testsrc=size=1280x720:rate=60";
+
+// Request opcodes as mpv-client.js sends them (RequestOp in pepper.cc).
+const char* kRequestTypes[] = {
+  nullptr, "command", "set_property", "observe_property",
+  "unobserve_property", "get_property_async", "resync_property",
+  "hook_continue", "hook_add", "set_option", "configure", "batch",
+  "get_request_stats", "set_layout", "thumbnail", "grab_frame",
+  "screenshot", "stream_push", "scrcpy", "get_stats",
+};
+
+// Send {type} names instead of {op}, like older clients.
+bool g_type_names = false;
+
+// Same list mpv-client.js observes on every new player.
+const char* kObservedProperties[] = {
+  "video", "width", "height", "pause", "speed", "time-pos", "duration",
+  "eof-reached", "filename", "path", "file-size", "file-format", "mute",
+  "volume", "osd-dimensions", "idle-active", "media-title", "playlist-pos",
+  "playlist", "video-codec", "audio-codec-name", "estimated-vf-fps",
+  "estimated-frame-count", "hwdec-current", "options/demuxer-lavf-hacks",
+  "options/demuxer-lavf-o", "track-list", "metadata",
+};
+
+// Same limits mpv-client.js applies to per-frame properties.
+struct ObserveLimit {
+  const char* name;
+  double rate;
+  double epsilon;
+};
+
+const ObserveLimit kObserveLimits[] = {
+  {"time-pos", 10, 1},
+  {"estimated-vf-fps", 2, 1},
+  {"estimated-frame-count", 2, 0},
+};
+
+// Native formats mpv-client.js requests for scalar properties.
+const char* kObserveFormats[][2] = {
+  {"width", "int64"}, {"height", "int64"}, {"pause", "flag"},
+  {"speed", "double"}, {"time-pos", "double"}, {"duration", "double"},
+  {"eof-reached", "flag"}, {"filename", "string"}, {"path", "string"},
+  {"file-size", "int64"}, {"file-format", "string"}, {"mute", "flag"},
+  {"volume", "double"}, {"idle-active", "flag"}, {"media-title", "string"},
+  {"playlist-pos", "int64"}, {"video-codec", "string"},
+  {"audio-codec-name", "string"}, {"estimated-vf-fps", "double"},
+  {"estimated-frame-count", "int64"}, {"hwdec-current", "string"},
+};
+
+// The nodelay and sync profiles of mpv-client.js.
+struct ProfileOption {
+  const char* name;
+  pp::Var nodelay;
+  pp::Var sync;
+};
+
+const ProfileOption kProfileOptions[] = {
+  {"audio-buffer", 0, 0.2},
+  {"vd-lavc-threads", 1, 0},
+  {"cache-pause", "no", "yes"},
+  {"interpolation", "no", "yes"},
+  {"stream-buffer-size", "4k", "128k"},
+  {"video-latency-hacks", "yes", "no"},
+  {"vd-lavc-o", "flags=low_delay+unaligned", "flags=unaligned"},
+  {"untimed", "yes", "no"},
+};
+
+// Structured properties mpv-client.js receives as patches.
+const char* kDiffedProperties[] = {"playlist", "track-list", "metadata"};
+
+pp::Var MakeObserve(const char* name, bool limits, bool typed, bool diff) {
+  pp::VarDictionary data;
+  bool options = false;
+  if (diff) {
+    for (const char* diffed : kDiffedProperties) {
+      if (strcmp(diffed, name))
+        continue;
+      data.Set("diff", true);
+      options = true;
+    }
+  }
+  if (limits) {
+    for (const auto& limit : kObserveLimits) {
+      if (strcmp(limit.name, name))
+        continue;
+      data.Set("rate", limit.rate);
+      if (limit.epsilon > 0)
+        data.Set("epsilon", limit.epsilon);
+      options = true;
+    }
+  }
+  if (typed) {
+    for (const auto& format : kObserveFormats) {
+      if (strcmp(format[0], name))
+        continue;
+      data.Set("format", format[1]);
+      options = true;
+    }
+  }
+  if (!options)
+    return pp::Var(name);
+  data.Set("name", name);
+  return data;
+}
+
+// Suspends allocation counting for harness bookkeeping on the main thread.
+class ScopedNoCount {
+ public:
+  ScopedNoCount() : saved_(t_count_allocs) { t_count_allocs = false; }
+  ~ScopedNoCount() { t_count_allocs = saved_; }
+
+ private:
+  bool saved_;
+};
+
+class Samples {
+ public:
+  void Add(double us) { values_.push_back(us); }
+  size_t size() const { return values_.size(); }
+
+  void Print(const char* name) {
+    if (values_.empty()) {
+      printf("  %-28s n=0\n", name);
+      return;
+    }
+    std::sort(values_.begin(), values_.end());
+    double sum = 0;
+    for (double v : values_)
+      sum += v;
+    printf("  %-28s n=%zu mean=%.1fus p50=%.1fus p99=%.1fus max=%.1fus\n",
+           name, values_.size(), sum / values_.size(), Percentile(0.5),
+           Percentile(0.99), values_.back());
+  }
+
+ private:
+  double Percentile(double p) const {
+    size_t idx = static_cast<size_t>(p * (values_.size() - 1));
+    return values_[idx];
+  }
+
+  std::vector<double> values_;
+};
+
+double ElapsedUs(Clock::time_point from, Clock::time_point to) {
+  return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+// Reads the binary event messages described in event_encoder.h, keeping
+// only what the recorder needs: each event's name and id.
+class BinaryReader {
+ public:
+  struct Event {
+    std::string name;
+    int64_t id = 0;
+  };
+
+  void Read(const pp::Var& msg, std::vector<Event>* events) {
+    pp::VarArrayBuffer buffer(msg);
+    p_ = static_cast<const uint8_t*>(buffer.Map());
+    end_ = p_ + buffer.ByteLength();
+    while (p_ < end_) {
+      if (*p_ == EventEncoder::TAG_ATOM_DEF) {
+        ++p_;
+        uint16_t id = static_cast<uint16_t>(Int(2));
+        size_t len = static_cast<size_t>(Int(2));
+        if (atoms_.size() <= id)
+          atoms_.resize(id + 1);
+        atoms_[id].assign(reinterpret_cast<const char*>(p_), len);
+        p_ += len;
+        continue;
+      }
+      Event event;
+      Value(&event, nullptr);
+      events->push_back(std::move(event));
+    }
+  }
+
+ private:
+  int64_t Int(int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+      v |= static_cast<uint64_t>(*p_++) << (i * 8);
+    if (bytes == 4)
+      return static_cast<int32_t>(v);
+    return static_cast<int64_t>(v);
+  }
+
+  // Walks one value. |event| is given for the top level map only; |str|
+  // and |num| receive string and integer values.
+  void Value(Event* event, std::string* str, int64_t* num = nullptr) {
+    uint8_t tag = *p_++;
+    switch (tag) {
+      case EventEncoder::TAG_INT32:
+      case EventEncoder::TAG_INT64: {
+        int64_t v = Int(tag == EventEncoder::TAG_INT32 ? 4 : 8);
+        if (num)
+          *num = v;
+        break;
+      }
+      case EventEncoder::TAG_DOUBLE:
+        p_ += 8;
+        break;
+      case EventEncoder::TAG_STRING:
+      case EventEncoder::TAG_BYTES: {
+        size_t len = static_cast<size_t>(Int(4));
+        if (str)
+          str->assign(reinterpret_cast<const char*>(p_), len);
+        p_ += len;
+        break;
+      }
+      case EventEncoder::TAG_ATOM: {
+        uint16_t id = static_cast<uint16_t>(Int(2));
+        if (str)
+          *str = id < atoms_.size() ? atoms_[id] : std::string();
+        break;
+      }
+      case EventEncoder::TAG_ARRAY: {
+        int64_t n = Int(4);
+        for (int64_t i = 0; i < n; i++)
+          Value(nullptr, nullptr);
+        break;
+      }
+      case EventEncoder::TAG_MAP: {
+        int64_t n = Int(4);
+        for (int64_t i = 0; i < n; i++) {
+          std::string key;
+          Value(nullptr, &key);
+          if (event && key == "event")
+            Value(nullptr, &event->name);
+          else if (event && key == "id")
+            Value(nullptr, nullptr, &event->id);
+          else
+            Value(nullptr, nullptr);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  const uint8_t* p_ = nullptr;
+  const uint8_t* end_ = nullptr;
+  std::vector<std::string> atoms_;
+};
+
+struct Recorder {
+  uint64_t messages = 0;
+  uint64_t events = 0;
+  bool ready = false;
+  bool ready_result = false;
+  Samples event_latency;
+  Samples reply_latency;
+  std::unordered_map<int32_t, Clock::time_point> pending;
+  std::map<std::string, uint64_t> by_event;
+  uint64_t binary_bytes = 0;
+  BinaryReader binary;
+  pp::Var request_stats;
+  pp::Var stats;
+  pp::Var trace;
+  uint64_t thumbnails = 0;
+  uint64_t thumbnail_errors = 0;
+  uint64_t frames = 0;
+  uint64_t frame_bytes = 0;
+  uint64_t screenshots = 0;
+  int32_t screenshots_dropped = 0;
+  uint64_t stream_written = 0;
+  uint64_t stream_replies = 0;
+  uint64_t stream_drains = 0;
+  bool stream_closed = false;
+  bool scrcpy_replied = false;
+  bool scrcpy_connected = false;
+  uint64_t input_keys = 0;
+  uint64_t input_views = 0;
+  double input_zoom = 0;
+  bool log_ready = false;
+  bool log_replied = false;
+  uint64_t log_lines = 0;
+  uint64_t log_dropped = 0;
+  std::map<std::string, uint64_t> log_by_module;
+
+  void Reset() {
+    messages = 0;
+    events = 0;
+    binary_bytes = 0;
+    event_latency = Samples();
+    reply_latency = Samples();
+    by_event.clear();
+  }
+
+  void OnMessage(const pp::Var& msg) {
+    ScopedNoCount no_count;
+    auto now = Clock::now();
+    ++messages;
+
+    if (msg.is_array_buffer()) {
+      binary_bytes += pp::VarArrayBuffer(msg).ByteLength();
+      std::vector<BinaryReader::Event> decoded;
+      binary.Read(msg, &decoded);
+      AddLatency(now);
+      for (const auto& event : decoded)
+        OnEvent(event.name, event.id, now);
+      return;
+    }
+
+    pp::VarDictionary dict(msg);
+    if (dict.Get("type").AsString() == "ready") {
+      ready = true;
+      ready_result = dict.Get("data").AsBool();
+      return;
+    }
+
+    AddLatency(now);
+
+    if (dict.Get("event").AsString() == "request-stats")
+      request_stats = dict.Get("stats");
+    if (dict.Get("event").AsString() == "stats") {
+      stats = dict.Get("stats");
+      trace = dict.Get("trace");
+    }
+    if (dict.Get("event").AsString() == "thumbnail")
+      ++(dict.HasKey("data") ? thumbnails : thumbnail_errors);
+    if (dict.Get("event").AsString() == "screenshot") {
+      ++screenshots;
+      screenshots_dropped = dict.Get("dropped").AsInt();
+    }
+    if (dict.Get("event").AsString() == "stream-push-reply") {
+      ++stream_replies;
+      stream_written += dict.Get("written").AsInt();
+    }
+    if (dict.Get("event").AsString() == "stream-drain")
+      ++stream_drains;
+    if (dict.Get("event").AsString() == "stream-closed")
+      stream_closed = true;
+    if (dict.Get("event").AsString() == "scrcpy-reply") {
+      scrcpy_replied = true;
+      scrcpy_connected = dict.Get("connected").AsBool();
+    }
+    if (dict.Get("event").AsString() == "input") {
+      if (dict.Get("kind").AsString() == "key") {
+        ++input_keys;
+      } else {
+        ++input_views;
+        input_zoom = dict.Get("zoom").AsDouble();
+      }
+    }
+    if (dict.Get("event").AsString() == "log-ready")
+      log_ready = true;
+    if (dict.Get("event").AsString() == "log-reply") {
+      log_replied = true;
+      pp::VarArray lines(dict.Get("lines"));
+      log_lines += lines.GetLength();
+      log_dropped += static_cast<uint64_t>(dict.Get("dropped").AsDouble());
+      for (uint32_t i = 0; i < lines.GetLength(); i++)
+        log_by_module[pp::VarArray(lines.Get(i)).Get(2).AsString()]++;
+    }
+    if (dict.Get("event").AsString() == "frame") {
+      ++frames;
+      frame_bytes += pp::VarArrayBuffer(dict.Get("data")).ByteLength();
+    }
+
+    if (msg.is_array()) {
+      pp::VarArray batch(msg);
+      for (uint32_t i = 0; i < batch.GetLength(); i++)
+        OnEvent(pp::VarDictionary(batch.Get(i)), now);
+    } else {
+      OnEvent(dict, now);
+    }
+  }
+
+  void AddLatency(Clock::time_point now) {
+    auto queued = fake_ppapi::CurrentTaskQueuedAt();
+    if (queued != Clock::time_point())
+      event_latency.Add(ElapsedUs(queued, now));
+  }
+
+  void OnEvent(const pp::VarDictionary& dict, Clock::time_point now) {
+    pp::Var id = dict.Get("id");
+    OnEvent(dict.Get("event").AsString(), id.is_number() ? id.AsInt() : 0,
+            now);
+  }
+
+  void OnEvent(const std::string& name, int64_t id, Clock::time_point now) {
+    ++events;
+    by_event[name]++;
+
+    if (id) {
+      auto it = pending.find(static_cast<int32_t>(id));
+      if (it != pending.end()) {
+        reply_latency.Add(ElapsedUs(it->second, now));
+        pending.erase(it);
+      }
+    }
+  }
+
+  void PrintEvents() {
+    std::vector<std::pair<std::string, uint64_t>> sorted(by_event.begin(),
+                                                         by_event.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const auto& a, const auto& b) { return a.second > b.second; });
+    for (const auto& entry : sorted)
+      printf("    %-26s %llu\n", entry.first.c_str(),
+             static_cast<unsigned long long>(entry.second));
+  }
+};
+
+pp::Var MakeRequest(const char* type, const pp::Var& data, int32_t id) {
+  pp::VarDictionary dict;
+  int32_t op = 0;
+  for (int32_t n = 1; !g_type_names && n < static_cast<int32_t>(
+                          sizeof(kRequestTypes) / sizeof(kRequestTypes[0]));
+       n++) {
+    if (!strcmp(kRequestTypes[n], type))
+      op = n;
+  }
+  if (op)
+    dict.Set("op", op);
+  else
+    dict.Set("type", type);
+  dict.Set("data", data);
+  if (id)
+    dict.Set("id", id);
+  return dict;
+}
+
+pp::Var MakeArray(std::initializer_list<pp::Var> items) {
+  pp::VarArray array;
+  uint32_t i = 0;
+  for (const auto& item : items)
+    array.Set(i++, item);
+  return array;
+}
+
+pp::Var MakeRequestAt(uint32_t n, int32_t id) {
+  switch (n % 3) {
+    case 0: {
+      pp::VarDictionary data;
+      data.Set("name", "volume");
+      data.Set("value", static_cast<int32_t>(n % 100));
+      return MakeRequest("set_property", data, id);
+    }
+    case 1:
+      return MakeRequest("get_property_async", "time-pos", id);
+    default:
+      return MakeRequest("command", MakeArray({"script-message", "mpv-bench"}),
+                         id);
+  }
+}
+
+// Request throughput: HandleMessage() cost and request-to-reply latency.
+void RunRequests(pp::Instance* instance, Recorder* recorder, uint32_t count) {
+  std::vector<pp::Var> requests;
+  requests.reserve(count);
+  for (uint32_t n = 0; n < count; n++)
+    requests.push_back(MakeRequestAt(n, static_cast<int32_t>(n + 1)));
+
+  recorder->Reset();
+  recorder->pending.reserve(count);
+
+  double handle_us = 0;
+  uint64_t allocs = 0;
+  for (uint32_t n = 0; n < count; n++) {
+    {
+      ScopedNoCount no_count;
+      recorder->pending[static_cast<int32_t>(n + 1)] = Clock::now();
+    }
+    uint64_t before_allocs = t_allocs;
+    auto before = Clock::now();
+    instance->HandleMessage(requests[n]);
+    handle_us += ElapsedUs(before, Clock::now());
+    allocs += t_allocs - before_allocs;
+
+    // Let wakeups interleave with requests like the renderer would.
+    if (n % 64 == 63)
+      fake_ppapi::RunUntilIdle();
+  }
+
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(5),
+                       [&] { return recorder->pending.empty(); });
+
+  printf("requests\n");
+  printf("  %-28s %u\n", "sent", count);
+  printf("  %-28s %.0f msg/s\n", "HandleMessage throughput",
+         count / (handle_us / 1e6));
+  printf("  %-28s %.2f\n", "allocs per HandleMessage",
+         static_cast<double>(allocs) / count);
+  printf("  %-28s %zu\n", "missing replies", recorder->pending.size());
+  recorder->reply_latency.Print("request -> reply");
+  recorder->pending.clear();
+
+  // The plugin's own view, per request type.
+  instance->HandleMessage(MakeRequest("get_request_stats", pp::Var(), 0));
+  fake_ppapi::RunUntilIdle();
+  pp::VarDictionary stats(recorder->request_stats);
+  pp::VarArray types = stats.GetKeys();
+  for (uint32_t i = 0; i < types.GetLength(); i++) {
+    pp::VarDictionary entry(stats.Get(types.Get(i)));
+    printf("  %-28s n=%d total=%.2fms max=%.3fms\n",
+           types.Get(i).AsString().c_str(), entry.Get("count").AsInt(),
+           entry.Get("total_ms").AsDouble(), entry.Get("max_ms").AsDouble());
+  }
+}
+
+// Profile switches, one set_property per option or one batch each.
+void RunProfiles(pp::Instance* instance,
+                 Recorder* recorder,
+                 uint32_t count,
+                 bool batch) {
+  recorder->Reset();
+  Samples switch_latency;
+  int32_t id = 2000000;
+
+  for (uint32_t n = 0; n < count; n++) {
+    std::vector<pp::Var> requests;
+    pp::VarArray items;
+    uint32_t i = 0;
+    for (const auto& option : kProfileOptions) {
+      pp::VarDictionary data;
+      data.Set("name", std::string("options/") + option.name);
+      data.Set("value", n % 2 ? option.sync : option.nodelay);
+      if (batch)
+        items.Set(i++, MakeRequest("set_property", data, 0));
+      else
+        requests.push_back(MakeRequest("set_property", data, ++id));
+    }
+    if (batch)
+      requests.push_back(MakeRequest("batch", items, ++id));
+
+    auto start = Clock::now();
+    {
+      ScopedNoCount no_count;
+      for (const auto& request : requests)
+        recorder->pending[pp::VarDictionary(request).Get("id").AsInt()] = start;
+    }
+    for (const auto& request : requests)
+      instance->HandleMessage(request);
+    fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(5),
+                         [&] { return recorder->pending.empty(); });
+    switch_latency.Add(ElapsedUs(start, Clock::now()));
+  }
+
+  printf("profile switches (%s)\n", batch ? "batch" : "per option");
+  printf("  %-28s %llu\n", "replies posted",
+         static_cast<unsigned long long>(recorder->messages));
+  printf("  %-28s %zu\n", "missing replies", recorder->pending.size());
+  switch_latency.Print("switch -> last reply");
+  recorder->pending.clear();
+}
+
+// Playback: event traffic the plugin generates for an observing client.
+void RunPlayback(pp::Instance* instance,
+                 Recorder* recorder,
+                 const std::vector<std::string>& files,
+                 double seconds,
+                 bool observe,
+                 bool limits,
+                 bool typed,
+                 bool diff,
+                 bool resize,
+                 int32_t busy_ms,
+                 int32_t tiles) {
+  if (observe) {
+    for (const char* name : kObservedProperties) {
+      instance->HandleMessage(
+          MakeRequest("observe_property", MakeObserve(name, limits, typed, diff), 0));
+    }
+  }
+
+  // In compositor mode every tile plays the same sources.
+  int32_t id = 1000000;
+  for (int32_t tile = 0; tile < std::max(tiles, 1); tile++) {
+    for (size_t i = 0; i < files.size(); i++) {
+      const char* mode = i == 0 ? "replace" : "append";
+      pp::VarDictionary request(MakeRequest(
+          "command", MakeArray({"loadfile", files[i], mode}), id++));
+      if (tiles)
+        request.Set("tile", tile);
+      instance->HandleMessage(request);
+    }
+  }
+
+  // Skip the startup burst so steady state dominates.
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(500));
+  recorder->Reset();
+
+  // Swaps may come from the plugin's render thread.
+  std::mutex swap_mutex;
+  Samples swap_gaps;
+  Clock::time_point last_swap;
+  fake_ppapi::SetSwapObserver([&] {
+    ScopedNoCount no_count;
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(swap_mutex);
+    if (last_swap != Clock::time_point())
+      swap_gaps.Add(ElapsedUs(last_swap, now));
+    last_swap = now;
+  });
+
+  uint64_t swaps = fake_ppapi::SwapCount();
+  uint64_t before_allocs = t_allocs;
+  auto start = Clock::now();
+  auto end = start + std::chrono::microseconds(
+                         static_cast<int64_t>(seconds * 1e6));
+  for (int step = 0; Clock::now() < end; step++) {
+    if (resize) {
+      // A window drag: a new size every 50ms, growing and shrinking.
+      int32_t delta = step % 40 < 20 ? step % 20 : 20 - step % 20;
+      instance->DidChangeView(
+          fake_ppapi::MakeView(1280 - delta * 8, 720 - delta * 4));
+    }
+    if (busy_ms > 0) {
+      // Stands in for a page flooding the plugin: the main thread is stuck
+      // in one long task every 50ms.
+      auto until = Clock::now() + std::chrono::milliseconds(busy_ms);
+      while (Clock::now() < until) {
+      }
+    }
+    fake_ppapi::RunUntil(
+        std::min(end, Clock::now() + std::chrono::milliseconds(50)));
+  }
+  double elapsed = ElapsedUs(start, Clock::now()) / 1e6;
+  uint64_t allocs = t_allocs - before_allocs;
+  fake_ppapi::SetSwapObserver(nullptr);
+
+  printf("playback (%.1fs, %zu source%s", elapsed, files.size(),
+         files.size() == 1 ? "" : "s");
+  if (tiles)
+    printf(", %d tiles", tiles);
+  printf(")\n");
+  printf("  %-28s %llu\n", "messages posted",
+         static_cast<unsigned long long>(recorder->messages));
+  printf("  %-28s %.1f msg/s\n", "message rate",
+         recorder->messages / elapsed);
+  printf("  %-28s %llu\n", "events delivered",
+         static_cast<unsigned long long>(recorder->events));
+  printf("  %-28s %.2f\n", "allocs per message",
+         recorder->messages
+             ? static_cast<double>(allocs) / recorder->messages
+             : 0.0);
+  if (recorder->binary_bytes) {
+    printf("  %-28s %.1f\n", "bytes per message",
+           static_cast<double>(recorder->binary_bytes) / recorder->messages);
+  }
+  swaps = fake_ppapi::SwapCount() - swaps;
+  printf("  %-28s %llu\n", "swaps", static_cast<unsigned long long>(swaps));
+  if (swaps) {
+    printf("  %-28s %.2f\n", "allocs per swap",
+           static_cast<double>(allocs) / swaps);
+  }
+  swap_gaps.Print("swap -> swap");
+  recorder->event_latency.Print("wakeup -> PostMessage");
+  printf("  events\n");
+  recorder->PrintEvents();
+
+  instance->HandleMessage(MakeRequest("command", "stop", id++));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(200));
+}
+
+pp::Var MakeThumbnailRequest(const std::string& url, double time) {
+  pp::VarDictionary data;
+  data.Set("url", url);
+  data.Set("time", time);
+  data.Set("width", 160);
+  return data;
+}
+
+// A drag along the seek bar: one thumbnail request per 16ms frame,
+// sweeping the timeline once. The first request opens the file and
+// starts the index, the drag begins a moment later.
+void RunScrub(pp::Instance* instance,
+              Recorder* recorder,
+              const std::string& url,
+              uint32_t count) {
+  const double duration = 3600;  // what the fake libmpv reports
+  instance->HandleMessage(
+      MakeRequest("thumbnail", MakeThumbnailRequest(url, 0), 1));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(1500));
+
+  recorder->Reset();
+  recorder->pending.clear();
+  recorder->thumbnails = 0;
+  recorder->thumbnail_errors = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    int32_t id = 3000000 + static_cast<int32_t>(i);
+    recorder->pending[id] = Clock::now();
+    instance->HandleMessage(MakeRequest(
+        "thumbnail", MakeThumbnailRequest(url, duration * i / count), id));
+    fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(16));
+  }
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(500));
+
+  printf("scrub (%u requests)\n", count);
+  printf("  %-28s %llu\n", "thumbnails",
+         static_cast<unsigned long long>(recorder->thumbnails));
+  printf("  %-28s %llu\n", "superseded or failed",
+         static_cast<unsigned long long>(recorder->thumbnail_errors));
+  recorder->reply_latency.Print("request -> thumbnail");
+}
+
+pp::Var MakeGrabRequest(const char* format, int32_t every) {
+  pp::VarDictionary data;
+  data.Set("width", 320);
+  data.Set("format", format);
+  if (every)
+    data.Set("every", every);
+  return data;
+}
+
+// A motion detection overlay: every |every|th frame as 320px grayscale
+// while playing, then one-shot RGBA grabs. Frames are only drawn with --sw.
+void RunGrab(pp::Instance* instance,
+             Recorder* recorder,
+             const std::string& url,
+             int32_t every) {
+  const int32_t seconds = 2;
+  instance->HandleMessage(MakeRequest(
+      "command", MakeArray({"loadfile", url, "replace"}), 1));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(300));
+
+  recorder->frames = 0;
+  recorder->frame_bytes = 0;
+  uint64_t swaps = fake_ppapi::SwapCount();
+  uint64_t allocs = t_allocs;
+  instance->HandleMessage(
+      MakeRequest("grab_frame", MakeGrabRequest("gray", every), 2));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(seconds));
+  instance->HandleMessage(
+      MakeRequest("grab_frame", MakeGrabRequest("gray", -1), 2));
+  swaps = fake_ppapi::SwapCount() - swaps;
+  allocs = t_allocs - allocs;
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(100));
+
+  printf("grab (every %d frames, %ds)\n", every, seconds);
+  printf("  %-28s %llu\n", "swaps", static_cast<unsigned long long>(swaps));
+  printf("  %-28s %llu\n", "frames",
+         static_cast<unsigned long long>(recorder->frames));
+  printf("  %-28s %.1f\n", "bytes per frame",
+         recorder->frames
+             ? static_cast<double>(recorder->frame_bytes) / recorder->frames
+             : 0.0);
+  printf("  %-28s %.2f\n", "main allocs per frame",
+         recorder->frames ? static_cast<double>(allocs) / recorder->frames
+                          : 0.0);
+
+  recorder->Reset();
+  recorder->pending.clear();
+  for (int32_t i = 0; i < 50; i++) {
+    int32_t id = 4000000 + i;
+    recorder->pending[id] = Clock::now();
+    instance->HandleMessage(
+        MakeRequest("grab_frame", MakeGrabRequest("rgba", 0), id));
+    fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(20));
+  }
+  recorder->reply_latency.Print("request -> frame");
+
+  instance->HandleMessage(MakeRequest("command", "stop", 3));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(200));
+}
+
+// Swap gaps over |duration| of playback.
+void RecordSwaps(std::chrono::milliseconds duration, const char* name) {
+  std::mutex swap_mutex;
+  Samples swap_gaps;
+  Clock::time_point last_swap;
+  fake_ppapi::SetSwapObserver([&] {
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(swap_mutex);
+    if (last_swap != Clock::time_point())
+      swap_gaps.Add(ElapsedUs(last_swap, now));
+    last_swap = now;
+  });
+  fake_ppapi::RunUntil(Clock::now() + duration);
+  fake_ppapi::SetSwapObserver(nullptr);
+  std::lock_guard<std::mutex> lock(swap_mutex);
+  swap_gaps.Print(name);
+}
+
+// Burst capture during playback, like each-frame screenshots: every frame
+// encoded as PNG, saved to |directory| or returned when it is "-".
+// Frames are only drawn with --sw.
+void RunBurst(pp::Instance* instance,
+              Recorder* recorder,
+              const std::string& url,
+              const std::string& directory) {
+  instance->HandleMessage(MakeRequest(
+      "command", MakeArray({"loadfile", url, "replace"}), 1));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(300));
+  RecordSwaps(std::chrono::milliseconds(1000), "swap -> swap, no burst");
+
+  recorder->screenshots = 0;
+  recorder->screenshots_dropped = 0;
+  pp::VarDictionary data;
+  data.Set("every", 1);
+  if (directory != "-") {
+    data.Set("save", true);
+    data.Set("directory", directory);
+  }
+  instance->HandleMessage(MakeRequest("screenshot", data, 2));
+  RecordSwaps(std::chrono::milliseconds(2000), "swap -> swap, burst");
+  pp::VarDictionary stop;
+  stop.Set("every", 0);
+  instance->HandleMessage(MakeRequest("screenshot", stop, 2));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(500));
+
+  printf("  %-28s %llu\n", "screenshots",
+         static_cast<unsigned long long>(recorder->screenshots));
+  printf("  %-28s %d\n", "dropped", recorder->screenshots_dropped);
+
+  instance->HandleMessage(MakeRequest("command", "stop", 3));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(200));
+}
+
+// A page feeding jsstream:// from its own connection: |megabytes| in
+// 256 KiB chunks as fast as the ring takes them, pausing on a short write
+// until stream-drain. The fake libmpv reads 64 KiB every 5ms.
+void RunStream(pp::Instance* instance,
+               Recorder* recorder,
+               uint32_t megabytes) {
+  const uint32_t kChunk = 256 * 1024;
+  const uint64_t total = static_cast<uint64_t>(megabytes) << 20;
+  pp::VarArrayBuffer chunk(kChunk);
+  memset(chunk.Map(), 0x47, kChunk);  // TS sync bytes
+  chunk.Unmap();
+
+  recorder->Reset();
+  recorder->pending.clear();
+  recorder->stream_written = 0;
+  recorder->stream_replies = 0;
+  recorder->stream_drains = 0;
+  recorder->stream_closed = false;
+  instance->HandleMessage(MakeRequest(
+      "command", MakeArray({"loadfile", "jsstream://bench", "replace"}), 1));
+
+  auto start = Clock::now();
+  int32_t id = 5000000;
+  uint64_t drains = 0;
+  uint32_t offset = 0;  // into the chunk, after a short write
+  while (recorder->stream_written < total) {
+    uint64_t written = recorder->stream_written;
+    pp::VarDictionary data;
+    data.Set("stream", "bench");
+    uint32_t size = static_cast<uint32_t>(
+        std::min<uint64_t>(kChunk - offset, total - written));
+    if (offset || size < kChunk) {
+      pp::VarArrayBuffer part(size);
+      memset(part.Map(), 0x47, size);
+      part.Unmap();
+      data.Set("data", part);
+    } else {
+      data.Set("data", chunk);
+    }
+    recorder->pending[id] = Clock::now();
+    instance->HandleMessage(MakeRequest("stream_push", data, id++));
+    fake_ppapi::RunUntilIdle();
+    uint32_t accepted = static_cast<uint32_t>(recorder->stream_written - written);
+    offset = accepted < size ? offset + accepted : 0;
+    if (accepted < size) {
+      fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(2),
+                           [&] { return recorder->stream_drains > drains; });
+      drains = recorder->stream_drains;
+    }
+  }
+  pp::VarDictionary end;
+  end.Set("stream", "bench");
+  end.Set("eof", true);
+  instance->HandleMessage(MakeRequest("stream_push", end, id++));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(30),
+                       [recorder] { return recorder->stream_closed; });
+  double seconds = ElapsedUs(start, Clock::now()) / 1e6;
+
+  printf("stream (%u MiB)\n", megabytes);
+  printf("  %-28s %.1f MiB/s\n", "pushed to closed",
+         recorder->stream_written / seconds / (1 << 20));
+  printf("  %-28s %llu\n", "pushes",
+         static_cast<unsigned long long>(recorder->stream_replies));
+  printf("  %-28s %llu\n", "drains",
+         static_cast<unsigned long long>(recorder->stream_drains));
+  printf("  %-28s %s\n", "closed by player",
+         recorder->stream_closed ? "yes" : "no");
+  recorder->reply_latency.Print("push -> reply");
+}
+
+// What a scrcpy server saw on its control socket.
+struct ScrcpyServer {
+  int listener = -1;
+  uint16_t port = 0;
+  uint64_t bytes = 0;
+  uint64_t reads = 0;
+  std::vector<uint8_t> actions;  // of each touch message
+  std::thread thread;
+
+  bool Start() {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (listener < 0 ||
+        bind(listener, reinterpret_cast<sockaddr*>(&addr), len) != 0 ||
+        listen(listener, 1) != 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+      return false;
+    port = ntohs(addr.sin_port);
+    thread = std::thread([this] {
+      int fd = accept(listener, nullptr, nullptr);
+      std::vector<uint8_t> data;
+      char buf[4096];
+      ssize_t n;
+      while (fd >= 0 && (n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        ++reads;
+        data.insert(data.end(), buf, buf + n);
+      }
+      bytes = data.size();
+      // every message of the run is a 28-byte touch: type 2, action
+      for (size_t i = 0; i + 28 <= data.size(); i += 28)
+        actions.push_back(data[i] == 2 ? data[i + 1] : 0xff);
+      if (fd >= 0)
+        close(fd);
+    });
+    return true;
+  }
+
+  void Stop() {
+    if (thread.joinable())
+      thread.join();
+    close(listener);
+  }
+};
+
+// A finger dragged across a scrcpy stream: a down, |moves| moves 1ms
+// apart, like a fast touchpad, and an up, through the plugin's control
+// connection to a local fake server.
+void RunScrcpy(pp::Instance* instance, Recorder* recorder, uint32_t moves) {
+  ScrcpyServer server;
+  if (!server.Start()) {
+    fprintf(stderr, "scrcpy server failed\n");
+    return;
+  }
+  recorder->scrcpy_replied = false;
+  auto start = Clock::now();
+  pp::VarDictionary connect;
+  connect.Set("connect", server.port);
+  instance->HandleMessage(MakeRequest("scrcpy", connect, 1));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(2),
+                       [recorder] { return recorder->scrcpy_replied; });
+  double connect_us = ElapsedUs(start, Clock::now());
+  if (!recorder->scrcpy_connected) {
+    fprintf(stderr, "scrcpy connect failed\n");
+    server.Stop();
+    return;
+  }
+
+  auto touch = [instance](int32_t action, int32_t x) {
+    pp::VarDictionary data;
+    data.Set("touch", MakeArray({action, -1, x, 360, 1280, 720, 1.0, 1}));
+    instance->HandleMessage(MakeRequest("scrcpy", data, 0));
+  };
+  start = Clock::now();
+  touch(0, 0);
+  for (uint32_t i = 0; i < moves; i++) {
+    touch(2, static_cast<int32_t>(i % 1280));
+    fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(1));
+  }
+  touch(1, static_cast<int32_t>(moves % 1280));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(100));
+  double seconds = ElapsedUs(start, Clock::now()) / 1e6;
+
+  pp::VarDictionary close_data;
+  close_data.Set("close", true);
+  instance->HandleMessage(MakeRequest("scrcpy", close_data, 0));
+  fake_ppapi::RunUntilIdle();
+  server.Stop();
+
+  size_t sent_moves = std::count(server.actions.begin(), server.actions.end(), 2);
+  bool ordered = server.actions.size() >= 2 && server.actions.front() == 0 &&
+                 server.actions.back() == 1 &&
+                 server.bytes == server.actions.size() * 28;
+  printf("scrcpy (%u moves over %.2fs)\n", moves, seconds);
+  printf("  %-28s %.0fus\n", "connect", connect_us);
+  printf("  %-28s %zu (%.1f/s)\n", "moves received", sent_moves,
+         sent_moves / seconds);
+  printf("  %-28s %llu\n", "server reads",
+         static_cast<unsigned long long>(server.reads));
+  printf("  %-28s %s\n", "down first, up last", ordered ? "yes" : "no");
+}
+
+// Native input against the page's way: keys as HandleInputEvent() versus
+// a keypress command request, and |notches| wheel notches 1ms apart,
+// like a fast smooth-scrolling wheel, zooming about the pointer versus
+// the three set_property requests crop() sends per change.
+void RunInput(pp::Instance* instance, Recorder* recorder, uint32_t notches) {
+  pp::VarDictionary input;
+  input.Set("keys", true);
+  input.Set("mouse", "view");
+  input.Set("wheel", "view");
+  input.Set("notify", true);
+  pp::VarDictionary config;
+  config.Set("input", input);
+  instance->HandleMessage(MakeRequest("configure", config, 0));
+  fake_ppapi::RunUntilIdle();
+  recorder->input_keys = 0;
+  recorder->input_views = 0;
+
+  pp::InstanceHandle handle(instance);
+  auto key = [&](PP_InputEvent_Type type, uint32_t modifiers, uint32_t code,
+                 const char* text) {
+    return instance->HandleInputEvent(pp::KeyboardInputEvent(
+        handle, type, 0, modifiers, code, text ? pp::Var(text) : pp::Var()));
+  };
+  // a, Shift+LEFT, ESC and Ctrl+c left to the page, Ctrl+s
+  uint32_t taken = 0;
+  Samples native_key;
+  for (uint32_t i = 0; i < 200; i++) {
+    auto start = Clock::now();
+    taken += key(PP_INPUTEVENT_TYPE_RAWKEYDOWN, 0, 'A', nullptr);
+    taken += key(PP_INPUTEVENT_TYPE_CHAR, 0, 0, "a");
+    taken += key(PP_INPUTEVENT_TYPE_RAWKEYDOWN, PP_INPUTEVENT_MODIFIER_SHIFTKEY,
+                 37, nullptr);
+    taken += key(PP_INPUTEVENT_TYPE_RAWKEYDOWN, 0, 27, nullptr);
+    taken += key(PP_INPUTEVENT_TYPE_CHAR, 0, 0, "\x1b");
+    taken += key(PP_INPUTEVENT_TYPE_RAWKEYDOWN,
+                 PP_INPUTEVENT_MODIFIER_CONTROLKEY, 'C', nullptr);
+    taken += key(PP_INPUTEVENT_TYPE_CHAR, PP_INPUTEVENT_MODIFIER_CONTROLKEY, 0,
+                 "\x03");
+    taken += key(PP_INPUTEVENT_TYPE_RAWKEYDOWN,
+                 PP_INPUTEVENT_MODIFIER_CONTROLKEY, 'S', nullptr);
+    taken += key(PP_INPUTEVENT_TYPE_CHAR, PP_INPUTEVENT_MODIFIER_CONTROLKEY, 0,
+                 "\x13");
+    native_key.Add(ElapsedUs(start, Clock::now()) / 3);
+  }
+  fake_ppapi::RunUntilIdle();
+  Samples request_key;
+  for (uint32_t i = 0; i < 200; i++) {
+    auto start = Clock::now();
+    instance->HandleMessage(MakeRequest(
+        "command", MakeArray({"keypress", "a"}), 6000000 + i));
+    request_key.Add(ElapsedUs(start, Clock::now()));
+  }
+  fake_ppapi::RunUntilIdle();
+
+  // the pointer over the right half, where the zoom is anchored
+  instance->HandleInputEvent(pp::MouseInputEvent(
+      handle, PP_INPUTEVENT_TYPE_MOUSEMOVE, 0, 0,
+      PP_INPUTEVENT_MOUSEBUTTON_NONE, pp::Point(960, 240), 0, pp::Point()));
+  Samples native_wheel;
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < notches; i++) {
+    // in for the first half, back out for the second
+    float ticks = i < notches / 2 ? 0.5f : -0.5f;
+    auto event_start = Clock::now();
+    instance->HandleInputEvent(pp::WheelInputEvent(
+        handle, 0, 0, pp::FloatPoint(0, ticks * 100),
+        pp::FloatPoint(0, ticks), false));
+    native_wheel.Add(ElapsedUs(event_start, Clock::now()));
+    fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(1));
+  }
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(50));
+  double seconds = ElapsedUs(start, Clock::now()) / 1e6;
+  uint64_t views = recorder->input_views;
+
+  Samples request_crop;
+  for (uint32_t i = 0; i < 200; i++) {
+    auto crop_start = Clock::now();
+    for (const char* name : {"options/video-zoom", "options/video-pan-x",
+                             "options/video-pan-y"}) {
+      pp::VarDictionary data;
+      data.Set("name", name);
+      data.Set("value", 0.5);
+      instance->HandleMessage(MakeRequest("set_property", data, 7000000 + i));
+    }
+    request_crop.Add(ElapsedUs(crop_start, Clock::now()));
+  }
+  fake_ppapi::RunUntilIdle();
+
+  printf("input\n");
+  printf("  %-28s %u of %u (a, Shift+LEFT, Ctrl+s)\n", "key events taken",
+         taken, 200 * 9);
+  printf("  %-28s %llu\n", "key notifications",
+         static_cast<unsigned long long>(recorder->input_keys));
+  native_key.Print("key, native");
+  request_key.Print("key, keypress request");
+  printf("  %-28s %u over %.2fs\n", "wheel events", notches, seconds);
+  printf("  %-28s %llu (%.1f/s)\n", "view updates to mpv",
+         static_cast<unsigned long long>(views), views / seconds);
+  printf("  %-28s %.3f\n", "zoom after in and out", recorder->input_zoom);
+  native_wheel.Print("wheel, native");
+  request_crop.Print("zoom, crop() requests");
+}
+
+// mpv's log at |levels| during playback, fetched the way mpv-client.js
+// does: everything waiting, once log-ready arrives.
+void RunLog(pp::Instance* instance,
+            Recorder* recorder,
+            const std::string& file,
+            const std::string& levels) {
+  pp::VarDictionary config;
+  config.Set("levels", levels);
+  config.Set("notify", true);
+  instance->HandleMessage(MakeRequest("log", config, 0));
+  instance->HandleMessage(
+      MakeRequest("command", MakeArray({"loadfile", file}), 0));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(200));
+  // the fetch re-arms log-ready, which may come right away
+  recorder->log_ready = false;
+  pp::VarDictionary drain;
+  drain.Set("fetch", true);
+  instance->HandleMessage(MakeRequest("log", drain, 0));
+  recorder->log_lines = 0;
+  recorder->log_dropped = 0;
+  recorder->log_by_module.clear();
+  uint64_t messages = recorder->messages;
+
+  Samples fetch;
+  uint32_t fetches = 0;
+  auto start = Clock::now();
+  auto deadline = start + std::chrono::seconds(2);
+  while (Clock::now() < deadline) {
+    fake_ppapi::RunUntil(deadline, [recorder] { return recorder->log_ready; });
+    if (!recorder->log_ready)
+      break;
+    recorder->log_ready = false;
+    // the page gets to it on its next frame
+    fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(16));
+    auto fetch_start = Clock::now();
+    instance->HandleMessage(MakeRequest("log", drain, 0));
+    fetch.Add(ElapsedUs(fetch_start, Clock::now()));
+    fetches++;
+  }
+  double seconds = ElapsedUs(start, Clock::now()) / 1e6;
+  messages = recorder->messages - messages;
+
+  pp::VarDictionary stop;
+  stop.Set("levels", "no");
+  instance->HandleMessage(MakeRequest("log", stop, 0));
+  fake_ppapi::RunUntilIdle();
+
+  printf("log (%s)\n", levels.c_str());
+  printf("  %-28s %llu (%.0f/s)\n", "lines fetched",
+         static_cast<unsigned long long>(recorder->log_lines),
+         recorder->log_lines / seconds);
+  printf("  %-28s %llu\n", "lines dropped",
+         static_cast<unsigned long long>(recorder->log_dropped));
+  printf("  %-28s %llu (%.1f/s), %u fetches\n", "messages to the page",
+         static_cast<unsigned long long>(messages), messages / seconds,
+         fetches);
+  fetch.Print("fetch");
+  for (const auto& module : recorder->log_by_module)
+    printf("    %-26s %llu\n", module.first.c_str(),
+           static_cast<unsigned long long>(module.second));
+}
+
+// The plugin's get_stats, as a table; with |trace_file| the trace
+// recorded since StartTrace() goes there.
+void PrintStats(pp::Instance* instance, Recorder* recorder,
+                const std::string& trace_file) {
+  recorder->stats = pp::Var();
+  pp::VarDictionary data;
+  if (!trace_file.empty())
+    data.Set("trace", false);
+  auto start = Clock::now();
+  instance->HandleMessage(MakeRequest("get_stats", data, 8000000));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(2),
+                       [recorder] { return recorder->stats.is_dictionary(); });
+  double reply_us = ElapsedUs(start, Clock::now());
+  if (!recorder->stats.is_dictionary()) {
+    fprintf(stderr, "no stats\n");
+    return;
+  }
+
+  pp::VarDictionary stats(recorder->stats);
+  auto print_stage = [](const char* name, const pp::Var& var) {
+    pp::VarDictionary stage(var);
+    printf("  %-28s n=%.0f mean=%.3fms p50<=%.3fms p99<=%.3fms max=%.3fms\n",
+           name, stage.Get("count").AsDouble(), stage.Get("mean_ms").AsDouble(),
+           stage.Get("p50_ms").AsDouble(), stage.Get("p99_ms").AsDouble(),
+           stage.Get("max_ms").AsDouble());
+  };
+  printf("plugin stats (reply in %.0fus)\n", reply_us);
+  for (const char* name : {"render", "swap", "frame_interval", "event_drain",
+                           "event_latency"})
+    print_stage(name, stats.Get(name));
+  for (const char* name : {"frames", "deferred", "hidden", "resizes", "events"})
+    printf("  %-28s %.0f\n", name, stats.Get(name).AsDouble());
+  for (const char* name : {"events_per_drain", "pending_events"}) {
+    pp::VarDictionary depth(stats.Get(name));
+    printf("  %-28s last=%.0f max=%.0f\n", name, depth.Get("last").AsDouble(),
+           depth.Get("max").AsDouble());
+  }
+  pp::VarArray tiles(stats.Get("tiles"));
+  for (uint32_t i = 0; i < tiles.GetLength(); i++) {
+    pp::VarDictionary tile(tiles.Get(i));
+    std::string name = "tile " + std::to_string(i) + " render";
+    print_stage(name.c_str(), tile.Get("render"));
+    printf("  %-28s drawn=%.0f reused=%.0f skipped=%.0f scale=%.3f\n", "",
+           tile.Get("drawn").AsDouble(), tile.Get("reused").AsDouble(),
+           tile.Get("skipped").AsDouble(), tile.Get("scale").AsDouble());
+    printf("  %-28s quality=%d dropped=%.0f\n", "",
+           tile.Get("quality").AsInt(), tile.Get("dropped").AsDouble());
+    if (tile.HasKey("cache")) {
+      pp::VarDictionary cache(tile.Get("cache"));
+      printf("  %-28s cache %s %.1f/%.1f+%.1fMiB\n", "",
+             cache.Get("priority").AsString().c_str(),
+             cache.Get("bytes").AsDouble() / (1 << 20),
+             cache.Get("max_bytes").AsDouble() / (1 << 20),
+             cache.Get("max_back_bytes").AsDouble() / (1 << 20));
+    }
+  }
+  pp::VarDictionary cache_budget(stats.Get("cache_budget"));
+  printf("  %-28s %.1f of %.1fMiB\n", "cache_budget",
+         cache_budget.Get("allocated").AsDouble() / (1 << 20),
+         cache_budget.Get("total").AsDouble() / (1 << 20));
+
+  if (!trace_file.empty() && recorder->trace.is_string()) {
+    std::string json = recorder->trace.AsString();
+    FILE* file = fopen(trace_file.c_str(), "wb");
+    if (file) {
+      fwrite(json.data(), 1, json.size(), file);
+      fclose(file);
+    }
+    printf("  %-28s %zu bytes to %s\n", "trace", json.size(),
+           trace_file.c_str());
+  }
+}
+
+// Creates and initializes an instance like the page's <embed>; null if
+// the plugin did not report ready.
+pp::Instance* StartInstance(pp::Module* module,
+                            Recorder* recorder,
+                            bool sw,
+                            int32_t tiles) {
+  recorder->ready = false;
+  pp::Instance* instance = module->CreateInstance(1);
+
+  std::string tiles_attr = std::to_string(tiles);
+  const char* argn[] = {"type", "renderer", "tiles"};
+  const char* argv_attr[] = {"application/x-player", sw ? "sw" : "auto",
+                             tiles_attr.c_str()};
+  instance->Init(tiles ? 3 : 2, argn, argv_attr);
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(5),
+                       [recorder] { return recorder->ready; });
+  if (!recorder->ready || !recorder->ready_result) {
+    delete instance;
+    return nullptr;
+  }
+  instance->DidChangeView(fake_ppapi::MakeView(1280, 720));
+  fake_ppapi::RunUntilIdle();
+  return instance;
+}
+
+// Elements destroyed and created again, like a channel switch on a wall
+// of tiles: time from creating the instance to ready and to its first
+// frame, and how many released players the pool took back. Each one adds
+// the on_load_fail hook as video.js does. Frames are only counted with
+// --sw.
+bool RunRestarts(pp::Module* module,
+                 pp::Instance** instance,
+                 Recorder* recorder,
+                 const std::vector<std::string>& files,
+                 bool sw,
+                 uint32_t restarts) {
+  Samples to_ready;
+  Samples to_frame;
+  for (uint32_t i = 0; i < restarts; i++) {
+    delete *instance;
+    *instance = nullptr;
+    // the next switch comes a moment later
+    fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(200));
+
+    auto start = Clock::now();
+    *instance = StartInstance(module, recorder, sw, 0);
+    if (!*instance) {
+      fprintf(stderr, "plugin init failed\n");
+      return false;
+    }
+    to_ready.Add(ElapsedUs(start, Clock::now()));
+
+    pp::VarDictionary hook;
+    hook.Set("name", "on_load_fail");
+    hook.Set("priority", -50);
+    hook.Set("id", 1);
+    (*instance)->HandleMessage(MakeRequest("hook_add", hook, 0));
+
+    uint64_t swaps = fake_ppapi::SwapCount();
+    (*instance)->HandleMessage(MakeRequest(
+        "command", MakeArray({"loadfile", files[0], "replace"}), 1));
+    // swaps come from the render thread, poll for the first one
+    auto deadline = Clock::now() + std::chrono::seconds(2);
+    while (fake_ppapi::SwapCount() == swaps && Clock::now() < deadline) {
+      fake_ppapi::RunUntil(
+          std::min(deadline, Clock::now() + std::chrono::milliseconds(1)));
+    }
+    if (fake_ppapi::SwapCount() > swaps)
+      to_frame.Add(ElapsedUs(start, Clock::now()));
+  }
+
+  printf("restarts (%u)\n", restarts);
+  to_ready.Print("create -> ready");
+  to_frame.Print("create -> first frame");
+
+  // the last release is reset on the pool's thread
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::milliseconds(200));
+  recorder->stats = pp::Var();
+  (*instance)->HandleMessage(MakeRequest("get_stats", pp::Var(), 8000000));
+  fake_ppapi::RunUntil(Clock::now() + std::chrono::seconds(2),
+                       [recorder] { return recorder->stats.is_dictionary(); });
+  if (recorder->stats.is_dictionary()) {
+    pp::VarDictionary pool(pp::VarDictionary(recorder->stats).Get("pool"));
+    printf("  %-28s reused=%.0f destroyed=%.0f idle=%.0f\n", "pool",
+           pool.Get("reused").AsDouble(), pool.Get("destroyed").AsDouble(),
+           pool.Get("idle").AsDouble());
+  }
+  return true;
+}
+
+void Usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--requests N] [--seconds S] [--no-observe] [--batch] "
+          "[--limits] [--typed] [--binary] [--diff] [--profiles N] "
+          "[--type-names] [--sw] [--resize] [--busy MS] [--tiles N] "
+          "[--restarts N] [--scrub N] [--grab N] [--burst DIR] [--stream MB] "
+          "[--scrcpy N] [--input N] [--log LEVELS] [--budget MS] [--quality] "
+          "[--cache MB] [--stats] [--trace FILE] [file ...]\n",
+          argv0);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  uint32_t requests = 20000;
+  double seconds = 5.0;
+  uint32_t profiles = 200;
+  bool observe = true;
+  bool batch = false;
+  bool limits = false;
+  bool typed = false;
+  bool binary = false;
+  bool diff = false;
+  bool sw = false;
+  bool resize = false;
+  int32_t busy_ms = 0;
+  int32_t tiles = 0;
+  uint32_t restarts = 0;
+  uint32_t scrub = 0;
+  int32_t grab = 0;
+  std::string burst;
+  bool stats = false;
+  std::string trace;
+  uint32_t stream = 0;
+  uint32_t scrcpy = 0;
+  uint32_t input = 0;
+  std::string log;
+  double budget_ms = 0;
+  bool quality = false;
+  double cache_mb = -1;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--requests") && i + 1 < argc) {
+      requests = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--profiles") && i + 1 < argc) {
+      profiles = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--scrub") && i + 1 < argc) {
+      scrub = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--stream") && i + 1 < argc) {
+      stream = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--stats")) {
+      stats = true;
+    } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+      trace = argv[++i];
+      stats = true;
+    } else if (!strcmp(argv[i], "--input") && i + 1 < argc) {
+      input = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--cache") && i + 1 < argc) {
+      cache_mb = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--quality")) {
+      quality = true;
+    } else if (!strcmp(argv[i], "--budget") && i + 1 < argc) {
+      budget_ms = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--log") && i + 1 < argc) {
+      log = argv[++i];
+    } else if (!strcmp(argv[i], "--scrcpy") && i + 1 < argc) {
+      scrcpy = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--burst") && i + 1 < argc) {
+      burst = argv[++i];
+    } else if (!strcmp(argv[i], "--grab") && i + 1 < argc) {
+      grab = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--restarts") && i + 1 < argc) {
+      restarts = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--tiles") && i + 1 < argc) {
+      tiles = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--busy") && i + 1 < argc) {
+      busy_ms = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--no-observe")) {
+      observe = false;
+    } else if (!strcmp(argv[i], "--batch")) {
+      batch = true;
+    } else if (!strcmp(argv[i], "--limits")) {
+      limits = true;
+    } else if (!strcmp(argv[i], "--typed")) {
+      typed = true;
+    } else if (!strcmp(argv[i], "--binary")) {
+      binary = true;
+    } else if (!strcmp(argv[i], "--sw")) {
+      sw = true;
+    } else if (!strcmp(argv[i], "--resize")) {
+      resize = true;
+    } else if (!strcmp(argv[i], "--type-names")) {
+      g_type_names = true;
+    } else if (!strcmp(argv[i], "--diff")) {
+      diff = true;
+    } else if (argv[i][0] == '-') {
+      Usage(argv[0]);
+      return 2;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  if (files.empty())
+    files.push_back(kDefaultSource);
+
+  Recorder recorder;
+  fake_ppapi::SetMessageSink(
+      [&recorder](PP_Instance, const pp::Var& msg) { recorder.OnMessage(msg); });
+
+  pp::Module* module = pp::CreateModule();
+  pp::Instance* instance = StartInstance(module, &recorder, sw, tiles);
+  if (!instance) {
+    fprintf(stderr, "plugin init failed\n");
+    return 1;
+  }
+
+  if (batch || binary || budget_ms > 0 || quality || cache_mb >= 0) {
+    pp::VarDictionary config;
+    if (batch)
+      config.Set("batch_events", true);
+    if (binary)
+      config.Set("binary_events", true);
+    if (budget_ms > 0) {
+      pp::VarDictionary resolution;
+      resolution.Set("budget_ms", budget_ms);
+      config.Set("dynamic_resolution", resolution);
+    }
+    if (quality)
+      config.Set("adaptive_quality", true);
+    if (cache_mb >= 0) {
+      config.Set("cache_budget_mb", cache_mb);
+      instance->DidChangeFocus(true);
+    }
+    instance->HandleMessage(MakeRequest("configure", config, 0));
+  }
+
+  if (requests)
+    RunRequests(instance, &recorder, requests);
+  if (profiles) {
+    RunProfiles(instance, &recorder, profiles, false);
+    RunProfiles(instance, &recorder, profiles, true);
+  }
+  if (!trace.empty()) {
+    pp::VarDictionary start;
+    start.Set("trace", true);
+    instance->HandleMessage(MakeRequest("get_stats", start, 0));
+    fake_ppapi::RunUntilIdle();
+  }
+  if (seconds > 0)
+    RunPlayback(instance, &recorder, files, seconds, observe, limits,
+                typed, diff, resize, busy_ms, tiles);
+  if (scrub)
+    RunScrub(instance, &recorder, files[0], scrub);
+  if (grab > 0)
+    RunGrab(instance, &recorder, files[0], grab);
+  if (stream)
+    RunStream(instance, &recorder, stream);
+  if (scrcpy)
+    RunScrcpy(instance, &recorder, scrcpy);
+  if (input)
+    RunInput(instance, &recorder, input);
+  if (!log.empty())
+    RunLog(instance, &recorder, files[0], log);
+  if (!burst.empty()) {
+    printf("burst (%s)\n", burst.c_str());
+    RunBurst(instance, &recorder, files[0], burst);
+  }
+  if (stats)
+    PrintStats(instance, &recorder, trace);
+  if (restarts && !RunRestarts(module, &instance, &recorder, files, sw, restarts))
+    return 1;
+
+  delete instance;
+  fake_ppapi::RunUntilIdle();
+  delete module;
+  return 0;
+}
@@ -0,0 +1,164 @@
+#include "cache_budget.h"
+
+#include <ppapi/cpp/core.h>
+#include <ppapi/cpp/module.h>
+#include <algorithm>
+
+namespace {
+
+// limits move in steps of this, so a cache that grows slowly isn't
+// given a new one every interval
+const int64_t kGranule = int64_t{1} << 20;
+
+}  // namespace
+
+CacheBudget::CacheBudget(int64_t total)
+    : total_(std::max<int64_t>(total, 0)), callback_factory_(this) {}
+
+void CacheBudget::Add(Client* client, uint32_t player, const Limits& own) {
+  Limits limits;
+  if (allocation(client, player, &limits, nullptr)) {
+    return;
+  }
+  players_.push_back({client, player, own, own, client->MeasureCache(player)});
+  Distribute();
+  Schedule();
+}
+
+void CacheBudget::Remove(Client* client) {
+  players_.erase(std::remove_if(players_.begin(), players_.end(),
+                                [client](const Player& player) {
+                                  return player.client == client;
+                                }),
+                 players_.end());
+}
+
+void CacheBudget::set_total(int64_t total) {
+  total_ = std::max<int64_t>(total, 0);
+  Distribute();
+}
+
+int64_t CacheBudget::allocated() const {
+  int64_t sum = 0;
+  for (const Player& player : players_) {
+    sum += player.limits.total();
+  }
+  return sum;
+}
+
+bool CacheBudget::allocation(const Client* client, uint32_t player,
+                             Limits* limits, Usage* usage) const {
+  for (const Player& entry : players_) {
+    if (entry.client == client && entry.id == player) {
+      *limits = entry.limits;
+      if (usage) {
+        *usage = entry.last;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* CacheBudget::PriorityName(Priority priority) {
+  switch (priority) {
+    case kFocused:
+      return "focused";
+    case kVisible:
+      return "visible";
+    default:
+      return "background";
+  }
+}
+
+int CacheBudget::Weight(Priority priority) {
+  return priority == kFocused ? 4 : priority == kVisible ? 2 : 1;
+}
+
+void CacheBudget::Schedule() {
+  if (scheduled_ || players_.empty()) {
+    return;
+  }
+  scheduled_ = true;
+  pp::Module::Get()->core()->CallOnMainThread(
+      kInterval, callback_factory_.NewCallback(&CacheBudget::Tick));
+}
+
+void CacheBudget::Tick(int32_t) {
+  scheduled_ = false;
+  for (Player& player : players_) {
+    player.last = player.client->MeasureCache(player.id);
+  }
+  Distribute();
+  Schedule();
+}
+
+// Water filling: players that want less than an even split by weight get
+// what they want, which raises the split for the rest, until everyone
+// left wants more than it.
+void CacheBudget::Distribute() {
+  size_t count = players_.size();
+  std::vector<int64_t> want(count);
+  for (size_t i = 0; i < count; i++) {
+    const Player& player = players_[i];
+    want[i] = player.own.total();
+    if (total_) {
+      int64_t grow = std::max(player.last.bytes * 2, kMinBytes);
+      want[i] = std::min(want[i], grow);
+    }
+  }
+  std::vector<int64_t> share(count, -1);
+  int64_t left = total_;
+  for (bool settled = !total_; !settled;) {
+    int64_t weights = 0;
+    for (size_t i = 0; i < count; i++) {
+      weights += share[i] < 0 ? Weight(players_[i].last.priority) : 0;
+    }
+    if (!weights) {
+      break;
+    }
+    settled = true;
+    int64_t split = left;
+    for (size_t i = 0; i < count; i++) {
+      int weight = Weight(players_[i].last.priority);
+      if (share[i] < 0 && want[i] <= split / weights * weight) {
+        share[i] = want[i];
+        left -= want[i];
+        settled = false;
+      }
+    }
+  }
+
+  int64_t weights = 0;
+  for (size_t i = 0; i < count; i++) {
+    weights += share[i] < 0 ? Weight(players_[i].last.priority) : 0;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (!total_) {
+      share[i] = want[i];
+    } else if (share[i] < 0) {
+      share[i] = std::max<int64_t>(left, 0) / weights * Weight(players_[i].last.priority);
+    }
+    Apply(&players_[i], share[i]);
+  }
+}
+
+void CacheBudget::Apply(Player* player, int64_t bytes) {
+  const Limits& own = player->own;
+  if (own.total() <= 0) {
+    return;
+  }
+  if (bytes < own.total()) {
+    bytes = std::max(bytes / kGranule * kGranule, std::min(bytes, kGranule));
+  }
+  Limits limits;
+  limits.ahead = static_cast<int64_t>(
+      static_cast<double>(bytes) * own.ahead / own.total());
+  limits.behind = bytes - limits.ahead;
+  if (limits.ahead == player->limits.ahead &&
+      limits.behind == player->limits.behind) {
+    return;
+  }
+  player->limits = limits;
+  player->client->ApplyCache(player->id, limits);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <ppapi/utility/completion_callback_factory.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// One memory budget for the demuxer caches of all players of the module.
+//
+// Each player caches up to its demuxer-max-bytes ahead and
+// demuxer-max-back-bytes behind, so a wall of streams can grow the
+// renderer until it is killed. Every kInterval the budget reads how much
+// each player holds and splits the total between them:
+//   - a player holding much less than its share gets twice what it holds,
+//     at least kMinBytes, so idle streams don't keep memory from the rest
+//   - the others split what is left by weight: focused 4, visible 2,
+//     background 1
+// No player gets more than its own limits, and the ahead and behind parts
+// keep their ratio. Main thread only.
+class CacheBudget {
+ public:
+  enum Priority { kBackground, kVisible, kFocused };
+
+  static constexpr int64_t kDefaultTotal = int64_t{512} << 20;
+  static constexpr int64_t kMinBytes = int64_t{2} << 20;
+  static constexpr int32_t kInterval = 2000;  // ms
+
+  struct Limits {
+    int64_t ahead;   // demuxer-max-bytes
+    int64_t behind;  // demuxer-max-back-bytes
+
+    int64_t total() const { return ahead + behind; }
+  };
+
+  struct Usage {
+    Priority priority;
+    int64_t bytes;  // cached, ahead and behind
+  };
+
+  class Client {
+   public:
+    // Usage as of the last interval or so.
+    virtual Usage MeasureCache(uint32_t player) = 0;
+    virtual void ApplyCache(uint32_t player, const Limits& limits) = 0;
+
+   protected:
+    ~Client() = default;
+  };
+
+  // |total| bytes, 0 for no budget.
+  explicit CacheBudget(int64_t total);
+
+  CacheBudget(const CacheBudget &) = delete;
+  CacheBudget &operator=(const CacheBudget &) = delete;
+
+  // |own| are the limits |player| has without the budget.
+  void Add(Client* client, uint32_t player, const Limits& own);
+  // Every player of |client|; the rest get what it had from the next
+  // interval.
+  void Remove(Client* client);
+
+  // Redistributes at once. 0 gives every player its own limits back.
+  void set_total(int64_t total);
+  int64_t total() const { return total_; }
+  // the sum of all players' limits
+  int64_t allocated() const;
+
+  // The limits and last usage of |player|; false if not budgeted.
+  bool allocation(const Client* client, uint32_t player,
+                  Limits* limits, Usage* usage) const;
+
+  static const char* PriorityName(Priority priority);
+
+ private:
+  struct Player {
+    Client* client;
+    uint32_t id;
+    Limits own;
+    Limits limits;  // as last applied
+    Usage last;
+  };
+
+  static int Weight(Priority priority);
+
+  void Schedule();
+  void Tick(int32_t);
+  void Distribute();
+  void Apply(Player* player, int64_t bytes);
+
+  std::vector<Player> players_;
+  int64_t total_;
+  bool scheduled_{false};
+
+  pp::CompletionCallbackFactory<CacheBudget> callback_factory_;
+};
@@ -0,0 +1,335 @@
+#include "event_encoder.h"
+
+#include <string.h>
+
+// Ids stay assigned, so events encoded before the reset remain valid:
+// Append() defines every atom they list again.
+void EventEncoder::Reset() {
+  atom_sent_.assign(atom_sent_.size(), false);
+  message_.clear();
+}
+
+int EventEncoder::Intern(const char* s) {
+  std::string_view key(s);
+  if (key.size() > kMaxAtomLength) {
+    return -1;
+  }
+  auto it = atom_ids_.find(key);
+  if (it != atom_ids_.end()) {
+    uint16_t id = it->second;
+    if (atom_listed_[id] != encode_serial_) {
+      atom_listed_[id] = encode_serial_;
+      event_->atoms.push_back(id);
+    }
+    return id;
+  }
+
+  if (atoms_.size() >= kMaxAtoms) {
+    return -1;
+  }
+
+  uint16_t id = static_cast<uint16_t>(atoms_.size());
+  atoms_.emplace_back(s);
+  atom_ids_.emplace(atoms_.back(), id);
+  atom_sent_.push_back(false);
+  atom_listed_.push_back(encode_serial_);
+  event_->atoms.push_back(id);
+  return id;
+}
+
+void EventEncoder::Put16(uint16_t v) {
+  Put8(v & 0xff);
+  Put8(v >> 8);
+}
+
+void EventEncoder::Put32(uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    Put8((v >> (i * 8)) & 0xff);
+  }
+}
+
+void EventEncoder::Put64(uint64_t v) {
+  for (int i = 0; i < 8; i++) {
+    Put8((v >> (i * 8)) & 0xff);
+  }
+}
+
+void EventEncoder::PutDouble(double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  Put64(bits);
+}
+
+void EventEncoder::PutBytes(const void* data, size_t size) {
+  auto p = static_cast<const uint8_t*>(data);
+  out_->insert(out_->end(), p, p + size);
+}
+
+void EventEncoder::PutString(const char* s) {
+  size_t len = s ? strlen(s) : 0;
+  PutTag(TAG_STRING);
+  Put32(static_cast<uint32_t>(len));
+  PutBytes(s, len);
+}
+
+void EventEncoder::PutAtom(const char* s) {
+  int id = Intern(s ? s : "");
+  if (id < 0) {
+    PutString(s);
+    return;
+  }
+  PutTag(TAG_ATOM);
+  Put16(static_cast<uint16_t>(id));
+}
+
+void EventEncoder::PutInt(int64_t v) {
+  if (v >= INT32_MIN && v <= INT32_MAX) {
+    PutTag(TAG_INT32);
+    Put32(static_cast<uint32_t>(static_cast<int32_t>(v)));
+  } else {
+    PutTag(TAG_INT64);
+    Put64(static_cast<uint64_t>(v));
+  }
+}
+
+void EventEncoder::PutNode(const mpv_node* node) {
+  switch (node->format) {
+    case MPV_FORMAT_STRING:
+      PutString(node->u.string);
+      break;
+    case MPV_FORMAT_FLAG:
+      PutTag(node->u.flag ? TAG_TRUE : TAG_FALSE);
+      break;
+    case MPV_FORMAT_INT64:
+      PutInt(node->u.int64);
+      break;
+    case MPV_FORMAT_DOUBLE:
+      PutTag(TAG_DOUBLE);
+      PutDouble(node->u.double_);
+      break;
+    case MPV_FORMAT_NODE_ARRAY:
+      PutTag(TAG_ARRAY);
+      Put32(static_cast<uint32_t>(node->u.list->num));
+      for (int i = 0; i < node->u.list->num; i++) {
+        PutNode(&node->u.list->values[i]);
+      }
+      break;
+    case MPV_FORMAT_NODE_MAP:
+      PutTag(TAG_MAP);
+      Put32(static_cast<uint32_t>(node->u.list->num));
+      for (int i = 0; i < node->u.list->num; i++) {
+        PutAtom(node->u.list->keys[i]);
+        PutNode(&node->u.list->values[i]);
+      }
+      break;
+    case MPV_FORMAT_BYTE_ARRAY:
+      PutTag(TAG_BYTES);
+      Put32(static_cast<uint32_t>(node->u.ba->size));
+      PutBytes(node->u.ba->data, node->u.ba->size);
+      break;
+    default:
+      PutTag(TAG_NONE);
+  }
+}
+
+size_t EventEncoder::BeginMap() {
+  PutTag(TAG_MAP);
+  size_t at = out_->size();
+  Put32(0);
+  return at;
+}
+
+void EventEncoder::EndMap(size_t at, uint32_t count) {
+  for (int i = 0; i < 4; i++) {
+    (*out_)[at + i] = (count >> (i * 8)) & 0xff;
+  }
+}
+
+// mirrors mpv_event_to_js in pepper.cc
+void EventEncoder::Encode(const mpv_event* event, const char* evname, int32_t tile, Event* out) {
+  out->bytes.clear();
+  out->atoms.clear();
+  out_ = &out->bytes;
+  event_ = out;
+  if (++encode_serial_ == 0) {
+    atom_listed_.assign(atom_listed_.size(), 0);
+    encode_serial_ = 1;
+  }
+
+  uint32_t count = 0;
+  size_t map = BeginMap();
+
+  PutAtom("event");
+  PutAtom(evname);
+  count++;
+
+  if (tile >= 0) {
+    PutAtom("tile");
+    PutInt(tile);
+    count++;
+  }
+
+  if (event->error < 0) {
+    PutAtom("error");
+    PutString(mpv_error_string(event->error));
+    count++;
+  }
+
+  // the client's part of the id, see tile_id() in pepper.cc
+  int32_t id = static_cast<int32_t>(event->reply_userdata & 0xffffffff);
+  if (id) {
+    PutAtom("id");
+    PutInt(id);
+    count++;
+  }
+
+  switch (event->event_id) {
+    case MPV_EVENT_START_FILE: {
+      auto esf = static_cast<mpv_event_start_file*>(event->data);
+      PutAtom("playlist_entry_id");
+      PutInt(esf->playlist_entry_id);
+      count++;
+      break;
+    }
+
+    case MPV_EVENT_END_FILE: {
+      auto eef = static_cast<mpv_event_end_file*>(event->data);
+
+      const char *reason;
+      switch (eef->reason) {
+        case MPV_END_FILE_REASON_EOF: reason = "eof"; break;
+        case MPV_END_FILE_REASON_STOP: reason = "stop"; break;
+        case MPV_END_FILE_REASON_QUIT: reason = "quit"; break;
+        case MPV_END_FILE_REASON_ERROR: reason = "error"; break;
+        case MPV_END_FILE_REASON_REDIRECT: reason = "redirect"; break;
+        default:
+          reason = "unknown";
+      }
+      PutAtom("reason");
+      PutAtom(reason);
+      PutAtom("playlist_entry_id");
+      PutInt(eef->playlist_entry_id);
+      count += 2;
+
+      if (eef->playlist_insert_id) {
+        PutAtom("playlist_insert_id");
+        PutInt(eef->playlist_insert_id);
+        PutAtom("playlist_insert_num_entries");
+        PutInt(eef->playlist_insert_num_entries);
+        count += 2;
+      }
+
+      if (eef->reason == MPV_END_FILE_REASON_ERROR) {
+        PutAtom("file_error");
+        PutString(mpv_error_string(eef->error));
+        count++;
+      }
+      break;
+    }
+
+    case MPV_EVENT_LOG_MESSAGE: {
+      auto msg = static_cast<mpv_event_log_message*>(event->data);
+      PutAtom("prefix");
+      PutAtom(msg->prefix);
+      PutAtom("level");
+      PutAtom(msg->level);
+      PutAtom("text");
+      PutString(msg->text);
+      count += 3;
+      break;
+    }
+
+    case MPV_EVENT_GET_PROPERTY_REPLY:
+    case MPV_EVENT_PROPERTY_CHANGE: {
+      auto prop = static_cast<mpv_event_property*>(event->data);
+
+      PutAtom("name");
+      PutAtom(prop->name);
+      count++;
+
+      switch (prop->format) {
+        case MPV_FORMAT_NODE:
+          PutAtom("data");
+          PutNode(static_cast<mpv_node*>(prop->data));
+          count++;
+          break;
+        case MPV_FORMAT_DOUBLE:
+          PutAtom("data");
+          PutTag(TAG_DOUBLE);
+          PutDouble(*static_cast<double*>(prop->data));
+          count++;
+          break;
+        case MPV_FORMAT_FLAG:
+          PutAtom("data");
+          PutTag(*static_cast<int*>(prop->data) ? TAG_TRUE : TAG_FALSE);
+          count++;
+          break;
+        case MPV_FORMAT_INT64:
+          PutAtom("data");
+          PutInt(*static_cast<int64_t*>(prop->data));
+          count++;
+          break;
+        case MPV_FORMAT_STRING:
+          PutAtom("data");
+          PutString(*static_cast<char**>(prop->data));
+          count++;
+          break;
+        default:;
+      }
+      break;
+    }
+
+    case MPV_EVENT_COMMAND_REPLY: {
+      auto cmd = static_cast<mpv_event_command*>(event->data);
+      PutAtom("result");
+      PutNode(&cmd->result);
+      count++;
+      break;
+    }
+
+    case MPV_EVENT_HOOK: {
+      auto hook = static_cast<mpv_event_hook*>(event->data);
+      PutAtom("hook_id");
+      PutInt(static_cast<int64_t>(hook->id));
+      count++;
+      break;
+    }
+
+    default:;
+  }
+
+  EndMap(map, count);
+  out_ = nullptr;
+  event_ = nullptr;
+}
+
+void EventEncoder::Append(const Event& event) {
+  if (event.empty()) {
+    return;
+  }
+
+  out_ = &message_;
+  for (uint16_t id : event.atoms) {
+    if (atom_sent_[id]) {
+      continue;
+    }
+    const std::string& atom = atoms_[id];
+    Put8(TAG_ATOM_DEF);
+    Put16(id);
+    Put16(static_cast<uint16_t>(atom.size()));
+    PutBytes(atom.data(), atom.size());
+    atom_sent_[id] = true;
+  }
+  PutBytes(event.bytes.data(), event.bytes.size());
+  out_ = nullptr;
+}
+
+pp::VarArrayBuffer EventEncoder::Take() {
+  pp::VarArrayBuffer buffer(static_cast<uint32_t>(message_.size()));
+  if (!message_.empty()) {
+    memcpy(buffer.Map(), message_.data(), message_.size());
+    buffer.Unmap();
+  }
+  message_.clear();
+  return buffer;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <ppapi/cpp/var_array_buffer.h>
+#include "client.h"
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compact wire format for mpv events, an opt-in alternative to one
+// pp::VarDictionary graph per event. Decoded by EventDecoder in
+// mpv-client.js into the same objects mpv_event_to_js produces.
+//
+// A message is a sequence of records, each either an atom definition
+//   ATOM_DEF u16 id, u16 length, utf8
+// or one event, encoded as a MAP value. A value is a tag byte followed by
+// its payload, little endian:
+//   NONE | FALSE | TRUE | INT32 i32 | INT64 i64 | DOUBLE f64
+//   STRING u32 length, utf8 | BYTES u32 length, data
+//   ARRAY u32 count, value... | MAP u32 count, (key value)...
+//   ATOM u16 id
+// Map keys, event names and property names are atoms: strings interned
+// once per session and sent as a 16 bit id afterwards. Keys longer than
+// kMaxAtomLength, mostly one-off metadata, and keys past the atom table
+// limit are sent as STRING.
+class EventEncoder {
+ public:
+  enum Tag : uint8_t {
+    TAG_NONE = 0,
+    TAG_FALSE = 1,
+    TAG_TRUE = 2,
+    TAG_INT32 = 3,
+    TAG_INT64 = 4,
+    TAG_DOUBLE = 5,
+    TAG_STRING = 6,
+    TAG_ARRAY = 7,
+    TAG_MAP = 8,
+    TAG_BYTES = 9,
+    TAG_ATOM = 10,
+    TAG_ATOM_DEF = 11,
+  };
+
+  // One encoded event, plus every atom it uses, each once. Events can be
+  // dropped before packing (coalesced or throttled) or packed after a
+  // Reset() without breaking the atom table.
+  struct Event {
+    std::vector<uint8_t> bytes;
+    std::vector<uint16_t> atoms;
+
+    bool empty() const { return bytes.empty(); }
+  };
+
+  // Starts a new session: the peer knows no atoms yet.
+  void Reset();
+
+  // Same fields as mpv_event_to_js; tile < 0 leaves the tile out.
+  void Encode(const mpv_event* event, const char* evname, int32_t tile, Event* out);
+
+  // Appends |event| to the message being built, preceded by the
+  // definitions of atoms it needs.
+  void Append(const Event& event);
+  bool has_pending() const { return !message_.empty(); }
+  // Returns the message built so far and starts a new one.
+  pp::VarArrayBuffer Take();
+
+ private:
+  static constexpr size_t kMaxAtoms = 4096;
+  static constexpr size_t kMaxAtomLength = 255;
+
+  int Intern(const char* s);
+
+  void PutTag(Tag tag) { Put8(tag); }
+  void Put8(uint8_t v) { out_->push_back(v); }
+  void Put16(uint16_t v);
+  void Put32(uint32_t v);
+  void Put64(uint64_t v);
+  void PutDouble(double v);
+  void PutBytes(const void* data, size_t size);
+
+  void PutString(const char* s);
+  void PutAtom(const char* s);
+  void PutInt(int64_t v);
+  void PutNode(const mpv_node* node);
+
+  size_t BeginMap();
+  void EndMap(size_t at, uint32_t count);
+
+  std::deque<std::string> atoms_;
+  std::unordered_map<std::string_view, uint16_t> atom_ids_;
+  std::vector<bool> atom_sent_;
+  // the Encode() that last listed the atom in its event
+  std::vector<uint32_t> atom_listed_;
+  uint32_t encode_serial_{0};
+
+  std::vector<uint8_t>* out_{nullptr};
+  Event* event_{nullptr};
+  std::vector<uint8_t> message_;
+};
@@ -0,0 +1,172 @@
+#include "js_stream.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// a waiting reader looks at cancel and EOF at least this often
+constexpr std::chrono::milliseconds kReadSlice(100);
+
+}  // namespace
+
+size_t JsStream::Write(const uint8_t* data, size_t size) {
+  size_t head = head_.load(std::memory_order_relaxed);
+  size_t tail = tail_.load(std::memory_order_acquire);
+  size_t count = std::min(size, kCapacity - (head - tail));
+  if (count < size) {
+    want_drain_ = true;
+  }
+
+  size_t start = head & (kCapacity - 1);
+  size_t first = std::min(count, kCapacity - start);
+  memcpy(&ring_[start], data, first);
+  memcpy(&ring_[0], data + first, count - first);
+  head_.store(head + count, std::memory_order_release);
+
+  if (count && reader_waiting_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    readable_.notify_one();
+  }
+  return count;
+}
+
+void JsStream::SetEof() {
+  eof_ = true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  readable_.notify_one();
+}
+
+size_t JsStream::Free() const {
+  return kCapacity - (head_.load(std::memory_order_relaxed) -
+                      tail_.load(std::memory_order_acquire));
+}
+
+void JsStream::SetWakeup(void (*wakeup)(void*), void* ctx) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  wakeup_ = wakeup;
+  wakeup_ctx_ = ctx;
+}
+
+int64_t JsStream::Read(char* buf, uint64_t size) {
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  size_t head = head_.load(std::memory_order_acquire);
+  while (head == tail) {
+    if (cancelled_) {
+      return -1;
+    }
+    if (eof_) {
+      // bytes written just before SetEof() still count
+      head = head_.load(std::memory_order_acquire);
+      if (head == tail) {
+        return 0;
+      }
+      break;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    reader_waiting_ = true;
+    readable_.wait_for(lock, kReadSlice, [this, tail] {
+      return head_.load(std::memory_order_acquire) != tail || eof_ ||
+             cancelled_;
+    });
+    reader_waiting_ = false;
+    head = head_.load(std::memory_order_acquire);
+  }
+
+  size_t count = std::min(static_cast<size_t>(size), head - tail);
+  size_t start = tail & (kCapacity - 1);
+  size_t first = std::min(count, kCapacity - start);
+  memcpy(buf, &ring_[start], first);
+  memcpy(buf + first, &ring_[0], count - first);
+  tail_.store(tail + count, std::memory_order_release);
+
+  // half empty again: worth a round trip to the page
+  if (want_drain_ && Free() >= kCapacity / 2 && want_drain_.exchange(false)) {
+    Signal();
+  }
+  return static_cast<int64_t>(count);
+}
+
+void JsStream::Cancel() {
+  cancelled_ = true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  readable_.notify_one();
+}
+
+void JsStream::Close() {
+  closed_ = true;
+  Signal();
+}
+
+void JsStream::Signal() {
+  signal_ = true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (wakeup_) {
+    wakeup_(wakeup_ctx_);
+  }
+}
+
+void JsStreams::Register(mpv_handle* mpv) {
+  // fails harmlessly on a pooled handle that already has it
+  mpv_stream_cb_add_ro(mpv, kProtocol, this, &JsStreams::Open);
+}
+
+std::shared_ptr<JsStream> JsStreams::Get(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::shared_ptr<JsStream>& stream = streams_[name];
+  if (!stream) {
+    stream = std::make_shared<JsStream>();
+  }
+  return stream;
+}
+
+void JsStreams::Remove(const std::string& name, const JsStream* stream) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = streams_.find(name);
+  if (it != streams_.end() && it->second.get() == stream) {
+    streams_.erase(it);
+  }
+}
+
+// The player's stream thread, on loadfile jsstream://<name>. The page may
+// push before or after this.
+int JsStreams::Open(void* user_data, char* uri, mpv_stream_cb_info* info) {
+  JsStreams* self = static_cast<JsStreams*>(user_data);
+  const size_t prefix = strlen(kProtocol) + strlen("://");
+  if (strlen(uri) <= prefix) {
+    return MPV_ERROR_LOADING_FAILED;
+  }
+  std::string name(uri + prefix);
+  std::shared_ptr<JsStream> stream = self->Get(name);
+  if (!stream->Open()) {
+    return MPV_ERROR_LOADING_FAILED;
+  }
+
+  info->cookie = new Reader{self, name, stream};
+  info->read_fn = &JsStreams::ReadFn;
+  info->seek_fn = nullptr;
+  info->size_fn = &JsStreams::SizeFn;
+  info->close_fn = &JsStreams::CloseFn;
+  info->cancel_fn = &JsStreams::CancelFn;
+  return 0;
+}
+
+int64_t JsStreams::ReadFn(void* cookie, char* buf, uint64_t size) {
+  return static_cast<Reader*>(cookie)->stream->Read(buf, size);
+}
+
+int64_t JsStreams::SizeFn(void*) {
+  return MPV_ERROR_UNSUPPORTED;
+}
+
+void JsStreams::CloseFn(void* cookie) {
+  Reader* reader = static_cast<Reader*>(cookie);
+  reader->stream->Close();
+  reader->streams->Remove(reader->name, reader->stream.get());
+  delete reader;
+}
+
+void JsStreams::CancelFn(void* cookie) {
+  static_cast<Reader*>(cookie)->stream->Cancel();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "client.h"
+#include "stream_cb.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Media bytes pushed from the page, read by mpv as jsstream://<name>.
+//
+// One JsStream is a single-producer, single-consumer ring: the plugin's
+// main thread writes chunks straight out of the page's ArrayBuffers, the
+// player's stream thread reads them. Neither side takes a lock to move
+// data; the mutex only parks a reader waiting for bytes. The stream is not
+// seekable, like a pipe.
+class JsStream {
+ public:
+  // 8 MiB, a power of two so positions wrap with a mask
+  static constexpr size_t kCapacity = size_t(1) << 23;
+
+  JsStream() : ring_(kCapacity) {}
+
+  JsStream(const JsStream &) = delete;
+  JsStream &operator=(const JsStream &) = delete;
+
+  // Writer side. Copies as much of |data| as fits, returns how much.
+  size_t Write(const uint8_t* data, size_t size);
+  // No more writes; the reader gets EOF once the ring is empty.
+  void SetEof();
+  size_t Free() const;
+  bool Closed() const { return closed_.load(); }
+  // Whether the stream drained or closed since the last call.
+  bool TakeSignal() { return signal_.exchange(false); }
+
+  // |wakeup| runs on the reading thread when the writer should look at
+  // the stream: it drained after a short write, or the player closed it.
+  // Null stops it; returns after a running call to the old one finished.
+  void SetWakeup(void (*wakeup)(void*), void* ctx);
+
+  // Reader side, the player's stream thread. Only one reader at a time.
+  bool Open() { return !opened_.exchange(true); }
+  int64_t Read(char* buf, uint64_t size);
+  void Cancel();
+  void Close();
+
+ private:
+  void Signal();
+
+  std::vector<uint8_t> ring_;
+  // total bytes written and read; only the writer stores head_, only the
+  // reader stores tail_
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+  std::atomic<bool> eof_{false};
+  std::atomic<bool> cancelled_{false};
+  std::atomic<bool> opened_{false};
+  std::atomic<bool> closed_{false};
+  // a write came up short; tell the writer once there is room again
+  std::atomic<bool> want_drain_{false};
+  std::atomic<bool> signal_{false};
+
+  std::mutex mutex_;
+  std::condition_variable readable_;
+  std::atomic<bool> reader_waiting_{false};
+  void (*wakeup_)(void*){nullptr};
+  void* wakeup_ctx_{nullptr};
+};
+
+// The jsstream:// protocol for all players of the module.
+//
+// Stream callbacks can't be removed from an mpv handle, and pooled handles
+// outlive their instances, so the protocol's state lives here, as long as
+// the module. Names are shared by the module's instances; the page picks
+// unique ones.
+class JsStreams {
+ public:
+  static constexpr const char* kProtocol = "jsstream";
+
+  // Makes |mpv| open jsstream:// URLs from this registry. Safe to repeat
+  // on a handle that already has it.
+  void Register(mpv_handle* mpv);
+
+  // The stream called |name|, created if needed.
+  std::shared_ptr<JsStream> Get(const std::string& name);
+  // Forgets |name|; readers already open keep their stream.
+  void Remove(const std::string& name, const JsStream* stream);
+
+ private:
+  struct Reader {
+    JsStreams* streams;
+    std::string name;
+    std::shared_ptr<JsStream> stream;
+  };
+
+  static int Open(void* user_data, char* uri, mpv_stream_cb_info* info);
+  static int64_t ReadFn(void* cookie, char* buf, uint64_t size);
+  static int64_t SizeFn(void* cookie);
+  static void CloseFn(void* cookie);
+  static void CancelFn(void* cookie);
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<JsStream>> streams_;
+};
@@ -0,0 +1,113 @@
+#include "log_buffer.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+struct LevelEntry {
+  const char *name;
+  mpv_log_level level;
+};
+
+// "status" never reaches clients, it asks for as much as "info"
+const LevelEntry kLevels[] = {
+    {"no", MPV_LOG_LEVEL_NONE},     {"fatal", MPV_LOG_LEVEL_FATAL},
+    {"error", MPV_LOG_LEVEL_ERROR}, {"warn", MPV_LOG_LEVEL_WARN},
+    {"info", MPV_LOG_LEVEL_INFO},   {"status", MPV_LOG_LEVEL_INFO},
+    {"v", MPV_LOG_LEVEL_V},         {"debug", MPV_LOG_LEVEL_DEBUG},
+    {"trace", MPV_LOG_LEVEL_TRACE},
+};
+
+bool parse_level(const std::string &name, mpv_log_level *level) {
+  for (const LevelEntry &entry : kLevels) {
+    if (name == entry.name) {
+      *level = entry.level;
+      return true;
+    }
+  }
+  return false;
+}
+
+// "ffmpeg" covers "ffmpeg/demuxer", as in mpv
+bool match_module(const std::string &module, const char *prefix) {
+  if (module == "all") {
+    return true;
+  }
+  size_t len = module.size();
+  return !strncmp(prefix, module.c_str(), len) &&
+         (prefix[len] == '\0' || prefix[len] == '/');
+}
+
+}  // namespace
+
+LogBuffer::LogBuffer() : lines_(kCapacity) {}
+
+bool LogBuffer::SetLevels(const std::string &spec) {
+  std::vector<std::pair<std::string, mpv_log_level>> modules;
+  size_t start = 0;
+  while (start <= spec.size()) {
+    size_t end = spec.find(',', start);
+    if (end == std::string::npos) {
+      end = spec.size();
+    }
+    std::string item = spec.substr(start, end - start);
+    start = end + 1;
+    if (item.empty()) {
+      continue;
+    }
+
+    size_t eq = item.find('=');
+    std::string module = eq == std::string::npos ? "all" : item.substr(0, eq);
+    mpv_log_level level;
+    if (module.empty() ||
+        !parse_level(eq == std::string::npos ? item : item.substr(eq + 1), &level)) {
+      return false;
+    }
+    modules.emplace_back(module, level);
+  }
+
+  modules_ = std::move(modules);
+  max_level_ = MPV_LOG_LEVEL_NONE;
+  for (const auto &module : modules_) {
+    max_level_ = std::max(max_level_, module.second);
+  }
+  return true;
+}
+
+const char *LogBuffer::mpv_level() const {
+  return LevelName(max_level_);
+}
+
+const char *LogBuffer::LevelName(mpv_log_level level) {
+  for (const LevelEntry &entry : kLevels) {
+    if (entry.level == level) {
+      return entry.name;
+    }
+  }
+  return "no";
+}
+
+mpv_log_level LogBuffer::LevelFor(const char *prefix) const {
+  for (auto it = modules_.rbegin(); it != modules_.rend(); ++it) {
+    if (match_module(it->first, prefix)) {
+      return it->second;
+    }
+  }
+  return MPV_LOG_LEVEL_NONE;
+}
+
+bool LogBuffer::Add(uint32_t tile, const mpv_event_log_message *msg) {
+  if (msg->log_level > LevelFor(msg->prefix)) {
+    return false;
+  }
+
+  // the strings keep their capacity, a warm ring adds without allocating
+  Line &line = lines_[next_ % kCapacity];
+  line.tile = tile;
+  line.level = msg->log_level;
+  line.prefix.assign(msg->prefix);
+  line.text.assign(msg->text);
+  next_++;
+  return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "client.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// mpv log messages, held in the plugin until the page fetches them.
+//
+// At verbose level a wall logs thousands of lines a second, and a message
+// per line swamps the renderer. Lines go into a fixed ring instead, the
+// oldest overwritten when the page falls behind, and leave in batches.
+// mpv takes a single level per handle, so per-module levels are applied
+// here to what the most verbose of them lets through. Main thread only.
+class LogBuffer {
+ public:
+  static constexpr size_t kCapacity = 4096;
+
+  struct Line {
+    uint32_t tile;
+    mpv_log_level level;
+    std::string prefix;
+    std::string text;
+  };
+
+  LogBuffer();
+
+  LogBuffer(const LogBuffer &) = delete;
+  LogBuffer &operator=(const LogBuffer &) = delete;
+
+  // |spec| in the syntax of mpv's msg-level, "all=warn,ffmpeg=v"; a bare
+  // level applies to all. Returns false, changing nothing, if it does not
+  // parse.
+  bool SetLevels(const std::string &spec);
+
+  // The level to ask mpv for, "no" when everything is off.
+  const char *mpv_level() const;
+  bool enabled() const { return max_level_ != MPV_LOG_LEVEL_NONE; }
+
+  // Returns false if the line's module filters it out.
+  bool Add(uint32_t tile, const mpv_event_log_message *msg);
+
+  // Hands lines not fetched yet, oldest first, at most |max|, to
+  // |out(line)|. Returns how many were overwritten unfetched since the
+  // last call.
+  template <typename F>
+  uint64_t Fetch(size_t max, F out) {
+    uint64_t dropped = 0;
+    if (next_ - read_ > kCapacity) {
+      dropped = next_ - read_ - kCapacity;
+      read_ = next_ - kCapacity;
+    }
+    for (; read_ < next_ && max; read_++, max--) {
+      out(lines_[read_ % kCapacity]);
+    }
+    return dropped;
+  }
+
+  size_t pending() const {
+    return next_ - read_ > kCapacity ? kCapacity : next_ - read_;
+  }
+
+  static const char *LevelName(mpv_log_level level);
+
+ private:
+  mpv_log_level LevelFor(const char *prefix) const;
+
+  // in order; the last match wins, as in mpv
+  std::vector<std::pair<std::string, mpv_log_level>> modules_;
+  mpv_log_level all_{MPV_LOG_LEVEL_NONE};
+  mpv_log_level max_level_{MPV_LOG_LEVEL_NONE};
+
+  std::vector<Line> lines_;
+  uint64_t next_{0};  // sequence number of the next line added
+  uint64_t read_{0};  // of the next line to fetch
+};
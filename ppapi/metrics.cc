@@ -0,0 +1,125 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+double bucket_limit(int bucket) {
+  return std::ldexp(1.0, bucket) / 1e6;
+}
+
+}  // namespace
+
+void Histogram::Add(double seconds) {
+  double us = seconds * 1e6;
+  int bucket = us < 1 ? 0 : std::min(static_cast<int>(std::log2(us)) + 1,
+                                     kBuckets - 1);
+  buckets_[bucket].store(buckets_[bucket].load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+  sum_.store(sum_.load(std::memory_order_relaxed) + seconds,
+             std::memory_order_relaxed);
+  if (seconds > max_.load(std::memory_order_relaxed)) {
+    max_.store(seconds, std::memory_order_relaxed);
+  }
+  count_.store(count_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+}
+
+Histogram::Summary Histogram::Summarize() const {
+  uint32_t buckets[kBuckets];
+  uint64_t total = 0;
+  for (int i = 0; i < kBuckets; i++) {
+    buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    total += buckets[i];
+  }
+  double max = max_.load(std::memory_order_relaxed);
+  auto percentile = [&](double p) {
+    uint64_t rank = static_cast<uint64_t>(std::ceil(p * total));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+      seen += buckets[i];
+      if (seen >= rank && seen) {
+        return std::min(bucket_limit(i), max);
+      }
+    }
+    return max;
+  };
+  Summary summary;
+  summary.count = count_.load(std::memory_order_relaxed);
+  summary.mean = summary.count
+      ? sum_.load(std::memory_order_relaxed) / summary.count : 0;
+  summary.p50 = percentile(0.5);
+  summary.p99 = percentile(0.99);
+  summary.max = max;
+  return summary;
+}
+
+void Histogram::Reset() {
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Trace::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  spans_.clear();
+  spans_.reserve(kCapacity);
+  next_ = 0;
+  wrapped_ = false;
+  origin_ = Clock::now();
+  enabled_ = true;
+}
+
+void Trace::Add(const char* name, Thread thread, int32_t tile,
+                Clock::time_point begin, Clock::time_point end) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::lock_guard<std::mutex> lock(mutex_);
+  Span span{name, thread, tile,
+            duration_cast<microseconds>(begin - origin_).count(),
+            duration_cast<microseconds>(end - begin).count()};
+  if (spans_.size() < kCapacity) {
+    spans_.push_back(span);
+  } else {
+    spans_[next_] = span;
+    wrapped_ = true;
+  }
+  next_ = (next_ + 1) % kCapacity;
+}
+
+std::string Trace::Json() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string json =
+      "{\"traceEvents\":["
+      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+      "\"args\":{\"name\":\"main\"}},"
+      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+      "\"args\":{\"name\":\"render\"}}";
+  json.reserve(json.size() + spans_.size() * 96);
+  size_t first = wrapped_ ? next_ : 0;
+  char line[160];
+  for (size_t n = 0; n < spans_.size(); n++) {
+    const Span& span = spans_[(first + n) % spans_.size()];
+    int length = snprintf(
+        line, sizeof(line),
+        ",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+        "\"ts\":%lld,\"dur\":%lld",
+        span.name, static_cast<unsigned>(span.thread),
+        static_cast<long long>(span.begin_us),
+        static_cast<long long>(span.duration_us));
+    json.append(line, length);
+    if (span.tile >= 0) {
+      length = snprintf(line, sizeof(line), ",\"args\":{\"tile\":%d}",
+                        span.tile);
+      json.append(line, length);
+    }
+    json += '}';
+  }
+  json += "]}";
+  return json;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Always-on performance counters.
+//
+// Every Histogram, Counter and Depth has a single writing thread, the
+// render or the main thread, so recording is a few relaxed atomic stores
+// and no lock. Another thread reading meanwhile may see one sample half
+// added, never a broken value.
+
+// Durations in log2 buckets of microseconds.
+class Histogram {
+ public:
+  // [0, 1us), [1, 2us), [2, 4us) ... [2^22us, inf), about 4.2s
+  static constexpr int kBuckets = 24;
+
+  struct Summary {
+    uint64_t count;
+    double mean;  // seconds
+    double p50;   // upper bound of the bucket
+    double p99;
+    double max;
+  };
+
+  Histogram() { Reset(); }
+
+  void Add(double seconds);
+  Summary Summarize() const;
+  // From the writing thread, or while it is idle; a sample added at the
+  // same time may survive.
+  void Reset();
+
+ private:
+  std::atomic<uint64_t> count_;
+  std::atomic<double> sum_;
+  std::atomic<double> max_;
+  std::atomic<uint32_t> buckets_[kBuckets];
+};
+
+class Counter {
+ public:
+  void Add(uint64_t n = 1) {
+    value_.store(value_.load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+  }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+  void Reset() { value_.store(0, std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// A queue length: the latest and the largest seen.
+class Depth {
+ public:
+  void Set(uint64_t depth) {
+    last_.store(depth, std::memory_order_relaxed);
+    if (depth > max_.load(std::memory_order_relaxed)) {
+      max_.store(depth, std::memory_order_relaxed);
+    }
+  }
+  uint64_t last() const { return last_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+  void Reset() { max_.store(last(), std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> last_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+// The last kCapacity begin/end spans of any thread while started, written
+// out as Chrome trace_event JSON for chrome://tracing or Perfetto. Off, a
+// span costs one relaxed load.
+class Trace {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kCapacity = size_t(1) << 16;
+
+  // the tid of a span
+  enum Thread : uint32_t {
+    THREAD_MAIN = 1,
+    THREAD_RENDER = 2,
+  };
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  // Starts over with an empty buffer.
+  void Start();
+  void Stop() { enabled_ = false; }
+
+  // |name| must outlive the trace; a string literal. |tile| is an argument
+  // of the span, -1 for none.
+  void Add(const char* name, Thread thread, int32_t tile,
+           Clock::time_point begin, Clock::time_point end);
+
+  // {"traceEvents": [...]}, oldest span first.
+  std::string Json();
+
+ private:
+  struct Span {
+    const char* name;
+    Thread thread;
+    int32_t tile;
+    int64_t begin_us;  // since origin_
+    int64_t duration_us;
+  };
+
+  std::atomic<bool> enabled_{false};
+  std::mutex mutex_;
+  std::vector<Span> spans_;
+  size_t next_{0};
+  bool wrapped_{false};
+  Clock::time_point origin_;
+};
+
+// Times its scope into a histogram and, while tracing, the trace.
+class ScopedSpan {
+ public:
+  ScopedSpan(Histogram* histogram, Trace* trace, const char* name,
+             Trace::Thread thread, int32_t tile = -1)
+      : histogram_(histogram), trace_(trace), name_(name), thread_(thread),
+        tile_(tile), begin_(Trace::Clock::now()) {}
+
+  ~ScopedSpan() {
+    Trace::Clock::time_point end = Trace::Clock::now();
+    histogram_->Add(std::chrono::duration<double>(end - begin_).count());
+    if (trace_->enabled()) {
+      trace_->Add(name_, thread_, tile_, begin_, end);
+    }
+  }
+
+  ScopedSpan(const ScopedSpan &) = delete;
+  ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+  // Seconds so far.
+  double elapsed() const {
+    return std::chrono::duration<double>(Trace::Clock::now() - begin_).count();
+  }
+
+ private:
+  Histogram* histogram_;
+  Trace* trace_;
+  const char* name_;
+  Trace::Thread thread_;
+  int32_t tile_;
+  Trace::Clock::time_point begin_;
+};
@@ -0,0 +1,176 @@
+#include "native_input.h"
+
+#include <ppapi/cpp/input_event.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Windows virtual key codes, as PPAPI reports them, of keys mpv names.
+struct KeyName {
+  uint32_t key_code;
+  const char* name;
+};
+
+const KeyName kKeyNames[] = {
+  {8, "BS"},        {9, "TAB"},        {13, "ENTER"},     {19, "PAUSE"},
+  {27, "ESC"},      {32, "SPACE"},     {33, "PGUP"},      {34, "PGDWN"},
+  {35, "END"},      {36, "HOME"},      {37, "LEFT"},      {38, "UP"},
+  {39, "RIGHT"},    {40, "DOWN"},      {44, "PRINT"},     {45, "INS"},
+  {46, "DEL"},      {112, "F1"},       {113, "F2"},       {114, "F3"},
+  {115, "F4"},      {116, "F5"},       {117, "F6"},       {118, "F7"},
+  {119, "F8"},      {120, "F9"},       {121, "F10"},      {122, "F11"},
+  {123, "F12"},     {173, "MUTE"},     {174, "VOLUME_DOWN"},
+  {175, "VOLUME_UP"}, {176, "NEXT"},   {177, "PREV"},     {178, "STOP"},
+  {179, "PLAYPAUSE"},
+};
+
+// Shift, Ctrl, Alt, caps and num lock, the Windows and menu keys
+bool is_modifier(uint32_t key_code) {
+  return (key_code >= 16 && key_code <= 18) || key_code == 20 ||
+         (key_code >= 91 && key_code <= 93) || key_code == 144;
+}
+
+std::string prefix(uint32_t modifiers, bool shift) {
+  std::string result;
+  if (shift && (modifiers & PP_INPUTEVENT_MODIFIER_SHIFTKEY)) {
+    result += "Shift+";
+  }
+  if (modifiers & PP_INPUTEVENT_MODIFIER_CONTROLKEY) {
+    result += "Ctrl+";
+  }
+  if (modifiers & PP_INPUTEVENT_MODIFIER_ALTKEY) {
+    result += "Alt+";
+  }
+  if (modifiers & PP_INPUTEVENT_MODIFIER_METAKEY) {
+    result += "Meta+";
+  }
+  return result;
+}
+
+// Size of the video at zoom 0: fitted into the player, keeping aspect.
+void fitted(double width, double height, double aspect,
+            double* fit_width, double* fit_height) {
+  *fit_width = width;
+  *fit_height = height;
+  if (aspect > 0 && height > 0) {
+    if (aspect > width / height) {
+      *fit_height = width / aspect;
+    } else {
+      *fit_width = height * aspect;
+    }
+  }
+}
+
+double clamp_pan(double pan) {
+  // an edge of the video at most as far as the center
+  return std::max(-0.5, std::min(pan, 0.5));
+}
+
+}  // namespace
+
+NativeInput::NativeInput()
+    : ignored_{"q", "Q", "ESC", "POWER", "STOP", "CLOSE_WIN", "Ctrl+c",
+               "AR_PLAY_HOLD", "AR_CENTER_HOLD"} {}
+
+uint32_t NativeInput::event_classes() const {
+  // wheel events carry no position, mouse moves tell where the pointer is
+  return (keys_ ? PP_INPUTEVENT_CLASS_KEYBOARD : 0) |
+         (mouse_ != POINTER_OFF || wheel_ != POINTER_OFF
+              ? PP_INPUTEVENT_CLASS_MOUSE : 0) |
+         (wheel_ != POINTER_OFF ? PP_INPUTEVENT_CLASS_WHEEL : 0);
+}
+
+void NativeInput::Configure(bool keys, Pointer mouse, Pointer wheel) {
+  keys_ = keys;
+  mouse_ = mouse;
+  wheel_ = wheel;
+  skip_char_ = false;
+}
+
+void NativeInput::SetIgnored(std::vector<std::string> ignored) {
+  ignored_ = std::move(ignored);
+}
+
+bool NativeInput::Ignored(const std::string& name) const {
+  return std::find(ignored_.begin(), ignored_.end(), name) != ignored_.end();
+}
+
+std::string NativeInput::KeyDown(uint32_t key_code, uint32_t modifiers) {
+  skip_char_ = false;
+  if (is_modifier(key_code)) {
+    return std::string();
+  }
+  for (const KeyName& key : kKeyNames) {
+    if (key.key_code == key_code) {
+      std::string name = key.name;
+      if (key_code == 13 && (modifiers & PP_INPUTEVENT_MODIFIER_ISKEYPAD)) {
+        name = "KP_ENTER";
+      }
+      // the char of Enter, Tab and Space would name it again
+      skip_char_ = true;
+      return prefix(modifiers, true) + name;
+    }
+  }
+
+  // with Ctrl or Alt the char is a control character or none at all
+  const uint32_t combo = PP_INPUTEVENT_MODIFIER_CONTROLKEY |
+                         PP_INPUTEVENT_MODIFIER_ALTKEY |
+                         PP_INPUTEVENT_MODIFIER_METAKEY;
+  if (!(modifiers & combo)) {
+    return std::string();
+  }
+  char c;
+  if (key_code >= 'A' && key_code <= 'Z') {
+    bool shift = modifiers & PP_INPUTEVENT_MODIFIER_SHIFTKEY;
+    c = static_cast<char>(shift ? key_code : key_code - 'A' + 'a');
+  } else if (key_code >= '0' && key_code <= '9') {
+    c = static_cast<char>(key_code);
+  } else {
+    return std::string();
+  }
+  skip_char_ = true;
+  return prefix(modifiers, false) + c;
+}
+
+std::string NativeInput::Char(const std::string& text) {
+  if (skip_char_) {
+    skip_char_ = false;
+    return std::string();
+  }
+  if (text.empty() || static_cast<unsigned char>(text[0]) < 0x20 ||
+      text == "\x7f") {
+    return std::string();
+  }
+  // mpv's input.conf syntax reserves #
+  return text == "#" ? "SHARP" : text;
+}
+
+NativeInput::View NativeInput::ZoomAt(const View& view, double steps,
+                                      double x, double y, double width,
+                                      double height, double aspect) {
+  double fit_width, fit_height;
+  fitted(width, height, aspect, &fit_width, &fit_height);
+  // wheel zoom stops at the fitted size, unless it was already below
+  double zoom = std::max(std::min(0.0, view.zoom),
+                         std::min(view.zoom + steps * kZoomStep, kMaxZoom));
+  if (zoom == 0) {
+    return View{0, 0, 0};
+  }
+  double scale = std::exp2(view.zoom);
+  double new_scale = std::exp2(zoom);
+  // the video's center moves so that the point under (x, y) stays put
+  double dx = (x - width / 2) / fit_width * (1 / new_scale - 1 / scale);
+  double dy = (y - height / 2) / fit_height * (1 / new_scale - 1 / scale);
+  return View{zoom, clamp_pan(view.pan_x + dx), clamp_pan(view.pan_y + dy)};
+}
+
+NativeInput::View NativeInput::PanBy(const View& view, double dx, double dy,
+                                     double width, double height,
+                                     double aspect) {
+  double fit_width, fit_height;
+  fitted(width, height, aspect, &fit_width, &fit_height);
+  double scale = std::exp2(view.zoom);
+  return View{view.zoom, clamp_pan(view.pan_x + dx / (fit_width * scale)),
+              clamp_pan(view.pan_y + dy / (fit_height * scale))};
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Keyboard, mouse and wheel input the plugin handles itself once the page
+// opts in with configure {input: {...}}, instead of the page building
+// keypress commands and crop() property writes.
+//
+// Keys become mpv key names. Special keys and combinations with Ctrl, Alt
+// or Meta are named from the key-down event; other keys from the char
+// event that follows, so the keyboard layout and Shift apply. Mouse and
+// wheel either go to mpv as they are or zoom and pan the view.
+class NativeInput {
+ public:
+  enum Pointer {
+    POINTER_OFF,
+    POINTER_MPV,   // mouse command and MBTN_* / WHEEL_* keys
+    POINTER_VIEW,  // drag pans, wheel zooms about the pointer
+  };
+
+  // Zoom and pan of a player, as mpv's video-zoom (log2 of the scale) and
+  // video-pan-x/y (fractions of the scaled video).
+  struct View {
+    double zoom;
+    double pan_x;
+    double pan_y;
+  };
+
+  // log2 zoom per wheel notch
+  static constexpr double kZoomStep = 0.125;
+  static constexpr double kMaxZoom = 5;
+
+  NativeInput();
+
+  bool keys() const { return keys_; }
+  Pointer mouse() const { return mouse_; }
+  Pointer wheel() const { return wheel_; }
+  // PP_INPUTEVENT_CLASS_* to request
+  uint32_t event_classes() const;
+
+  void Configure(bool keys, Pointer mouse, Pointer wheel);
+  // Key names left to the page; the default is the exit keys of mpv's
+  // default bindings, like mpv-client.js.
+  void SetIgnored(std::vector<std::string> ignored);
+  bool Ignored(const std::string& name) const;
+
+  // The mpv name for a key-down, empty when the name comes with the char
+  // event or the key is a modifier.
+  std::string KeyDown(uint32_t key_code, uint32_t modifiers);
+  // The mpv name for typed text, empty for control characters and for the
+  // char of a key KeyDown() already named.
+  std::string Char(const std::string& text);
+
+  // |view| zoomed by |steps| notches about (x, y), pixels from the top left
+  // of a |width| x |height| player, keeping that point of the video under
+  // it. |aspect| is the video's display aspect, 0 if unknown.
+  static View ZoomAt(const View& view, double steps, double x, double y,
+                     double width, double height, double aspect);
+  // |view| dragged by (dx, dy) pixels.
+  static View PanBy(const View& view, double dx, double dy,
+                    double width, double height, double aspect);
+
+ private:
+  bool keys_{false};
+  Pointer mouse_{POINTER_OFF};
+  Pointer wheel_{POINTER_OFF};
+  std::vector<std::string> ignored_;
+  bool skip_char_{false};
+};
@@ -0,0 +1,205 @@
+#include "node_arena.h"
+
+#include <ppapi/cpp/module.h>
+#include <ppapi/cpp/var_array.h>
+#include <ppapi/cpp/var_array_buffer.h>
+#include <ppapi/cpp/var_dictionary.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <string>
+
+static char *align_up(char *p, size_t align) {
+  uintptr_t v = reinterpret_cast<uintptr_t>(p);
+  return reinterpret_cast<char *>((v + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+NodeArena::NodeArena(size_t block_size)
+    : block_size_(block_size) {
+  ppb_var_ = static_cast<const PPB_Var *>(
+      pp::Module::Get()->GetBrowserInterface(PPB_VAR_INTERFACE));
+}
+
+NodeArena::~NodeArena() {
+  while (head_) {
+    Block *next = head_->next;
+    free(head_);
+    head_ = next;
+  }
+}
+
+void *NodeArena::Alloc(size_t size, size_t align) {
+  char *p = align_up(cursor_, align);
+  if (cursor_ && p + size <= end_) {
+    cursor_ = p + size;
+    return p;
+  }
+  return AllocSlow(size, align);
+}
+
+void *NodeArena::AllocSlow(size_t size, size_t align) {
+  size_t need = sizeof(Block) + align + size;
+  size_t block_size = need > block_size_ ? need : block_size_;
+
+  Block *block = static_cast<Block *>(malloc(block_size));
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  block->next = head_;
+  block->size = block_size;
+  head_ = block;
+
+  char *p = align_up(reinterpret_cast<char *>(block + 1), align);
+  cursor_ = p + size;
+  end_ = reinterpret_cast<char *>(block) + block_size;
+  return p;
+}
+
+void NodeArena::Reset() {
+  if (!head_) {
+    return;
+  }
+
+  // keep the oldest block, sized for the common message
+  while (head_->next) {
+    Block *next = head_->next;
+    free(head_);
+    head_ = next;
+  }
+  if (head_->size > block_size_) {
+    free(head_);
+    head_ = nullptr;
+    cursor_ = end_ = nullptr;
+    return;
+  }
+  cursor_ = reinterpret_cast<char *>(head_ + 1);
+  end_ = reinterpret_cast<char *>(head_) + head_->size;
+}
+
+char *NodeArena::CopyString(const pp::Var &var) {
+  const char *data = nullptr;
+  uint32_t len = 0;
+  std::string copy;
+
+  if (ppb_var_) {
+    data = ppb_var_->VarToUtf8(var.pp_var(), &len);
+  } else {
+    copy = var.AsString();
+    data = copy.data();
+    len = static_cast<uint32_t>(copy.size());
+  }
+
+  char *dst = static_cast<char *>(Alloc(len + 1, 1));
+  if (len) {
+    memcpy(dst, data, len);
+  }
+  dst[len] = '\0';
+  return dst;
+}
+
+char *NodeArena::CopyString(const char *s) {
+  size_t len = s ? strlen(s) : 0;
+  char *dst = static_cast<char *>(Alloc(len + 1, 1));
+  if (len) {
+    memcpy(dst, s, len);
+  }
+  dst[len] = '\0';
+  return dst;
+}
+
+mpv_node *NodeArena::NewList(mpv_node *dst, mpv_format format, int num) {
+  auto list = static_cast<mpv_node_list *>(Alloc(sizeof(mpv_node_list)));
+  list->num = num;
+  list->values = num ? static_cast<mpv_node *>(Alloc(sizeof(mpv_node) * num)) : nullptr;
+  list->keys = nullptr;
+  if (format == MPV_FORMAT_NODE_MAP && num) {
+    list->keys = static_cast<char **>(Alloc(sizeof(char *) * num));
+  }
+
+  dst->format = format;
+  dst->u.list = list;
+  return list->values;
+}
+
+void NodeArena::Build(const pp::Var &var, mpv_node *dst) {
+  if (var.is_string()) {
+    dst->format = MPV_FORMAT_STRING;
+    dst->u.string = CopyString(var);
+  } else if (var.is_bool()) {
+    dst->format = MPV_FORMAT_FLAG;
+    dst->u.flag = var.AsBool();
+  } else if (var.is_int()) {
+    dst->format = MPV_FORMAT_INT64;
+    dst->u.int64 = var.AsInt();
+  } else if (var.is_double()) {
+    dst->format = MPV_FORMAT_DOUBLE;
+    dst->u.double_ = var.AsDouble();
+  } else if (var.is_array()) {
+    pp::VarArray array(var);
+    int num = static_cast<int>(array.GetLength());
+    mpv_node *values = NewList(dst, MPV_FORMAT_NODE_ARRAY, num);
+    for (int i = 0; i < num; i++) {
+      Build(array.Get(i), &values[i]);
+    }
+  } else if (var.is_dictionary()) {
+    pp::VarDictionary dict(var);
+    pp::VarArray keys = dict.GetKeys();
+    int num = static_cast<int>(keys.GetLength());
+    mpv_node *values = NewList(dst, MPV_FORMAT_NODE_MAP, num);
+    for (int i = 0; i < num; i++) {
+      pp::Var key = keys.Get(i);
+      dst->u.list->keys[i] = CopyString(key);
+      Build(dict.Get(key), &values[i]);
+    }
+  } else if (var.is_array_buffer()) {
+    pp::VarArrayBuffer buffer(var);
+    uint32_t size = buffer.ByteLength();
+    auto ba = static_cast<mpv_byte_array *>(Alloc(sizeof(mpv_byte_array)));
+    ba->data = Alloc(size ? size : 1, 1);
+    ba->size = size;
+    if (size) {
+      memcpy(ba->data, buffer.Map(), size);
+      buffer.Unmap();
+    }
+    dst->format = MPV_FORMAT_BYTE_ARRAY;
+    dst->u.ba = ba;
+  } else {
+    dst->format = MPV_FORMAT_NONE;
+  }
+}
+
+void NodeArena::CopyNode(const mpv_node *src, mpv_node *dst) {
+  switch (src->format) {
+    case MPV_FORMAT_STRING:
+      dst->format = MPV_FORMAT_STRING;
+      dst->u.string = CopyString(src->u.string);
+      break;
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+      int num = src->u.list->num;
+      mpv_node *values = NewList(dst, src->format, num);
+      for (int i = 0; i < num; i++) {
+        if (src->format == MPV_FORMAT_NODE_MAP) {
+          dst->u.list->keys[i] = CopyString(src->u.list->keys[i]);
+        }
+        CopyNode(&src->u.list->values[i], &values[i]);
+      }
+      break;
+    }
+    case MPV_FORMAT_BYTE_ARRAY: {
+      size_t size = src->u.ba->size;
+      auto ba = static_cast<mpv_byte_array *>(Alloc(sizeof(mpv_byte_array)));
+      ba->data = Alloc(size ? size : 1, 1);
+      ba->size = size;
+      if (size) {
+        memcpy(ba->data, src->u.ba->data, size);
+      }
+      dst->format = MPV_FORMAT_BYTE_ARRAY;
+      dst->u.ba = ba;
+      break;
+    }
+    default:
+      *dst = *src;
+  }
+}
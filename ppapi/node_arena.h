@@ -0,0 +1,50 @@
+#pragma once
+
+#include <ppapi/c/ppb_var.h>
+#include <ppapi/cpp/var.h>
+#include "client.h"
+#include <stddef.h>
+
+// Builds mpv_node trees from JS values in a single pass. Nodes, lists, keys
+// and strings are bump-allocated from one block, so a whole command costs
+// at most one allocation and is released in bulk by Reset(). The first
+// block is kept, so steady-state messages don't allocate at all.
+class NodeArena {
+ public:
+  explicit NodeArena(size_t block_size = 16 * 1024);
+  ~NodeArena();
+
+  NodeArena(const NodeArena &) = delete;
+  NodeArena &operator=(const NodeArena &) = delete;
+
+  // Fills |dst| from |var|. Values with no mpv equivalent become
+  // MPV_FORMAT_NONE. The tree lives until the next Reset().
+  void Build(const pp::Var &var, mpv_node *dst);
+
+  // Makes |dst| an array or map of |num| nodes and returns the values.
+  mpv_node *NewList(mpv_node *dst, mpv_format format, int num);
+
+  // Deep copies |src| into the arena.
+  void CopyNode(const mpv_node *src, mpv_node *dst);
+
+  char *CopyString(const pp::Var &var);
+  char *CopyString(const char *s);
+  void *Alloc(size_t size, size_t align = alignof(max_align_t));
+
+  void Reset();
+
+ private:
+  struct Block {
+    Block *next;
+    size_t size;
+  };
+
+  void *AllocSlow(size_t size, size_t align);
+
+  size_t block_size_;
+  Block *head_{nullptr};  // current block, older ones follow
+  char *cursor_{nullptr};
+  char *end_{nullptr};
+
+  const PPB_Var *ppb_var_{nullptr};
+};
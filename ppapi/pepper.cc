@@ -1,4 +1,6 @@
-#include <locale.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
 
 #define GL_GLEXT_PROTOTYPES
 #include <GLES2/gl2.h>
@@ -6,16 +8,37 @@
 #include <ppapi/cpp/module.h>
 #include <ppapi/cpp/instance.h>
 #include <ppapi/cpp/var.h>
+#include <ppapi/cpp/var_array.h>
 #include <ppapi/cpp/var_dictionary.h>
 #include <ppapi/cpp/var_array_buffer.h>
 #include <ppapi/cpp/input_event.h>
 #include <ppapi/cpp/graphics_3d.h>
+#include <ppapi/cpp/message_loop.h>
 #include <ppapi/lib/gl/gles2/gl2ext_ppapi.h>
 #include <ppapi/utility/completion_callback_factory.h>
 #include "client.h"
 #include "render_gl.h"
-#include <variant>
+#include "cache_budget.h"
+#include "event_encoder.h"
+#include "js_stream.h"
+#include "log_buffer.h"
+#include "metrics.h"
+#include "native_input.h"
+#include "node_arena.h"
+#include "player_pool.h"
+#include "property_diff.h"
+#include "quality_governor.h"
+#include "render_scale.h"
+#include "screenshot_encoder.h"
+#include "scrcpy_control.h"
+#include "software_presenter.h"
+#include "thumbnailer.h"
+#include "tile_compositor.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 
@@ -110,7 +133,7 @@ static const std::unordered_map<std::string, void*> GL_CALLBACKS = {
   GLCB(BeginQueryEXT),
   GLCB(EndQueryEXT),
   // to make screenshot not crash (nullpoint)
-  {"glReadBuffer", dummyReadBuffer},
+  {"glReadBuffer", reinterpret_cast<void*>(dummyReadBuffer)},
   // Few functions are not available in PPAPI or doesn't work properly.
   {"glQueryCounterEXT", NULL},
   GLCB(IsQueryEXT),
@@ -121,200 +144,146 @@ static const std::unordered_map<std::string, void*> GL_CALLBACKS = {
   {"glGetTranslatedShaderSourceANGLE", NULL}
 };
 
-// use stl type to manage mv_node memory
-class NodeVarBase;
-
-template <typename TBase>
-class CppNodeT;
-
-using NodeVar = CppNodeT<NodeVarBase>;
-
-template <typename TBase>
-class CppNodeT : public TBase {
-private:
-  typename TBase::InnerType internal_;
-
-public:
-  CppNodeT(const CppNodeT &) = delete;
-  CppNodeT &operator=(const CppNodeT &) = delete;
-
-  CppNodeT(const pp::Var &var) {
-    construct(internal_, var);
-    build(internal_);
-  }
-
-  CppNodeT(CppNodeT &&other) {
-    internal_ = std::move(other.internal_);
-    build(internal_);
-  }
-
-  CppNodeT &operator=(CppNodeT &&other) {
-    internal_ = std::move(other.internal_);
-    build(internal_);
-    return *this;
-  }
-};
-
-class ArrayVarBase {
-  std::vector<mpv_node> _values; // represents mpv_node_list::values
-
-protected:
-  using InnerType = std::vector<NodeVar>;
-
-  void construct(InnerType &, const pp::Var &);
-  void build(const InnerType &);
-
-public:
-  mpv_node_list node; // represents mpv_node_list
-};
-
-class MapVarBase {
-  std::vector<mpv_node> _values; // represents mpv_node_list::values
-  std::vector<char*> _keys; // represents mpv_node_list::keys
+// In compositor mode each tile is a separate player with its own client
+// numbering, so request, observer and hook ids are scoped by tile: the
+// userdata handed to mpv is tile << 32 | id. Single player mode is tile 0.
+static uint64_t tile_id(uint32_t tile, uint64_t id) {
+  return static_cast<uint64_t>(tile) << 32 | (id & 0xffffffff);
+}
 
-protected:
-  using InnerType = std::vector<std::pair<std::string, NodeVar>>;
+static uint32_t tile_of(uint64_t userdata) {
+  return static_cast<uint32_t>(userdata >> 32);
+}
 
-  void construct(InnerType &, const pp::Var &);
-  void build(const InnerType &);
+static int32_t client_id(uint64_t userdata) {
+  return static_cast<int32_t>(userdata & 0xffffffff);
+}
 
-public:
-  mpv_node_list node; // represents mpv_node_list
+// Pixel layouts grab_frame returns.
+enum FrameFormat {
+  FRAME_RGBA,
+  FRAME_BGRA,
+  FRAME_GRAY,
 };
 
-class ByteArrayVarBase {
-protected:
-  using InnerType = std::vector<uint8_t>;
-
-  void construct(InnerType &internal, const pp::Var &var) {
-    pp::VarArrayBuffer array_buffer(var);
-    char* bytes = static_cast<char*>(array_buffer.Map());
-    uint32_t length = array_buffer.ByteLength();
-    internal.resize(length);
-    memcpy(&internal[0], bytes, length);
-  }
-
-  void build(const InnerType &internal) {
-    node.data = (void*)(&internal[0]);
-    node.size = internal.size();
-  }
+static const char* const kFrameFormatNames[] = {"rgba", "bgra", "gray"};
 
-public:
-  mpv_byte_array node; // represents mpv_byte_array
-};
+static int32_t frame_bytes_per_pixel(FrameFormat format) {
+  return format == FRAME_GRAY ? 1 : 4;
+}
 
-using ArrayVar = CppNodeT<ArrayVarBase>;
-using MapVar = CppNodeT<MapVarBase>;
-using ByteArrayVar = CppNodeT<ByteArrayVarBase>;
-
-class NodeVarBase {
-protected:
-  using InnerType = std::variant<bool, int, double, std::string, ArrayVar, MapVar, ByteArrayVar>;
-
-  void construct(InnerType &internal, const pp::Var &var) {
-    if (var.is_array_buffer()) {
-      internal = ByteArrayVar(var);
-    } else if (var.is_array()) {
-      internal = ArrayVar(var);
-    } else if (var.is_dictionary() || var.is_object()) {
-      internal = MapVar(var);
-    } else if (var.is_string()) {
-      std::string s = var.AsString();
-      internal = s;
-    } else if (var.is_bool()) {
-      bool v = var.AsBool();
-      internal = v;
-    } else if (var.is_int()) {
-      int v = var.AsInt();
-      internal = v;
-    } else if (var.is_double()) {
-      double v = var.AsDouble();
-      internal = v;
-    }
-  }
-
-  void build(const InnerType &internal) {
-    if (auto val = std::get_if<ArrayVar>(&internal)) {
-      node.format = MPV_FORMAT_NODE_ARRAY;
-      node.u.list = (mpv_node_list *)&val->node;
-    }
-    else if (auto val = std::get_if<MapVar>(&internal)) {
-      node.format = MPV_FORMAT_NODE_MAP;
-      node.u.list = (mpv_node_list *)&val->node;
-    }
-    else if (auto val = std::get_if<std::string>(&internal)) {
-      node.format = MPV_FORMAT_STRING;
-      node.u.string = (char *)val->c_str();
-    }
-    else if (auto val = std::get_if<bool>(&internal)) {
-      node.format = MPV_FORMAT_FLAG;
-      node.u.flag = (int)*val;
-    }
-    else if (auto val = std::get_if<int>(&internal)) {
-      node.format = MPV_FORMAT_INT64;
-      node.u.int64 = *val;
-    }
-    else if (auto val = std::get_if<double>(&internal)) {
-      node.format = MPV_FORMAT_DOUBLE;
-      node.u.double_ = *val;
-    }
-    else if (auto val = std::get_if<ByteArrayVar>(&internal)) {
-      node.format = MPV_FORMAT_BYTE_ARRAY;
-      node.u.ba = (mpv_byte_array *)&val->node;
-    } else {
-      node.format = MPV_FORMAT_NODE;
+// Scales 4-byte RGBX pixels (BGRX with |src_bgr|) to |width| x |height|
+// in |format|, nearest neighbour. |flip| takes the source's bottom row
+// first, as glReadPixels returns a flipped image.
+static void convert_frame(const uint8_t* src,
+                          int32_t src_width,
+                          int32_t src_height,
+                          size_t src_stride,
+                          bool src_bgr,
+                          bool flip,
+                          FrameFormat format,
+                          int32_t width,
+                          int32_t height,
+                          uint8_t* dst) {
+  const int r = src_bgr ? 2 : 0;
+  const int b = src_bgr ? 0 : 2;
+  // 16.16 source steps, no division per pixel
+  const uint64_t step_x = (static_cast<uint64_t>(src_width) << 16) / width;
+  for (int32_t y = 0; y < height; y++) {
+    int32_t src_y = static_cast<int32_t>(static_cast<int64_t>(y) * src_height / height);
+    if (flip) {
+      src_y = src_height - 1 - src_y;
+    }
+    const uint8_t* row = src + src_y * src_stride;
+    uint64_t src_x = 0;
+    for (int32_t x = 0; x < width; x++, src_x += step_x) {
+      const uint8_t* px = row + (src_x >> 16) * 4;
+      switch (format) {
+        case FRAME_RGBA:
+          dst[0] = px[r];
+          dst[1] = px[1];
+          dst[2] = px[b];
+          dst[3] = 0xff;
+          dst += 4;
+          break;
+        case FRAME_BGRA:
+          dst[0] = px[b];
+          dst[1] = px[1];
+          dst[2] = px[r];
+          dst[3] = 0xff;
+          dst += 4;
+          break;
+        case FRAME_GRAY:
+          // BT.601 luma
+          *dst++ = static_cast<uint8_t>((77 * px[r] + 150 * px[1] + 29 * px[b]) >> 8);
+          break;
+      }
     }
-  }
-
-public:
-  mpv_node node; // represents mpv_node
-};
-
-void ArrayVarBase::construct(InnerType &internal, const pp::Var &var) {
-  pp::VarArray array(var);
-
-  for (uint32_t i = 0; i < array.GetLength(); ++i) {
-    auto node = array.Get(i);
-    internal.push_back(NodeVar(node));
   }
 }
 
-void ArrayVarBase::build(const InnerType &internal) {
-  _values.resize(internal.size());
-
-  for (size_t i = 0; i < internal.size(); i++) {
-    _values[i] = internal[i].node;
+// JS numbers hold 53 bits; keep small values as int like the node path.
+static Var int64_to_var(int64_t value) {
+  if (value >= INT32_MIN && value <= INT32_MAX) {
+    return Var(static_cast<int32_t>(value));
   }
-  node.keys = nullptr;
-  node.num = (int)_values.size();
-  node.values = &_values[0];
+  return Var(static_cast<double>(value));
 }
 
-void MapVarBase::construct(InnerType &internal, const pp::Var &var) {
-  pp::VarDictionary dict(var);
-
-  for (uint32_t i = 0; i < dict.GetKeys().GetLength(); ++i) {
-    pp::Var key = dict.GetKeys().Get(i);
-    auto node = dict.Get(key);
-
-    internal.push_back({ key.AsString(), NodeVar(node) });
+// Format requested for observe/get. Scalars skip the mpv_node tree.
+static mpv_format format_from_var(const Var& value) {
+  if (!value.is_string()) {
+    return MPV_FORMAT_NODE;
+  }
+  std::string format = value.AsString();
+  if (format == "double") {
+    return MPV_FORMAT_DOUBLE;
+  } else if (format == "flag") {
+    return MPV_FORMAT_FLAG;
+  } else if (format == "int64") {
+    return MPV_FORMAT_INT64;
+  } else if (format == "string") {
+    return MPV_FORMAT_STRING;
   }
+  return MPV_FORMAT_NODE;
 }
 
-void MapVarBase::build(const InnerType &internal) {
-  size_t size = internal.size();
-
-  _values.resize(size);
-  _keys.resize(size);
+// Scalar JS value as the data argument of mpv_set_property.
+struct PropertyValue {
+  mpv_format format{MPV_FORMAT_NONE};
+  std::string string;
+  const char* cstr{nullptr};
+  int flag{0};
+  int64_t int64{0};
+  double double_{0};
+
+  explicit PropertyValue(const Var& value) {
+    if (value.is_string()) {
+      format = MPV_FORMAT_STRING;
+      string = value.AsString();
+      cstr = string.c_str();
+    } else if (value.is_bool()) {
+      format = MPV_FORMAT_FLAG;
+      flag = value.AsBool();
+    } else if (value.is_int()) {
+      format = MPV_FORMAT_INT64;
+      int64 = value.AsInt();
+    } else if (value.is_double()) {
+      format = MPV_FORMAT_DOUBLE;
+      double_ = value.AsDouble();
+    }
+  }
 
-  for (size_t i = 0; i < size; i++) {
-    _keys[i] = (char*)internal[i].first.c_str();
-    _values[i] = internal[i].second.node;
+  void* data() {
+    switch (format) {
+      case MPV_FORMAT_STRING: return &cstr;
+      case MPV_FORMAT_FLAG: return &flag;
+      case MPV_FORMAT_INT64: return &int64;
+      case MPV_FORMAT_DOUBLE: return &double_;
+      default: return nullptr;
+    }
   }
-  node.keys = &_keys[0];
-  node.num = (int)_values.size();
-  node.values = &_values[0];
-}
+};
 
 static Var node_to_var(const mpv_node* node) {
   if (node->format == MPV_FORMAT_NONE) {
@@ -344,6 +313,35 @@ static Var node_to_var(const mpv_node* node) {
   return Var::Null();
 }
 
+// Numeric value of a scalar property, for change thresholds.
+static bool property_to_double(const mpv_event_property* prop, double* out) {
+  if (!prop->data) {
+    return false;
+  }
+
+  mpv_format format = prop->format;
+  const void* data = prop->data;
+  if (format == MPV_FORMAT_NODE) {
+    auto node = static_cast<const mpv_node*>(data);
+    format = node->format;
+    data = &node->u;
+  }
+
+  switch (format) {
+    case MPV_FORMAT_DOUBLE:
+      *out = *static_cast<const double*>(data);
+      return true;
+    case MPV_FORMAT_INT64:
+      *out = static_cast<double>(*static_cast<const int64_t*>(data));
+      return true;
+    case MPV_FORMAT_FLAG:
+      *out = *static_cast<const int*>(data);
+      return true;
+    default:
+      return false;
+  }
+}
+
 static std::string var_to_string(const Var& value) {
   if (value.is_string()) {
     return value.AsString();
@@ -360,10 +358,13 @@ static std::string var_to_string(const Var& value) {
   return "";
 }
 
-// clone from mpv_event_to_node
-static Var mpv_event_to_js(const mpv_event* event, const char* evname) {
+// clone from mpv_event_to_node; tile < 0 leaves the tile out
+static Var mpv_event_to_js(const mpv_event* event, const char* evname, int32_t tile) {
   pp::VarDictionary dst;
   dst.Set("event", Var(evname));
+  if (tile >= 0) {
+    dst.Set("tile", Var(tile));
+  }
 
   if (!event) {
     return dst;
@@ -373,8 +374,8 @@ static Var mpv_event_to_js(const mpv_event* event, const char* evname) {
     dst.Set("error", Var(mpv_error_string(event->error)));
   }
 
-  if (event->reply_userdata)
-    dst.Set("id", Var(static_cast<int>(event->reply_userdata)));
+  if (client_id(event->reply_userdata))
+    dst.Set("id", Var(client_id(event->reply_userdata)));
 
   switch (event->event_id) {
     case MPV_EVENT_START_FILE: {
@@ -442,7 +443,10 @@ static Var mpv_event_to_js(const mpv_event* event, const char* evname) {
           dst.Set("data", Var(*(double *)prop->data));
           break;
         case MPV_FORMAT_FLAG:
-          dst.Set("data", Var(*(int *)prop->data));
+          dst.Set("data", Var(static_cast<bool>(*(int *)prop->data)));
+          break;
+        case MPV_FORMAT_INT64:
+          dst.Set("data", int64_to_var(*(int64_t *)prop->data));
           break;
         case MPV_FORMAT_STRING:
           dst.Set("data", Var(*(char **)prop->data));
@@ -468,30 +472,93 @@ static Var mpv_event_to_js(const mpv_event* event, const char* evname) {
   return dst;
 }
 
-class MPVInstance : public pp::Instance {
+class MPVInstance : public pp::Instance,
+                    public QualityGovernor::Client,
+                    public CacheBudget::Client {
  public:
-  explicit MPVInstance(PP_Instance instance)
+  MPVInstance(PP_Instance instance, PlayerPool* pool, JsStreams* streams,
+              QualityGovernor* governor, CacheBudget* cache_budget)
       : pp::Instance(instance)
-      , callback_factory_(this) {
-    // RequestInputEvents(PP_INPUTEVENT_CLASS_MOUSE);
-  }
+      , pool_(pool)
+      , streams_(streams)
+      , governor_(governor)
+      , cache_budget_(cache_budget)
+      , callback_factory_(this) {}
 
   ~MPVInstance() override {
-    if (mpv_gl_) {
-      glSetCurrentContextPPAPI(context_.pp_resource());
-      mpv_render_context_free(mpv_gl_);
+    governor_->Remove(this);
+    cache_budget_->Remove(this);
+    // players still reading see the end of the stream
+    for (auto &stream : js_streams_) {
+      stream.second->SetWakeup(nullptr, nullptr);
+      stream.second->SetEof();
+      streams_->Remove(stream.first, stream.second.get());
+    }
+    // stops its worker, no wakeups after this
+    thumbnailer_.reset();
+    if (render_thread_.joinable()) {
+      render_loop_.PostWork(
+          callback_factory_.NewCallback(&MPVInstance::ShutdownRender));
+      render_thread_.join();
+    }
+    screenshot_encoder_.reset();
+    for (auto &tile : tiles_) {
+      pool_->Release(tile->mpv, std::move(tile->observed),
+                     std::move(tile->touched), !tile->hooked);
     }
-    mpv_terminate_destroy(mpv_);
   }
 
   bool Init(uint32_t argc, const char *argn[], const char *argv[]) override {
-    bool result = InitGL() && InitMPV();
+    // renderer="gl" or "sw"; by default software only when GL fails
+    std::string renderer = "auto";
+    // tiles="N": compositor mode, N players on one surface
+    int tiles = 0;
+    for (uint32_t i = 0; i < argc; i++) {
+      if (!strcmp(argn[i], "renderer")) {
+        renderer = argv[i];
+      } else if (!strcmp(argn[i], "tiles")) {
+        tiles = std::max(1, std::min(atoi(argv[i]), kMaxTiles));
+      }
+    }
 
-    pp::VarDictionary dict;
-    dict.Set(pp::Var("type"), pp::Var("ready"));
-    dict.Set(pp::Var("data"), Var(result));
-    PostMessage(dict);
-    return result;
+    compositor_ = tiles > 0;
+    for (int i = 0; i < std::max(tiles, 1); i++) {
+      tiles_.push_back(std::make_unique<Tile>(this, i));
+    }
+    if (compositor_) {
+      // a grid until the page sets a layout
+      int columns = static_cast<int>(ceil(sqrt(tiles)));
+      int rows = (tiles + columns - 1) / columns;
+      for (int i = 0; i < tiles; i++) {
+        tiles_[i]->rect = {static_cast<float>(i % columns) / columns,
+                           static_cast<float>(i / columns) / rows,
+                           1.0f / columns, 1.0f / rows};
+        tiles_[i]->layout = tiles_[i]->rect;
+      }
+    }
+
+    bool result = renderer != "sw" && InitGL();
+    if (!result && renderer != "gl") {
+      presenter_ = std::make_unique<SoftwarePresenter>(this);
+      result = true;
+    }
+    result = result && InitMPV();
+    if (!result) {
+      PostReady(false);
+      return false;
+    }
+    for (auto &tile : tiles_) {
+      AddToCacheBudget(tile.get());
+    }
+
+    // "ready" is posted once the render thread has its mpv render context
+    render_loop_ = pp::MessageLoop(this);
+    render_thread_ = std::thread([this] {
+      render_loop_.AttachToCurrentThread();
+      InitRender(PP_OK);
+      render_loop_.Run();
+    });
+    return true;
   }
 
   void DidChangeView(const pp::View& view) override {
@@ -501,307 +568,3094 @@ class MPVInstance : public pp::Instance {
         view.GetRect().height() * view.GetDeviceScale());
     // printf("@@@ RESIZE %d %d\n", new_width, new_height);
 
-    // Always called on main thread so don't need locks.
-    context_.ResizeBuffers(new_width, new_height);
-    viewWidth_ = new_width;
-    viewHeight_ = new_height;
-    OnGetFrame(0);
+    // Picked up by the render thread; only the latest view matters.
+    ViewState state{};
+    if (view.IsVisible() && new_width > 0 && new_height > 0) {
+      state.width = static_cast<uint16_t>(std::min(new_width, 0xffff));
+      state.height = static_cast<uint16_t>(std::min(new_height, 0xffff));
+      state.scale = view.GetDeviceScale();
+    }
+    view_state_.store(state);
+    PostRenderUpdate();
+  }
+
+  // the cache budget favours the focused instance's players
+  void DidChangeFocus(bool has_focus) override {
+    focused_ = has_focus;
   }
 
-  /*
+  // Only the classes requested with configure {input} arrive here. Events
+  // the plugin doesn't take (returns false) go on to the page.
   bool HandleInputEvent(const pp::InputEvent& event) override {
     switch (event.GetType()) {
+      case PP_INPUTEVENT_TYPE_RAWKEYDOWN:
+      case PP_INPUTEVENT_TYPE_KEYDOWN: {
+        pp::KeyboardInputEvent key(event);
+        return input_.keys() &&
+               SendKey(input_.KeyDown(key.GetKeyCode(), key.GetModifiers()));
+      }
+      case PP_INPUTEVENT_TYPE_CHAR: {
+        Var text = pp::KeyboardInputEvent(event).GetCharacterText();
+        return input_.keys() &&
+               SendKey(input_.Char(text.is_string() ? text.AsString() : ""));
+      }
       case PP_INPUTEVENT_TYPE_MOUSEDOWN:
-        printf("--------------------PP_INPUTEVENT_TYPE_MOUSEDOWN-----\n");
-        return false;
+      case PP_INPUTEVENT_TYPE_MOUSEUP:
       case PP_INPUTEVENT_TYPE_MOUSEMOVE:
-        printf("--------------------PP_INPUTEVENT_TYPE_MOUSEMOVE-----\n");
-        return false;
+        return HandleMouse(pp::MouseInputEvent(event));
+      case PP_INPUTEVENT_TYPE_WHEEL:
+        return HandleWheel(pp::WheelInputEvent(event));
       default:
         return false;
     }
-    return false;
   }
-  */
 
   void HandleMessage(const Var& msg) override {
     pp::VarDictionary dict(msg);
-    std::string type = dict.Get("type").AsString();
-    pp::Var data = dict.Get("data");
-    pp::Var var_id = dict.Get("id");
-    const uint64_t id = var_id.is_number() ? (uint64_t)var_id.AsInt(): 0;
-
-    if (type == "command") {
-      if (data.is_string()) {
-        // construct as node array
-        pp::VarArray array;
-        array.Set(0, data);
-
-        NodeVar nodevar(array);
-        int rc = mpv_command_node_async(mpv_, id, &nodevar.node);
-        if (rc < 0) {
-          PostCommandFail(id, rc, nullptr);
-        }
-      } else {
-        NodeVar nodevar(data);
-        
-        if (nodevar.node.format == MPV_FORMAT_NONE) {
-          PostCommandFail(id, -1, "bad command format");
-        } else {
-          int rc = mpv_command_node_async(mpv_, id, &nodevar.node);
-          if (rc < 0) {
-            PostCommandFail(id, rc, nullptr);
-          }
-        }
-      }
-    }  else if (type == "set_property") {
-      pp::VarDictionary data_dict(data);
-      std::string name = data_dict.Get("name").AsString();
-      pp::Var value = data_dict.Get("value");
-      if (value.is_string()) {
-        std::string value_string = value.AsString();
-        const char* value_cstr = value_string.c_str();
-        mpv_set_property_async(mpv_, id, name.c_str(), MPV_FORMAT_STRING, &value_cstr);
-      } else if (value.is_bool()) {
-        int value_bool = value.AsBool();
-        mpv_set_property_async(mpv_, id, name.c_str(), MPV_FORMAT_FLAG, &value_bool);
-      } else if (value.is_int()) {
-        int64_t value_int = value.AsInt();
-        mpv_set_property_async(mpv_, id, name.c_str(), MPV_FORMAT_INT64, &value_int);
-      } else if (value.is_double()) {
-        double value_double = value.AsDouble();
-        mpv_set_property_async(mpv_, id, name.c_str(), MPV_FORMAT_DOUBLE, &value_double);
-      }
-    } else if (type == "observe_property") {
-      std::string name = data.AsString();
-      mpv_observe_property(mpv_, id, name.c_str(), MPV_FORMAT_NODE);
-    }  else if (type == "unobserve_property") {
-      uint64_t id = data.AsInt();
-      mpv_unobserve_property(mpv_, id);
-    } else if (type == "get_property_async") {
-      std::string name = data.AsString();
-      mpv_get_property_async(mpv_, id, name.c_str(), MPV_FORMAT_NODE);
-    } else if (type == "hook_continue") {
-      mpv_hook_continue(mpv_, data.AsInt());
-    } else if (type == "hook_add") {
-      pp::VarDictionary data_dict(data);
-      std::string name = data_dict.Get("name").AsString();
-      uint64_t id = data_dict.Get("id").AsInt();
-      int priority = data_dict.Get("priority").AsInt();
-      mpv_hook_add(mpv_, id, name.c_str(), priority);
-    } else if (type == "set_option") {
-      pp::VarDictionary data_dict(data);
-      std::string name = data_dict.Get("name").AsString();
-      std::string value = data_dict.Get("value").AsString();
-      mpv_set_option_string(mpv_, name.c_str(), value.c_str());
+    RequestOp op = RequestOpOf(dict);
+    Var var_id = dict.Get(keys_.id);
+    Var var_tile = dict.Get(keys_.tile);
+    const uint32_t tile = var_tile.is_int() ? var_tile.AsInt() : 0;
+    const uint64_t id = tile_id(tile, var_id.is_number() ? var_id.AsInt() : 0);
+
+    if (op == OP_NONE || tile >= tiles_.size()) {
+      return;
+    }
+
+    PP_TimeTicks start = Now();
+    (this->*kRequestHandlers[op].handle)(id, dict.Get(keys_.data));
+
+    double elapsed = Now() - start;
+    RequestStats& stats = request_stats_[op];
+    stats.count++;
+    stats.total += elapsed;
+    if (elapsed > stats.max) {
+      stats.max = elapsed;
     }
   }
 
  private:
-  static void* GetProcAddressMPV(void* fn_ctx, const char* name) {
-    auto search = GL_CALLBACKS.find(name);
-    if (search == GL_CALLBACKS.end()) {
-      fprintf(stderr, "FIXME: missed GL function %s\n", name);
-      return NULL;
-    } else {
-      return search->second;
+  // Request types. A message names one by {type: "command"} or, without
+  // the string compare, by {op: 1}; requestOps in mpv-client.js mirrors
+  // these numbers.
+  enum RequestOp {
+    OP_NONE = 0,
+    OP_COMMAND = 1,
+    OP_SET_PROPERTY = 2,
+    OP_OBSERVE_PROPERTY = 3,
+    OP_UNOBSERVE_PROPERTY = 4,
+    OP_GET_PROPERTY_ASYNC = 5,
+    OP_RESYNC_PROPERTY = 6,
+    OP_HOOK_CONTINUE = 7,
+    OP_HOOK_ADD = 8,
+    OP_SET_OPTION = 9,
+    OP_CONFIGURE = 10,
+    OP_BATCH = 11,
+    OP_GET_REQUEST_STATS = 12,
+    OP_SET_LAYOUT = 13,
+    OP_THUMBNAIL = 14,
+    OP_GRAB_FRAME = 15,
+    OP_SCREENSHOT = 16,
+    OP_STREAM_PUSH = 17,
+    OP_SCRCPY = 18,
+    OP_GET_STATS = 19,
+    OP_LOG = 20,
+    OP_COUNT
+  };
+
+  struct RequestHandler {
+    const char* type;
+    void (MPVInstance::*handle)(uint64_t id, const Var& data);
+  };
+
+  static const RequestHandler kRequestHandlers[OP_COUNT];
+
+  // Time spent in the handler, seconds.
+  struct RequestStats {
+    uint32_t count{0};
+    double total{0};
+    double max{0};
+  };
+
+  // Dictionary keys, created once rather than on every lookup.
+  struct Keys {
+    Var type{"type"};
+    Var op{"op"};
+    Var data{"data"};
+    Var id{"id"};
+    Var tile{"tile"};
+    Var name{"name"};
+    Var value{"value"};
+    Var format{"format"};
+    Var rate{"rate"};
+    Var epsilon{"epsilon"};
+    Var diff{"diff"};
+    Var priority{"priority"};
+    Var batch_events{"batch_events"};
+    Var binary_events{"binary_events"};
+    Var x{"x"};
+    Var y{"y"};
+    Var w{"w"};
+    Var h{"h"};
+    Var url{"url"};
+    Var time{"time"};
+    Var width{"width"};
+    Var height{"height"};
+    Var every{"every"};
+    Var save{"save"};
+    Var directory{"directory"};
+    Var dropped{"dropped"};
+    Var file{"file"};
+    Var stream{"stream"};
+    Var eof{"eof"};
+    Var written{"written"};
+    Var free{"free"};
+    Var connect{"connect"};
+    Var close{"close"};
+    Var touch{"touch"};
+    Var message{"message"};
+    Var input{"input"};
+    Var keys{"keys"};
+    Var mouse{"mouse"};
+    Var wheel{"wheel"};
+    Var ignore{"ignore"};
+    Var notify{"notify"};
+    Var reset{"reset"};
+    Var trace{"trace"};
+    Var levels{"levels"};
+    Var dynamic_resolution{"dynamic_resolution"};
+    Var budget_ms{"budget_ms"};
+    Var min_scale{"min_scale"};
+    Var adaptive_quality{"adaptive_quality"};
+    Var cache_budget_mb{"cache_budget_mb"};
+    Var fetch{"fetch"};
+  };
+
+  // A part of the view, in fractions of its size.
+  struct TileRect {
+    float x;
+    float y;
+    float w;
+    float h;
+  };
+
+  // configure {dynamic_resolution}
+  struct ResolutionConfig {
+    double budget;  // s per frame, 0 for off
+    float min_scale;
+  };
+  static constexpr double kRenderBudget = 0.012;
+  static constexpr float kMinRenderScale = 0.5f;
+
+  struct PixelRect {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+
+    bool empty() const { return width <= 0 || height <= 0; }
+  };
+
+  // One player: an mpv handle and its render context. Without the tiles
+  // attribute there is a single tile covering the view.
+  struct Tile {
+    Tile(MPVInstance* owner, uint32_t index) : owner(owner), index(index) {}
+
+    MPVInstance* owner;
+    uint32_t index;
+    mpv_handle* mpv{nullptr};
+
+    // undone by the pool when the handle goes back
+    std::vector<uint64_t> observed;
+    PlayerPool::Touched touched;
+    // page hook ids for the pool's PlayerPool::kHooks, 0 for none
+    int32_t pool_hooks[PlayerPool::kHookCount]{};
+    bool hooked{false};  // other hooks can't be removed, the handle is not reused
+    TileRect layout{0, 0, 1, 1};  // rect as last set, for the main thread
+
+    // native input, main thread: the view as last set or observed, and
+    // changes waiting for the next input flush
+    NativeInput::View view{0, 0, 0};
+    double aspect{0};
+    PP_TimeTicks view_changed{0};
+    bool view_observed{false};
+    bool view_dirty{false};
+    bool mouse_dirty{false};
+    int32_t mouse_x{0};  // pixels of the player
+    int32_t mouse_y{0};
+
+    // configure {adaptive_quality}, main thread
+    int quality{0};  // governor level
+    // (name, value) of settings before the first level changed them
+    std::vector<std::pair<std::string, std::string>> restore;
+    bool drops_observed{false};
+    uint64_t frame_drops{0};
+    uint64_t decoder_drops{0};
+
+    // the module's CacheBudget, main thread
+    int64_t cache_bytes{0};
+
+    // render thread
+    mpv_render_context* render{nullptr};  // GL or software
+    TileRect rect{0, 0, 1, 1};
+    bool frame_due{false};
+    TileCompositor::Surface surface;  // GL compositor or scaled mode
+    RenderScale scale;  // GL, configure {dynamic_resolution}
+    Histogram render_time;  // mpv_render_context_render()
+    Counter drawn;
+    Counter reused;   // compositor surface drawn again without rendering
+    Counter skipped;  // frames dropped unseen, hidden or off the layout
+
+    // mpv thread -> main thread: the first wakeup not drained yet,
+    // Trace::Clock ticks, 0 for none
+    std::atomic<int64_t> wakeup_at{0};
+  };
+
+  static constexpr int kMaxTiles = 64;
+
+  // thumbnail widths, pixels
+  static constexpr int32_t kThumbnailWidth = 160;
+  static constexpr int32_t kMaxThumbnailWidth = 640;
+
+  // grab_frame: the next frame of a tile, or with every > 0 each every-th
+  // frame until stopped.
+  struct GrabRequest {
+    uint64_t id;
+    uint32_t tile;
+    int32_t width;
+    int32_t height;
+    FrameFormat format;
+    int32_t every;
+
+    bool operator==(const GrabRequest& other) const {
+      return id == other.id && tile == other.tile && width == other.width &&
+             height == other.height && format == other.format &&
+             every == other.every;
+    }
+  };
+
+  // A mapped ArrayBuffer lent to the render thread to fill. The Var stays
+  // on the main thread, in grab_slots_.
+  struct GrabBuffer {
+    GrabRequest request;
+    uint32_t slot;
+    uint8_t* pixels;
+  };
+
+  struct GrabSlot {
+    GrabRequest request;
+    pp::VarArrayBuffer buffer;
+  };
+
+  // render thread
+  struct GrabStream {
+    GrabRequest request;
+    uint32_t frames;
+    bool due;
+    std::vector<GrabBuffer> buffers;
+  };
+
+  // Where a drawn tile's pixels can be read.
+  struct FrameSource {
+    const uint8_t* pixels;
+    int32_t width;
+    int32_t height;
+    size_t stride;
+    bool bgr;
+    bool flip;
+  };
+
+  // screenshot: a grab the encoder workers turn into PNG files
+  struct ShotRequest {
+    GrabRequest frame;
+    std::string prefix;  // path up to the frame number when saving
+  };
+
+  // render thread
+  struct ShotStream {
+    ShotRequest request;
+    uint32_t frames;
+    uint32_t taken;
+    uint32_t dropped;
+    bool due;
+  };
+
+  static constexpr int32_t kMaxGrabSize = 4096;
+  // ArrayBuffers kept for reuse
+  static constexpr size_t kGrabBufferPool = 4;
+
+  RequestOp RequestOpOf(const pp::VarDictionary& dict) {
+    Var op = dict.Get(keys_.op);
+    if (op.is_int()) {
+      int32_t n = op.AsInt();
+      return n > OP_NONE && n < OP_COUNT ? static_cast<RequestOp>(n) : OP_NONE;
     }
-  }
 
-  void HandleMPVEvents(int32_t) {
-    for (;;) {
-      mpv_event* event = mpv_wait_event(mpv_, 0);
-      // printf("@@@ EVENT %d\n", event->event_id);
-      if (event->event_id == MPV_EVENT_NONE) break;
+    Var type = dict.Get(keys_.type);
+    if (!type.is_string()) {
+      return OP_NONE;
+    }
+    // one hash lookup rather than a compare per type
+    static const std::unordered_map<std::string, RequestOp> ops = [] {
+      std::unordered_map<std::string, RequestOp> ops;
+      for (int n = OP_NONE + 1; n < OP_COUNT; n++) {
+        ops.emplace(kRequestHandlers[n].type, static_cast<RequestOp>(n));
+      }
+      return ops;
+    }();
+    auto it = ops.find(type.AsString());
+    return it != ops.end() ? it->second : OP_NONE;
+  }
 
-      const char* evname = mpv_event_name(event->event_id);
-      if (evname) {
-        DispatchEvent(event, evname);
+  void HandleCommand(uint64_t id, const Var& data) {
+    mpv_node cmd;
+    if (!BuildCommand(data, &cmd)) {
+      PostCommandFail(id, -1, "bad command format");
+    } else {
+      // mpv copies the arguments, the tree can go right away
+      int rc = mpv_command_node_async(MpvFor(id), id, &cmd);
+      if (rc < 0) {
+        PostCommandFail(id, rc, nullptr);
       }
     }
+    node_arena_.Reset();
   }
 
-  void DispatchEvent(mpv_event* event, const char* evname) {
-    PostMessage(mpv_event_to_js(event, evname));
+  void HandleSetProperty(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data);
+    std::string name = data_dict.Get(keys_.name).AsString();
+    PropertyValue value(data_dict.Get(keys_.value));
+    if (value.format != MPV_FORMAT_NONE) {
+      Touch(TileFor(id), name);
+      mpv_set_property_async(MpvFor(id), id, name.c_str(), value.format, value.data());
+    }
   }
 
-  void PostCommandFail(uint64_t id, int code, const char* err) {
-    pp::VarDictionary dst;
-    dst.Set("event", Var("command-reply"));
-    dst.Set("id", Var(static_cast<int>(id)));
-
-    if (err) {
-      dst.Set("error", Var(err));
+  // data is the property name, or {name, format, rate, epsilon, diff}:
+  // format is one of double/flag/int64/string (default node), rate and
+  // epsilon limit how often changes are forwarded (Hz, property units),
+  // diff sends node values as patches against the previous one
+  void HandleObserveProperty(uint64_t id, const Var& data) {
+    std::string name;
+    mpv_format format = MPV_FORMAT_NODE;
+    if (data.is_dictionary()) {
+      pp::VarDictionary data_dict(data);
+      name = data_dict.Get(keys_.name).AsString();
+      Var diff = data_dict.Get(keys_.diff);
+      if (diff.is_bool() && diff.AsBool()) {
+        diffs_.push_back(std::make_unique<PropertyDiff>(id, name));
+      } else {
+        format = format_from_var(data_dict.Get(keys_.format));
+        AddThrottle(id, name, data_dict.Get(keys_.rate), data_dict.Get(keys_.epsilon));
+      }
     } else {
-      dst.Set("error", Var(std::to_string(code)));
+      name = data.AsString();
     }
+    TileFor(id)->observed.push_back(id);
+    mpv_observe_property(MpvFor(id), id, name.c_str(), format);
+  }
 
-    PostMessage(dst);
+  void HandleUnobserveProperty(uint64_t request_id, const Var& data) {
+    uint64_t id = tile_id(tile_of(request_id), data.AsInt());
+    std::vector<uint64_t>& observed = TileFor(id)->observed;
+    observed.erase(std::remove(observed.begin(), observed.end(), id), observed.end());
+    mpv_unobserve_property(MpvFor(id), id);
+    RemoveThrottles(id);
+    RemoveDiffs(id);
   }
 
-  void PostDebugMsg(const std::string &msg) {
-    pp::VarDictionary dst;
-    dst.Set("error", Var(msg));
+  // data is the property name or {name, format}
+  void HandleGetProperty(uint64_t id, const Var& data) {
+    std::string name;
+    mpv_format format = MPV_FORMAT_NODE;
+    if (data.is_dictionary()) {
+      pp::VarDictionary data_dict(data);
+      name = data_dict.Get(keys_.name).AsString();
+      format = format_from_var(data_dict.Get(keys_.format));
+    } else {
+      name = data.AsString();
+    }
+    mpv_get_property_async(MpvFor(id), id, name.c_str(), format);
+  }
 
-    PostMessage(dst);
+  // data is {id, name} of a diffed property: resend it in full
+  void HandleResyncProperty(uint64_t request_id, const Var& data) {
+    pp::VarDictionary data_dict(data);
+    std::string name = data_dict.Get(keys_.name).AsString();
+    uint64_t id = tile_id(tile_of(request_id), data_dict.Get(keys_.id).AsInt());
+    PropertyDiff* diff = FindDiff(id, name.c_str());
+    if (diff && diff->snapshot()) {
+      QueueProperty(diff, diff->snapshot(), false);
+      FlushEvents();
+    }
   }
 
-  static void HandleMPVWakeup(void* ctx) {
-    auto self = static_cast<MPVInstance*>(ctx);
-    self->CallOnMainThread(0, &MPVInstance::HandleMPVEvents);
+  void HandleHookContinue(uint64_t id, const Var& data) {
+    mpv_hook_continue(MpvFor(id), data.AsInt());
   }
 
-  static void HandleMPVUpdate(void* ctx) {
-    auto self = static_cast<MPVInstance*>(ctx);
-    self->InvokeGetFrame();
+  void HandleHookAdd(uint64_t request_id, const Var& data) {
+    pp::VarDictionary data_dict(data);
+    std::string name = data_dict.Get(keys_.name).AsString();
+    uint64_t id = tile_id(tile_of(request_id), data_dict.Get(keys_.id).AsInt());
+    int priority = data_dict.Get(keys_.priority).AsInt();
+    Tile* tile = TileFor(id);
+    // the handle has it already, at the pool's priority
+    int pooled = PlayerPool::HookIndex(name);
+    if (pooled >= 0 && !tile->pool_hooks[pooled]) {
+      tile->pool_hooks[pooled] = client_id(id);
+      return;
+    }
+    tile->hooked = true;
+    mpv_hook_add(tile->mpv, id, name.c_str(), priority);
   }
 
-  bool InitGL() {
-    if (!glInitializePPAPI(pp::Module::Get()->get_browser_interface()))
-      DIE("unable to initialize GL PPAPI");
+  void HandleSetOption(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data);
+    std::string name = data_dict.Get(keys_.name).AsString();
+    std::string value = data_dict.Get(keys_.value).AsString();
+    Touch(TileFor(id), name);
+    mpv_set_option_string(MpvFor(id), name.c_str(), value.c_str());
+  }
 
-    const int32_t attrib_list[] = {
-      PP_GRAPHICS3DATTRIB_ALPHA_SIZE, 8,
-      PP_GRAPHICS3DATTRIB_DEPTH_SIZE, 24,
-      PP_GRAPHICS3DATTRIB_NONE
-    };
+  void HandleConfigure(uint64_t, const Var& data) {
+    pp::VarDictionary data_dict(data);
+    if (data_dict.HasKey(keys_.batch_events)) {
+      batch_events_ = data_dict.Get(keys_.batch_events).AsBool();
+    }
+    if (data_dict.HasKey(keys_.binary_events)) {
+      binary_events_ = data_dict.Get(keys_.binary_events).AsBool();
+      encoder_.Reset();
+    }
+    if (data_dict.HasKey(keys_.input)) {
+      ConfigureInput(data_dict.Get(keys_.input));
+    }
+    if (data_dict.HasKey(keys_.dynamic_resolution)) {
+      ConfigureResolution(data_dict.Get(keys_.dynamic_resolution));
+    }
+    if (data_dict.HasKey(keys_.adaptive_quality)) {
+      Var quality = data_dict.Get(keys_.adaptive_quality);
+      ConfigureQuality(quality.is_bool() && quality.AsBool());
+    }
+    if (data_dict.HasKey(keys_.cache_budget_mb)) {
+      // the module's, for the players of every instance
+      Var budget = data_dict.Get(keys_.cache_budget_mb);
+      if (budget.is_number()) {
+        cache_budget_->set_total(
+            static_cast<int64_t>(std::max(budget.AsDouble(), 0.0) * (1 << 20)));
+      }
+    }
+  }
 
-    context_ = pp::Graphics3D(this, attrib_list);
-    if (!BindGraphics(context_))
-      DIE("unable to bind 3d context");
+  // adaptive_quality: true puts the players under the module's
+  // QualityGovernor, which lowers decoding and scaling quality where it
+  // shows least while the machine can't keep up; false restores them.
+  void ConfigureQuality(bool on) {
+    if (!on) {
+      governor_->Remove(this);
+      for (auto &tile : tiles_) {
+        ApplyQuality(tile->index, 0);
+      }
+      return;
+    }
+    for (auto &tile : tiles_) {
+      ObserveDrops(tile.get());
+      governor_->Add(this, tile->index);
+    }
+  }
 
-    return true;
+  QualityGovernor::Sample MeasureQuality(uint32_t player) override {
+    const Tile& tile = *tiles_[player];
+    ViewState view = view_state_.load();
+    Histogram::Summary render = tile.render_time.Summarize();
+    return {static_cast<int64_t>(tile.layout.w * view.width * tile.layout.h * view.height),
+            tile.frame_drops + tile.decoder_drops,
+            render.count,
+            render.mean * render.count,
+            kRenderBudget / tiles_.size()};
   }
 
-  bool InitMPV() {
-    setlocale(LC_NUMERIC, "C");
-    mpv_ = mpv_create();
-    if (!mpv_)
-      DIE("context init failed");
+  // A level keeps what the ones before it set, unless it sets the same
+  // option again. Level 0 puts back what the player had.
+  void ApplyQuality(uint32_t player, int level) override {
+    struct QualitySetting {
+      int level;
+      const char* name;
+      const char* value;
+    };
+    static const QualitySetting kSettings[] = {
+        {1, "scale", "bilinear"},
+        {1, "dscale", "bilinear"},
+        {1, "cscale", "bilinear"},
+        {1, "vd-lavc-skiploopfilter", "nonref"},
+        {2, "vd-lavc-skiploopfilter", "all"},
+        {2, "vd-lavc-fast", "yes"},
+        {2, "framedrop", "decoder+vo"},
+        // the lowest variant of adaptive streams, from the next load
+        {3, "hls-bitrate", "min"},
+    };
 
-    char* terminal = getenv("MPVJS_TERMINAL");
-    if (terminal && strlen(terminal))
-      mpv_set_option_string(mpv_, "terminal", "yes");
-    char* verbose = getenv("MPVJS_VERBOSE");
-    if (verbose && strlen(verbose))
-      mpv_set_option_string(mpv_, "msg-level", "all=v");
+    Tile* tile = tiles_[player].get();
+    tile->quality = level;
+    for (const QualitySetting& setting : kSettings) {
+      const char* name = setting.name;
+      std::string value;
+      bool seen = false;
+      for (const QualitySetting& entry : kSettings) {
+        seen = seen || (&entry < &setting && !strcmp(entry.name, name));
+        if (!strcmp(entry.name, name) && entry.level <= level) {
+          value = entry.value;
+        }
+      }
+      if (seen) {
+        continue;
+      }
+      if (!value.empty()) {
+        SaveSetting(tile, name);
+      } else if (!SavedSetting(*tile, name, &value)) {
+        continue;  // never changed
+      }
+      const char* data = value.c_str();
+      mpv_set_property_async(tile->mpv, QualityReply(player), name,
+                             MPV_FORMAT_STRING, &data);
+    }
+  }
 
-    // Can't be set after initialize in mpv 0.18.
-    mpv_set_option_string(mpv_, "input-default-bindings", "yes");
-    // mpv_set_option_string(mpv_, "pause", "yes");
+  static bool SavedSetting(const Tile& tile, const char* name, std::string* value) {
+    for (const auto &setting : tile.restore) {
+      if (setting.first == name) {
+        *value = setting.second;
+        return true;
+      }
+    }
+    return false;
+  }
 
-    mpv_set_option_string(mpv_, "idle", "yes");
+  uint64_t QualityReply(uint32_t tile) const {
+    return kQualityReply | tile_id(tile, 0);
+  }
 
-    if (mpv_initialize(mpv_) < 0)
-      DIE("mpv init failed");
+  void ObserveDrops(Tile* tile) {
+    if (!tile->mpv || tile->drops_observed) {
+      return;
+    }
+    tile->drops_observed = true;
+    uint64_t reply = QualityReply(tile->index);
+    tile->observed.push_back(reply);
+    mpv_observe_property(tile->mpv, reply, "frame-drop-count", MPV_FORMAT_INT64);
+    mpv_observe_property(tile->mpv, reply, "decoder-frame-drop-count", MPV_FORMAT_INT64);
+  }
 
-    glSetCurrentContextPPAPI(context_.pp_resource());
+  // unavailable between files, counting starts over with the next
+  void UpdateDrops(uint32_t tile_index, const mpv_event_property* prop) {
+    Tile* tile = tiles_[tile_index].get();
+    uint64_t value = prop->format == MPV_FORMAT_INT64
+        ? static_cast<uint64_t>(*static_cast<int64_t*>(prop->data)) : 0;
+    if (!strcmp(prop->name, "frame-drop-count")) {
+      tile->frame_drops = value;
+    } else {
+      tile->decoder_drops = value;
+    }
+  }
 
-    mpv_opengl_init_params gl_init_params{GetProcAddressMPV, nullptr};
-    mpv_render_param params[] = {
-        {MPV_RENDER_PARAM_API_TYPE, const_cast<char *>(MPV_RENDER_API_TYPE_OPENGL)},
-        {MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &gl_init_params},
-        {MPV_RENDER_PARAM_INVALID, nullptr}
-    };
+  // The limits the player has now are what it gets back on release and
+  // the most the budget gives it.
+  void AddToCacheBudget(Tile* tile) {
+    CacheBudget::Limits own{0, 0};
+    if (mpv_get_property(tile->mpv, "demuxer-max-bytes", MPV_FORMAT_INT64, &own.ahead) < 0 ||
+        mpv_get_property(tile->mpv, "demuxer-max-back-bytes", MPV_FORMAT_INT64, &own.behind) < 0) {
+      return;
+    }
+    Touch(tile, "demuxer-max-bytes");
+    Touch(tile, "demuxer-max-back-bytes");
+    cache_budget_->Add(this, tile->index, own);
+  }
 
-    if (mpv_render_context_create(&mpv_gl_, mpv_, params) < 0)
-      DIE("failed to initialize mpv GL context");
+  CacheBudget::Usage MeasureCache(uint32_t player) override {
+    const Tile& tile = *tiles_[player];
+    // read for the next interval
+    mpv_get_property_async(tile.mpv, kCacheReply | tile_id(player, 0),
+                           "demuxer-cache-state", MPV_FORMAT_NODE);
+    ViewState view = view_state_.load();
+    bool visible = view.width && tile.layout.w > 0 && tile.layout.h > 0;
+    return {!visible ? CacheBudget::kBackground
+                     : focused_ ? CacheBudget::kFocused : CacheBudget::kVisible,
+            tile.cache_bytes};
+  }
 
-    // Some convenient defaults. Can be always changed on ready event.
-    mpv_set_option_string(mpv_, "stop-playback-on-init-failure", "no");
-    mpv_set_option_string(mpv_, "audio-file-auto", "no");
-    mpv_set_option_string(mpv_, "sub-auto", "no");
-    mpv_set_option_string(mpv_, "volume-max", "100");
-    mpv_set_option_string(mpv_, "keep-open", "no");
-    mpv_set_option_string(mpv_, "keep-open-pause", "no");
-    mpv_set_option_string(mpv_, "osd-bar", "no");
-    mpv_set_option_string(mpv_, "reset-on-next-file", "pause");
+  // mpv prunes a cache over its new limits right away
+  void ApplyCache(uint32_t player, const CacheBudget::Limits& limits) override {
+    Tile* tile = tiles_[player].get();
+    uint64_t reply = kCacheReply | tile_id(player, 0);
+    int64_t ahead = limits.ahead;
+    int64_t behind = limits.behind;
+    mpv_set_property_async(tile->mpv, reply, "demuxer-max-bytes", MPV_FORMAT_INT64, &ahead);
+    mpv_set_property_async(tile->mpv, reply, "demuxer-max-back-bytes", MPV_FORMAT_INT64, &behind);
+  }
 
-    mpv_set_option_string(mpv_, "force-window", "immediate");
+  // demuxer-cache-state is unavailable without a file, an empty cache
+  void UpdateCache(uint32_t tile_index, const mpv_event_property* prop) {
+    int64_t bytes = 0;
+    const mpv_node* state = static_cast<const mpv_node*>(prop->data);
+    if (prop->format == MPV_FORMAT_NODE && state->format == MPV_FORMAT_NODE_MAP) {
+      for (int i = 0; i < state->u.list->num; i++) {
+        const mpv_node& value = state->u.list->values[i];
+        if (!strcmp(state->u.list->keys[i], "total-bytes") &&
+            value.format == MPV_FORMAT_INT64) {
+          bytes = value.u.int64;
+        }
+      }
+    }
+    tiles_[tile_index]->cache_bytes = bytes;
+  }
 
-    LoadMPV();
-    return true;
+  // dynamic_resolution: false, or {budget_ms, min_scale}. While rendering
+  // takes longer than budget_ms a frame (kRenderBudget by default, split
+  // evenly between GL tiles), players render at less than the view's
+  // resolution, not below min_scale of it, and are upscaled.
+  void ConfigureResolution(const Var& value) {
+    pp::VarDictionary dict(value.is_dictionary() ? value : pp::VarDictionary());
+    Var budget = dict.Get(keys_.budget_ms);
+    Var min_scale = dict.Get(keys_.min_scale);
+    ResolutionConfig config{0, kMinRenderScale};
+    if (value.is_dictionary()) {
+      config.budget = budget.is_number() ? budget.AsDouble() / 1000 : kRenderBudget;
+    }
+    if (min_scale.is_number()) {
+      config.min_scale = static_cast<float>(min_scale.AsDouble());
+    }
+    render_loop_.PostWork(
+        callback_factory_.NewCallback(&MPVInstance::ApplyResolution, config));
   }
 
-  void LoadMPV() {
-    mpv_set_wakeup_callback(mpv_, HandleMPVWakeup, this);
-    mpv_render_context_set_update_callback(mpv_gl_, HandleMPVUpdate, this);
+  // input: false, or {keys: bool, mouse: "mpv"|"view", wheel: "mpv"|"view",
+  // ignore: [key names left to the page], notify: bool}. With "view" a drag
+  // pans a zoomed player and the wheel zooms about the pointer. notify
+  // posts {event: "input", kind: "key", key} for keys sent to mpv and
+  // {event: "input", kind: "view", zoom, pan_x, pan_y} for view changes.
+  void ConfigureInput(const Var& input) {
+    pp::VarDictionary input_dict(input.is_dictionary() ? input : pp::VarDictionary());
+    auto pointer = [&input_dict](const Var& key) {
+      Var mode = input_dict.Get(key);
+      std::string name = mode.is_string() ? mode.AsString() : "";
+      return name == "mpv" ? NativeInput::POINTER_MPV
+           : name == "view" ? NativeInput::POINTER_VIEW
+           : NativeInput::POINTER_OFF;
+    };
+    Var keys = input_dict.Get(keys_.keys);
+    input_.Configure(keys.is_bool() && keys.AsBool(), pointer(keys_.mouse),
+                     pointer(keys_.wheel));
+    Var ignore = input_dict.Get(keys_.ignore);
+    if (ignore.is_array()) {
+      pp::VarArray names(ignore);
+      std::vector<std::string> ignored;
+      for (uint32_t i = 0; i < names.GetLength(); i++) {
+        Var name = names.Get(i);
+        if (name.is_string()) {
+          ignored.push_back(name.AsString());
+        }
+      }
+      input_.SetIgnored(std::move(ignored));
+    }
+    Var notify = input_dict.Get(keys_.notify);
+    input_notify_ = notify.is_bool() && notify.AsBool();
+    dragging_ = false;
+
+    ClearInputEventRequest(PP_INPUTEVENT_CLASS_KEYBOARD |
+                           PP_INPUTEVENT_CLASS_MOUSE |
+                           PP_INPUTEVENT_CLASS_WHEEL);
+    if (input_.event_classes()) {
+      RequestFilteringInputEvents(input_.event_classes());
+    }
+    if (input_.mouse() == NativeInput::POINTER_VIEW ||
+        input_.wheel() == NativeInput::POINTER_VIEW) {
+      for (auto& tile : tiles_) {
+        ObserveView(tile.get());
+      }
+    }
   }
 
-  mpv_handle* mpv_{nullptr};
-  mpv_render_context* mpv_gl_{nullptr};
+  // Replies {type: {count, total_ms, max_ms}} for every type seen so far.
+  void HandleGetRequestStats(uint64_t id, const Var&) {
+    pp::VarDictionary dst;
+    dst.Set("event", Var("request-stats"));
+    SetReplyId(&dst, id);
+    dst.Set("stats", RequestStatsVar());
 
-private:
-  void InvokeGetFrame() {
-    CallOnMainThread(0, &MPVInstance::OnGetFrame);
+    PostMessage(dst);
   }
 
-  void OnGetFrame(int32_t) {
-    // Always called on main thread so don't need locks.
-    if (is_painting_) {
-      needs_paint_ = true;
-    } else {
-      is_painting_ = true;
-      needs_paint_ = false;
-      Render();
+  pp::VarDictionary RequestStatsVar() const {
+    pp::VarDictionary stats;
+    for (int n = OP_NONE + 1; n < OP_COUNT; n++) {
+      const RequestStats& op_stats = request_stats_[n];
+      if (!op_stats.count) {
+        continue;
+      }
+      pp::VarDictionary entry;
+      entry.Set("count", Var(static_cast<int32_t>(op_stats.count)));
+      entry.Set("total_ms", Var(op_stats.total * 1000));
+      entry.Set("max_ms", Var(op_stats.max * 1000));
+      stats.Set(kRequestHandlers[n].type, entry);
     }
+    return stats;
   }
 
-  void Render() {
-    glSetCurrentContextPPAPI(context_.pp_resource());
-
-    mpv_opengl_fbo mpfbo{static_cast<int>(0), viewWidth_, viewHeight_, 0};
-    int flip_y{1};
-    mpv_render_param params[] = {
-        {MPV_RENDER_PARAM_OPENGL_FBO, &mpfbo},
-        {MPV_RENDER_PARAM_FLIP_Y, &flip_y},
-        {MPV_RENDER_PARAM_INVALID, nullptr}
-    };
+  // Replies {event: "stats", id, stats} with the timings of every stage
+  // ({count, mean_ms, p50_ms, p99_ms, max_ms}; percentiles are bucket
+  // bounds), counters, queue depths ({last, max}), the same per tile and
+  // the request stats. Tiles add their share of the module's cache budget,
+  // {priority, bytes, max_bytes, max_back_bytes}, next to the budget's
+  // {total, allocated}. data:
+  //   {reset: true}  starts the numbers over after replying
+  //   {trace: true}  starts recording spans, dropping older ones
+  //   {trace: false} stops and adds trace, Chrome trace_event JSON
+  void HandleGetStats(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data.is_dictionary() ? data : pp::VarDictionary());
+    pp::VarDictionary stats;
+    stats.Set("render", SummaryVar(metrics_.render));
+    stats.Set("swap", SummaryVar(metrics_.swap));
+    stats.Set("frame_interval", SummaryVar(metrics_.frame_interval));
+    stats.Set("event_drain", SummaryVar(metrics_.event_drain));
+    stats.Set("event_latency", SummaryVar(metrics_.event_latency));
+    stats.Set("frames", CountVar(metrics_.frames));
+    stats.Set("deferred", CountVar(metrics_.deferred));
+    stats.Set("hidden", CountVar(metrics_.hidden));
+    stats.Set("resizes", CountVar(metrics_.resizes));
+    stats.Set("events", CountVar(metrics_.events));
+    stats.Set("events_per_drain", DepthVar(metrics_.events_per_drain));
+    stats.Set("pending_events", DepthVar(metrics_.pending_events));
+    pp::VarArray tiles;
+    for (uint32_t i = 0; i < tiles_.size(); i++) {
+      const Tile& tile = *tiles_[i];
+      pp::VarDictionary entry;
+      entry.Set("render", SummaryVar(tile.render_time));
+      entry.Set("drawn", CountVar(tile.drawn));
+      entry.Set("reused", CountVar(tile.reused));
+      entry.Set("skipped", CountVar(tile.skipped));
+      entry.Set("scale", Var(presenter_ ? view_scale_.scale() : tile.scale.scale()));
+      entry.Set("quality", Var(governor_->level(this, i)));
+      entry.Set("dropped", Var(static_cast<double>(tile.frame_drops + tile.decoder_drops)));
+      CacheBudget::Limits limits;
+      CacheBudget::Usage usage;
+      if (cache_budget_->allocation(this, i, &limits, &usage)) {
+        pp::VarDictionary cache;
+        cache.Set("priority", Var(CacheBudget::PriorityName(usage.priority)));
+        cache.Set("bytes", Var(static_cast<double>(usage.bytes)));
+        cache.Set("max_bytes", Var(static_cast<double>(limits.ahead)));
+        cache.Set("max_back_bytes", Var(static_cast<double>(limits.behind)));
+        entry.Set("cache", cache);
+      }
+      tiles.Set(i, entry);
+    }
+    stats.Set("tiles", tiles);
+    // shared by the players of every instance
+    pp::VarDictionary cache_budget;
+    cache_budget.Set("total", Var(static_cast<double>(cache_budget_->total())));
+    cache_budget.Set("allocated", Var(static_cast<double>(cache_budget_->allocated())));
+    stats.Set("cache_budget", cache_budget);
+    PlayerPool::Counts counts = pool_->counts();
+    pp::VarDictionary pool;
+    pool.Set("idle", Var(static_cast<double>(counts.idle)));
+    pool.Set("reused", Var(static_cast<double>(counts.reused)));
+    pool.Set("destroyed", Var(static_cast<double>(counts.destroyed)));
+    stats.Set("pool", pool);
+    stats.Set("requests", RequestStatsVar());
 
-    mpv_render_context_render(mpv_gl_, params);
+    pp::VarDictionary dst;
+    dst.Set("event", Var("stats"));
+    SetReplyId(&dst, id);
+    dst.Set("stats", stats);
+
+    Var trace = data_dict.Get(keys_.trace);
+    if (trace.is_bool() && trace.AsBool()) {
+      trace_.Start();
+    } else if (trace.is_bool()) {
+      trace_.Stop();
+      dst.Set("trace", Var(trace_.Json()));
+    }
+    PostMessage(dst);
 
-    SwapBuffers();
+    Var reset = data_dict.Get(keys_.reset);
+    if (reset.is_bool() && reset.AsBool()) {
+      metrics_.event_drain.Reset();
+      metrics_.event_latency.Reset();
+      metrics_.events.Reset();
+      metrics_.events_per_drain.Reset();
+      metrics_.pending_events.Reset();
+      // the rest has the render thread as writer
+      render_loop_.PostWork(
+          callback_factory_.NewCallback(&MPVInstance::ResetRenderMetrics));
+    }
   }
 
-  void SwapBuffers() {
-    context_.SwapBuffers(
-        callback_factory_.NewCallback(&MPVInstance::PaintFinished));
+  static pp::VarDictionary SummaryVar(const Histogram& histogram) {
+    Histogram::Summary summary = histogram.Summarize();
+    pp::VarDictionary dst;
+    dst.Set("count", Var(static_cast<double>(summary.count)));
+    dst.Set("mean_ms", Var(summary.mean * 1000));
+    dst.Set("p50_ms", Var(summary.p50 * 1000));
+    dst.Set("p99_ms", Var(summary.p99 * 1000));
+    dst.Set("max_ms", Var(summary.max * 1000));
+    return dst;
   }
 
-  void PaintFinished(int32_t) {
-    is_painting_ = false;
-    if (needs_paint_)
-      OnGetFrame(0);
+  static Var CountVar(const Counter& counter) {
+    return Var(static_cast<double>(counter.value()));
   }
 
-  template <typename Method>
-  void CallOnMainThread(int32_t delay_in_milliseconds,
-                        Method method,
-                        int32_t result = 0) {
-    pp::Module::Get()->core()->CallOnMainThread(delay_in_milliseconds, 
-        callback_factory_.NewCallback(method), result);
+  static pp::VarDictionary DepthVar(const Depth& depth) {
+    pp::VarDictionary dst;
+    dst.Set("last", Var(static_cast<double>(depth.last())));
+    dst.Set("max", Var(static_cast<double>(depth.max())));
+    return dst;
   }
 
-private:
-  pp::CompletionCallbackFactory<MPVInstance> callback_factory_;
-
-  pp::Graphics3D context_;
+  // mpv's log, kept in log_ until fetched; data has any of
+  //   {levels: "all=warn,ffmpeg=v"}  mpv's msg-level syntax, "no" stops
+  //   {notify: true}  posts {event: "log-ready"} once lines are waiting,
+  //                   then again only after the next fetch
+  //   {fetch: N}      at most N lines, all if not a number
+  // Replies {event: "log-reply", id, lines, dropped, pending}: lines as
+  // [tile, level, prefix, text], dropped those overwritten unfetched,
+  // pending those left for another fetch.
+  void HandleLog(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data.is_dictionary() ? data : pp::VarDictionary());
+    pp::VarDictionary dst;
+    dst.Set("event", Var("log-reply"));
+    SetReplyId(&dst, id);
+
+    Var levels = data_dict.Get(keys_.levels);
+    if (levels.is_string()) {
+      if (log_.SetLevels(levels.AsString())) {
+        for (auto &tile : tiles_) {
+          mpv_request_log_messages(tile->mpv, log_.mpv_level());
+        }
+      } else {
+        dst.Set("error", Var("bad log levels"));
+      }
+    }
 
-  bool is_painting_{false};
-  bool needs_paint_{false};
+    Var notify = data_dict.Get(keys_.notify);
+    if (notify.is_bool()) {
+      log_notify_ = notify.AsBool();
+    }
 
-  int32_t viewWidth_{0};
+    Var fetch = data_dict.Get(keys_.fetch);
+    pp::VarArray lines;
+    uint64_t dropped = 0;
+    if (!fetch.is_undefined()) {
+      size_t max = fetch.is_number() ? static_cast<size_t>(std::max(fetch.AsDouble(), 0.0))
+                                     : LogBuffer::kCapacity;
+      uint32_t n = 0;
+      dropped = log_.Fetch(max, [&](const LogBuffer::Line& line) {
+        pp::VarArray entry;
+        entry.Set(0, Var(static_cast<int32_t>(line.tile)));
+        entry.Set(1, Var(LogBuffer::LevelName(line.level)));
+        entry.Set(2, Var(line.prefix));
+        entry.Set(3, Var(line.text));
+        lines.Set(n++, entry);
+      });
+      log_ready_posted_ = false;
+    }
+    dst.Set("lines", lines);
+    dst.Set("dropped", Var(static_cast<double>(dropped)));
+    dst.Set("pending", Var(static_cast<double>(log_.pending())));
+    PostMessage(dst);
+  }
+
+  void LogAdded() {
+    if (!log_notify_ || log_ready_posted_) {
+      return;
+    }
+    log_ready_posted_ = true;
+    pp::VarDictionary dst;
+    dst.Set("event", Var("log-ready"));
+    PostMessage(dst);
+  }
+
+  // data is one {x, y, w, h} per tile, fractions of the view; a missing
+  // or empty rectangle hides the tile. Players keep running either way.
+  void HandleSetLayout(uint64_t, const Var& data) {
+    if (!compositor_) {
+      return;
+    }
+    pp::VarArray rects(data);
+    std::vector<TileRect> layout(tiles_.size());
+    for (uint32_t i = 0; i < layout.size() && i < rects.GetLength(); i++) {
+      pp::VarDictionary rect(rects.Get(i));
+      layout[i].x = static_cast<float>(rect.Get(keys_.x).AsDouble());
+      layout[i].y = static_cast<float>(rect.Get(keys_.y).AsDouble());
+      layout[i].w = static_cast<float>(rect.Get(keys_.w).AsDouble());
+      layout[i].h = static_cast<float>(rect.Get(keys_.h).AsDouble());
+    }
+    for (size_t i = 0; i < layout.size(); i++) {
+      tiles_[i]->layout = layout[i];
+    }
+    render_loop_.PostWork(
+        callback_factory_.NewCallback(&MPVInstance::ApplyLayout, layout));
+  }
+
+  Tile* TileFor(uint64_t id) {
+    return tiles_[tile_of(id)].get();
+  }
+
+  // data is {url, time, width}: a frame of url near time seconds, width
+  // pixels wide, from a hidden player. Replies {event: "thumbnail", id,
+  // time, width, height, data} with RGBA pixels in data, or {id, error}
+  // once a newer request replaced it.
+  void HandleThumbnail(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data);
+    std::string url = data_dict.Get(keys_.url).AsString();
+    double time = data_dict.Get(keys_.time).AsDouble();
+    Var var_width = data_dict.Get(keys_.width);
+    int32_t width = var_width.is_number()
+        ? std::max(16, std::min(var_width.AsInt(), kMaxThumbnailWidth))
+        : kThumbnailWidth;
+
+    if (!thumbnailer_) {
+      thumbnailer_ = std::make_unique<Thumbnailer>(HandleThumbnailWakeup, this);
+    }
+    Thumbnailer::Thumbnail cached;
+    if (thumbnailer_->Request(id, url, time, width, &cached)) {
+      PostThumbnail(cached);
+    }
+  }
+
+  static void HandleThumbnailWakeup(void* ctx) {
+    static_cast<MPVInstance*>(ctx)->CallOnMainThread(
+        0, &MPVInstance::HandleThumbnails);
+  }
+
+  void HandleThumbnails(int32_t) {
+    if (!thumbnailer_) {
+      return;
+    }
+    for (const auto &thumbnail : thumbnailer_->Take()) {
+      PostThumbnail(thumbnail);
+    }
+  }
+
+  void PostThumbnail(const Thumbnailer::Thumbnail& thumbnail) {
+    pp::VarDictionary dst;
+    dst.Set("event", Var("thumbnail"));
+    SetReplyId(&dst, thumbnail.id);
+    if (!thumbnail.pixels) {
+      dst.Set("error", Var(thumbnail.error));
+      PostMessage(dst);
+      return;
+    }
+
+    const std::vector<uint8_t>& pixels = *thumbnail.pixels;
+    pp::VarArrayBuffer buffer(static_cast<uint32_t>(pixels.size()));
+    memcpy(buffer.Map(), pixels.data(), pixels.size());
+    buffer.Unmap();
+    dst.Set(keys_.time, Var(thumbnail.time));
+    dst.Set(keys_.width, Var(thumbnail.width));
+    dst.Set("height", Var(thumbnail.height));
+    dst.Set(keys_.data, buffer);
+    PostMessage(dst);
+  }
+
+  // data is {width, height, format, every}: the tile's next drawn frame,
+  // scaled to width x height (by default as shown) in "rgba", "bgra" or
+  // "gray", as {event: "frame", id, width, height, format, data}. every: N
+  // sends every Nth frame under the same id until every: 0.
+  void HandleGrabFrame(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data.is_dictionary() ? data : pp::VarDictionary());
+    Var every = data_dict.Get(keys_.every);
+    StopGrab(id);
+    if (every.is_number() && every.AsInt() <= 0) {
+      return;
+    }
+
+    GrabRequest request{id, tile_of(id), 0, 0, FRAME_RGBA,
+                        every.is_number() ? every.AsInt() : 0};
+    Var format = data_dict.Get(keys_.format);
+    for (int n = FRAME_RGBA; n <= FRAME_GRAY; n++) {
+      if (format.is_string() && format.AsString() == kFrameFormatNames[n]) {
+        request.format = static_cast<FrameFormat>(n);
+      }
+    }
+
+    GrabSize(id, data_dict, &request.width, &request.height);
+
+    if (request.every) {
+      grab_streams_.push_back(request);
+    }
+    // a stream has one buffer being filled while the last frame is posted
+    for (int i = 0; i < (request.every ? 2 : 1); i++) {
+      LendGrabBuffer(request, next_grab_slot_++, AcquireGrabBuffer(request));
+    }
+  }
+
+  // width and height of |data|; missing sides follow the shown size and
+  // aspect.
+  void GrabSize(uint64_t id,
+                const pp::VarDictionary& data,
+                int32_t* width,
+                int32_t* height) {
+    ViewState view = view_state_.load();
+    const TileRect& rect = TileFor(id)->layout;
+    double shown_width = view.width ? view.width * rect.w : 640;
+    double shown_height = view.height ? view.height * rect.h : 360;
+    Var width_var = data.Get(keys_.width);
+    Var height_var = data.Get(keys_.height);
+    *width = width_var.is_number() ? width_var.AsInt() : 0;
+    *height = height_var.is_number() ? height_var.AsInt() : 0;
+    if (!*width && !*height) {
+      *width = static_cast<int32_t>(shown_width);
+      *height = static_cast<int32_t>(shown_height);
+    } else if (!*width) {
+      *width = static_cast<int32_t>(*height * shown_width / shown_height);
+    } else if (!*height) {
+      *height = static_cast<int32_t>(*width * shown_height / shown_width);
+    }
+    *width = std::max(1, std::min(*width, kMaxGrabSize));
+    *height = std::max(1, std::min(*height, kMaxGrabSize));
+  }
+
+  void StopGrab(uint64_t id) {
+    auto stream = std::find_if(grab_streams_.begin(), grab_streams_.end(),
+                               [id](const GrabRequest& r) { return r.id == id; });
+    if (stream == grab_streams_.end()) {
+      return;
+    }
+    grab_streams_.erase(stream);
+    render_loop_.PostWork(
+        callback_factory_.NewCallback(&MPVInstance::EndGrab, id));
+  }
+
+  pp::VarArrayBuffer AcquireGrabBuffer(const GrabRequest& request) {
+    uint32_t size = static_cast<uint32_t>(request.width) * request.height *
+                    frame_bytes_per_pixel(request.format);
+    for (auto it = grab_buffers_.begin(); it != grab_buffers_.end(); ++it) {
+      if (it->ByteLength() == size) {
+        pp::VarArrayBuffer buffer = *it;
+        grab_buffers_.erase(it);
+        return buffer;
+      }
+    }
+    return pp::VarArrayBuffer(size);
+  }
+
+  void LendGrabBuffer(const GrabRequest& request,
+                      uint32_t slot,
+                      pp::VarArrayBuffer buffer) {
+    GrabBuffer lent{request, slot, static_cast<uint8_t*>(buffer.Map())};
+    grab_slots_[slot] = {request, buffer};
+    render_loop_.PostWork(
+        callback_factory_.NewCallback(&MPVInstance::AddGrabBuffer, lent));
+  }
+
+  // A buffer the render thread filled, or returned unused when negative.
+  void FrameGrabbed(int32_t result) {
+    uint32_t slot = static_cast<uint32_t>(result);
+    auto it = grab_slots_.find(slot);
+    if (it == grab_slots_.end()) {
+      return;
+    }
+    GrabSlot grabbed = it->second;
+    grab_slots_.erase(it);
+    grabbed.buffer.Unmap();
+
+    pp::VarDictionary dst;
+    dst.Set("event", Var("frame"));
+    SetReplyId(&dst, grabbed.request.id);
+    dst.Set(keys_.width, Var(grabbed.request.width));
+    dst.Set(keys_.height, Var(grabbed.request.height));
+    dst.Set(keys_.format, Var(kFrameFormatNames[grabbed.request.format]));
+    dst.Set(keys_.data, grabbed.buffer);
+    PostMessage(dst);
+
+    // PostMessage copies the buffer, it can be filled again right away
+    if (grabbed.request.every &&
+        std::find(grab_streams_.begin(), grab_streams_.end(), grabbed.request) !=
+            grab_streams_.end()) {
+      LendGrabBuffer(grabbed.request, slot, grabbed.buffer);
+    } else {
+      ReleaseGrabBuffer(grabbed.buffer);
+    }
+  }
+
+  // A buffer the render thread gave back without a frame.
+  void GrabBufferReturned(int32_t result) {
+    auto it = grab_slots_.find(static_cast<uint32_t>(result));
+    if (it == grab_slots_.end()) {
+      return;
+    }
+    it->second.buffer.Unmap();
+    ReleaseGrabBuffer(it->second.buffer);
+    grab_slots_.erase(it);
+  }
+
+  void ReleaseGrabBuffer(const pp::VarArrayBuffer& buffer) {
+    if (grab_buffers_.size() < kGrabBufferPool) {
+      grab_buffers_.push_back(buffer);
+    }
+  }
+
+  // data is {every, width, height, save, directory}: the tile's next drawn
+  // frame as PNG, encoded on the screenshot workers, every: N for every Nth
+  // frame until every: 0. Replies {event: "screenshot", id, width, height,
+  // format, dropped} with the file in data, or with save: true its path in
+  // file, written to directory (by default the player's
+  // screenshot-directory). dropped counts frames skipped so far because
+  // the workers were behind.
+  void HandleScreenshot(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data.is_dictionary() ? data : pp::VarDictionary());
+    Var every = data_dict.Get(keys_.every);
+    if (every.is_number() && every.AsInt() <= 0) {
+      render_loop_.PostWork(
+          callback_factory_.NewCallback(&MPVInstance::EndScreenshot, id));
+      return;
+    }
+
+    ShotRequest request{{id, tile_of(id), 0, 0, FRAME_RGBA,
+                         every.is_number() ? every.AsInt() : 0}, ""};
+    GrabSize(id, data_dict, &request.frame.width, &request.frame.height);
+
+    Var save = data_dict.Get(keys_.save);
+    if (save.is_bool() && save.AsBool()) {
+      Var directory = data_dict.Get(keys_.directory);
+      if (directory.is_string()) {
+        request.prefix = directory.AsString();
+      } else if (char* option = mpv_get_property_string(
+                     MpvFor(id), "options/screenshot-directory")) {
+        request.prefix = option;
+        mpv_free(option);
+      }
+      if (request.prefix.empty()) {
+        request.prefix = ".";
+      }
+      // the time has whole seconds, the sequence keeps requests within one
+      // apart
+      char name[64];
+      time_t now = time(nullptr);
+      size_t length = strftime(name, sizeof(name), "/shot-%Y%m%d-%H%M%S-",
+                               localtime(&now));
+      snprintf(name + length, sizeof(name) - length, "%u-", ++shot_sequence_);
+      request.prefix += name;
+    }
+
+    if (!screenshot_encoder_) {
+      screenshot_encoder_.reset(
+          new ScreenshotEncoder(HandleScreenshotWakeup, this));
+    }
+    render_loop_.PostWork(
+        callback_factory_.NewCallback(&MPVInstance::AddScreenshot, request));
+  }
+
+  static void HandleScreenshotWakeup(void* ctx) {
+    static_cast<MPVInstance*>(ctx)->CallOnMainThread(
+        0, &MPVInstance::HandleScreenshots);
+  }
+
+  void HandleScreenshots(int32_t) {
+    if (!screenshot_encoder_) {
+      return;
+    }
+    for (const auto &shot : screenshot_encoder_->Take()) {
+      pp::VarDictionary dst;
+      dst.Set("event", Var("screenshot"));
+      SetReplyId(&dst, shot.id);
+      dst.Set(keys_.dropped, Var(static_cast<int32_t>(shot.dropped)));
+      if (shot.error) {
+        dst.Set("error", Var(shot.error));
+        PostMessage(dst);
+        continue;
+      }
+      dst.Set(keys_.width, Var(shot.width));
+      dst.Set(keys_.height, Var(shot.height));
+      dst.Set(keys_.format, Var("png"));
+      if (!shot.path.empty()) {
+        dst.Set(keys_.file, Var(shot.path));
+      } else {
+        pp::VarArrayBuffer buffer(static_cast<uint32_t>(shot.data.size()));
+        memcpy(buffer.Map(), shot.data.data(), shot.data.size());
+        buffer.Unmap();
+        dst.Set(keys_.data, buffer);
+      }
+      PostMessage(dst);
+    }
+  }
+
+  // data is {stream, data, eof}: appends the ArrayBuffer data to the bytes
+  // a player reads from jsstream://<stream>, eof: true ends it. Replies
+  // {event: "stream-push-reply", id, stream, written, free}; bytes beyond
+  // written did not fit and are left to push again after a
+  // {event: "stream-drain", stream, free}. {event: "stream-closed",
+  // stream} once the player stops reading; pushes after it fail.
+  void HandleStreamPush(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data.is_dictionary() ? data : pp::VarDictionary());
+    Var name_var = data_dict.Get(keys_.stream);
+    pp::VarDictionary dst;
+    dst.Set("event", Var("stream-push-reply"));
+    SetReplyId(&dst, id);
+    dst.Set(keys_.stream, name_var);
+    if (!name_var.is_string()) {
+      dst.Set("error", Var("no stream"));
+      PostMessage(dst);
+      return;
+    }
+
+    std::string name = name_var.AsString();
+    std::shared_ptr<JsStream>& stream = js_streams_[name];
+    if (!stream) {
+      stream = streams_->Get(name);
+      stream->SetWakeup(HandleStreamWakeup, this);
+    }
+    if (stream->Closed()) {
+      stream->SetWakeup(nullptr, nullptr);
+      js_streams_.erase(name);
+      dst.Set("error", Var("closed"));
+      PostMessage(dst);
+      return;
+    }
+
+    size_t written = 0;
+    Var chunk = data_dict.Get(keys_.data);
+    if (chunk.is_array_buffer()) {
+      // straight from the page's buffer into the ring
+      pp::VarArrayBuffer buffer(chunk);
+      written = stream->Write(static_cast<const uint8_t*>(buffer.Map()),
+                              buffer.ByteLength());
+      buffer.Unmap();
+    }
+    Var eof = data_dict.Get(keys_.eof);
+    if (eof.is_bool() && eof.AsBool()) {
+      stream->SetEof();
+    }
+    dst.Set(keys_.written, Var(static_cast<int32_t>(written)));
+    dst.Set(keys_.free, Var(static_cast<int32_t>(stream->Free())));
+    PostMessage(dst);
+  }
+
+  static void HandleStreamWakeup(void* ctx) {
+    static_cast<MPVInstance*>(ctx)->CallOnMainThread(
+        0, &MPVInstance::HandleStreamEvents);
+  }
+
+  void HandleStreamEvents(int32_t) {
+    for (auto it = js_streams_.begin(); it != js_streams_.end();) {
+      JsStream* stream = it->second.get();
+      if (!stream->TakeSignal()) {
+        ++it;
+        continue;
+      }
+      pp::VarDictionary dst;
+      dst.Set(keys_.stream, Var(it->first));
+      if (stream->Closed()) {
+        dst.Set("event", Var("stream-closed"));
+        PostMessage(dst);
+        stream->SetWakeup(nullptr, nullptr);
+        it = js_streams_.erase(it);
+        continue;
+      }
+      dst.Set("event", Var("stream-drain"));
+      dst.Set(keys_.free, Var(static_cast<int32_t>(stream->Free())));
+      PostMessage(dst);
+      ++it;
+    }
+  }
+
+  // The scrcpy control connection; data is one of
+  //   {connect: port}  replies {event: "scrcpy-reply", id, connected}, later
+  //                    {event: "scrcpy-closed"} when it goes down
+  //   {touch: [action, pointer, x, y, width, height, pressure, buttons]}
+  //   {message: ArrayBuffer}  any other encoded control message
+  //   {close: true}
+  // A touch or message that isn't sent replies {event: "scrcpy-reply", id,
+  // connected, error}.
+  void HandleScrcpy(uint64_t id, const Var& data) {
+    pp::VarDictionary data_dict(data.is_dictionary() ? data : pp::VarDictionary());
+    Var touch = data_dict.Get(keys_.touch);
+    if (!touch.is_undefined()) {
+      if (!scrcpy_) {
+        ScrcpyDropped(id, "not connected");
+        return;
+      }
+      pp::VarArray t(touch.is_array() ? touch : pp::VarArray());
+      bool valid = t.GetLength() >= 8;
+      for (uint32_t i = 0; valid && i < 8; i++) {
+        valid = t.Get(i).is_number();
+      }
+      if (!valid) {
+        ScrcpyDropped(id, "bad touch");
+        return;
+      }
+      scrcpy_->SendTouch({static_cast<uint8_t>(t.Get(0).AsInt()),
+                          static_cast<uint32_t>(t.Get(1).AsInt()),
+                          static_cast<int32_t>(t.Get(2).AsDouble()),
+                          static_cast<int32_t>(t.Get(3).AsDouble()),
+                          static_cast<uint16_t>(t.Get(4).AsInt()),
+                          static_cast<uint16_t>(t.Get(5).AsInt()),
+                          static_cast<float>(t.Get(6).AsDouble()),
+                          static_cast<uint32_t>(t.Get(7).AsInt())});
+      return;
+    }
+    Var message = data_dict.Get(keys_.message);
+    if (!message.is_undefined()) {
+      if (!scrcpy_) {
+        ScrcpyDropped(id, "not connected");
+        return;
+      }
+      if (!message.is_array_buffer()) {
+        ScrcpyDropped(id, "bad message");
+        return;
+      }
+      pp::VarArrayBuffer buffer(message);
+      scrcpy_->Send(static_cast<const uint8_t*>(buffer.Map()), buffer.ByteLength());
+      buffer.Unmap();
+      return;
+    }
+    Var port = data_dict.Get(keys_.connect);
+    if (port.is_number()) {
+      AbortScrcpyConnect();
+      scrcpy_connect_id_ = id;
+      scrcpy_.reset(new ScrcpyControl(this));
+      scrcpy_->Connect(static_cast<uint16_t>(port.AsInt()),
+                       callback_factory_.NewCallback(&MPVInstance::ScrcpyConnected, id),
+                       callback_factory_.NewCallback(&MPVInstance::ScrcpyClosed));
+      return;
+    }
+    if (data_dict.Get(keys_.close).is_bool()) {
+      AbortScrcpyConnect();
+      scrcpy_.reset();
+    }
+  }
+
+  // A connection dropped before it was up never calls back; its request
+  // still gets a reply.
+  void AbortScrcpyConnect() {
+    if (scrcpy_connect_id_) {
+      ScrcpyConnected(PP_ERROR_ABORTED, scrcpy_connect_id_);
+    }
+  }
+
+  void ScrcpyConnected(int32_t result, uint64_t id) {
+    scrcpy_connect_id_ = 0;
+    pp::VarDictionary dst;
+    dst.Set("event", Var("scrcpy-reply"));
+    SetReplyId(&dst, id);
+    dst.Set("connected", Var(result == PP_OK));
+    if (result != PP_OK) {
+      dst.Set("error", Var(result));
+      scrcpy_.reset();
+    }
+    PostMessage(dst);
+  }
+
+  void ScrcpyDropped(uint64_t id, const char* error) {
+    pp::VarDictionary dst;
+    dst.Set("event", Var("scrcpy-reply"));
+    SetReplyId(&dst, id);
+    dst.Set("connected", Var(static_cast<bool>(scrcpy_)));
+    dst.Set("error", Var(error));
+    PostMessage(dst);
+  }
+
+  void ScrcpyClosed(int32_t result) {
+    pp::VarDictionary dst;
+    dst.Set("event", Var("scrcpy-closed"));
+    dst.Set("error", Var(result));
+    PostMessage(dst);
+    scrcpy_.reset();
+  }
+
+  // Native input. Keys go to the player under the pointer; mouse moves
+  // and view changes are coalesced and go out at most once per
+  // kInputInterval, the first after a pause right away.
+  bool SendKey(const std::string& name) {
+    if (name.empty() || input_.Ignored(name)) {
+      return false;
+    }
+    const char* args[] = {"keypress", name.c_str(), nullptr};
+    mpv_command_async(tiles_[input_tile_]->mpv, InputReply(input_tile_), args);
+    if (input_notify_) {
+      pp::VarDictionary dst = InputNotice(input_tile_, "key");
+      dst.Set("key", Var(name));
+      PostMessage(dst);
+    }
+    return true;
+  }
+
+  bool HandleMouse(const pp::MouseInputEvent& event) {
+    ViewState view = view_state_.load();
+    if (!view.width) {
+      return false;
+    }
+    // device pixels of the view
+    pointer_x_ = event.GetPosition().x() * view.scale;
+    pointer_y_ = event.GetPosition().y() * view.scale;
+    if (!dragging_) {
+      input_tile_ = TileAt(pointer_x_ / view.width, pointer_y_ / view.height);
+    }
+    Tile* tile = tiles_[input_tile_].get();
+    double x = pointer_x_ - tile->layout.x * view.width;
+    double y = pointer_y_ - tile->layout.y * view.height;
+
+    PP_InputEvent_Type type = event.GetType();
+    if (input_.mouse() == NativeInput::POINTER_MPV) {
+      tile->mouse_x = static_cast<int32_t>(x);
+      tile->mouse_y = static_cast<int32_t>(y);
+      tile->mouse_dirty = true;
+      if (type == PP_INPUTEVENT_TYPE_MOUSEMOVE) {
+        ScheduleInputFlush();
+        // the page still sees moves, for its control bar
+        return false;
+      }
+      static const char* kButtons[] = {"MBTN_LEFT", "MBTN_MID", "MBTN_RIGHT"};
+      int32_t button = event.GetButton();
+      if (button < 0 || button > 2) {
+        return false;
+      }
+      // the press lands where the pointer is now
+      FlushInput();
+      const char* args[] = {type == PP_INPUTEVENT_TYPE_MOUSEDOWN ? "keydown" : "keyup",
+                            kButtons[button], nullptr};
+      mpv_command_async(tile->mpv, InputReply(input_tile_), args);
+      return true;
+    }
+    if (input_.mouse() != NativeInput::POINTER_VIEW) {
+      return false;
+    }
+
+    // a drag with the left button pans a zoomed player; clicks on one at
+    // its fitted size are the page's
+    switch (type) {
+      case PP_INPUTEVENT_TYPE_MOUSEDOWN:
+        if (event.GetButton() != PP_INPUTEVENT_MOUSEBUTTON_LEFT ||
+            tile->view.zoom <= 0) {
+          return false;
+        }
+        dragging_ = true;
+        break;
+      case PP_INPUTEVENT_TYPE_MOUSEMOVE:
+        if (!dragging_) {
+          return false;
+        }
+        if (!(event.GetModifiers() & PP_INPUTEVENT_MODIFIER_LEFTBUTTONDOWN)) {
+          // released outside the plugin
+          dragging_ = false;
+          return false;
+        }
+        tile->view = NativeInput::PanBy(tile->view, x - drag_x_, y - drag_y_,
+                                        tile->layout.w * view.width,
+                                        tile->layout.h * view.height,
+                                        tile->aspect);
+        ViewChanged(tile);
+        break;
+      default:
+        if (!dragging_) {
+          return false;
+        }
+        dragging_ = false;
+        break;
+    }
+    drag_x_ = x;
+    drag_y_ = y;
+    return true;
+  }
+
+  bool HandleWheel(const pp::WheelInputEvent& event) {
+    ViewState view = view_state_.load();
+    if (!view.width || input_.wheel() == NativeInput::POINTER_OFF) {
+      return false;
+    }
+    Tile* tile = tiles_[input_tile_].get();
+    // positive is away from the user: zoom in, WHEEL_UP
+    double ticks = event.GetTicks().y();
+    if (input_.wheel() == NativeInput::POINTER_MPV) {
+      // notches of smooth scrolling add up to whole ones
+      wheel_ticks_ += ticks;
+      while (fabs(wheel_ticks_) >= 1) {
+        const char* args[] = {"keypress", wheel_ticks_ > 0 ? "WHEEL_UP" : "WHEEL_DOWN",
+                              nullptr};
+        mpv_command_async(tile->mpv, InputReply(input_tile_), args);
+        wheel_ticks_ -= wheel_ticks_ > 0 ? 1 : -1;
+      }
+      return true;
+    }
+    tile->view = NativeInput::ZoomAt(
+        tile->view, ticks, pointer_x_ - tile->layout.x * view.width,
+        pointer_y_ - tile->layout.y * view.height, tile->layout.w * view.width,
+        tile->layout.h * view.height, tile->aspect);
+    ViewChanged(tile);
+    return true;
+  }
+
+  // the tile at (fx, fy), fractions of the view
+  uint32_t TileAt(double fx, double fy) const {
+    for (uint32_t i = 0; i < tiles_.size(); i++) {
+      const TileRect& rect = tiles_[i]->layout;
+      if (fx >= rect.x && fx < rect.x + rect.w && fy >= rect.y &&
+          fy < rect.y + rect.h) {
+        return i;
+      }
+    }
+    return input_tile_;
+  }
+
+  void ViewChanged(Tile* tile) {
+    tile->view_dirty = true;
+    tile->view_changed = Now();
+    ScheduleInputFlush();
+  }
+
+  void ScheduleInputFlush() {
+    if (input_flush_posted_) {
+      return;
+    }
+    int32_t delay = static_cast<int32_t>(
+        ceil(kInputInterval - (Now() - last_input_flush_) * 1000));
+    if (delay <= 0) {
+      FlushInput();
+      return;
+    }
+    input_flush_posted_ = true;
+    pp::Module::Get()->core()->CallOnMainThread(delay,
+        callback_factory_.NewCallback(&MPVInstance::InputFlushDue));
+  }
+
+  void InputFlushDue(int32_t) {
+    input_flush_posted_ = false;
+    FlushInput();
+  }
+
+  void FlushInput() {
+    last_input_flush_ = Now();
+    for (auto& tile : tiles_) {
+      uint64_t reply = InputReply(tile->index);
+      if (tile->mouse_dirty) {
+        tile->mouse_dirty = false;
+        std::string x = std::to_string(tile->mouse_x);
+        std::string y = std::to_string(tile->mouse_y);
+        const char* args[] = {"mouse", x.c_str(), y.c_str(), nullptr};
+        mpv_command_async(tile->mpv, reply, args);
+      }
+      if (tile->view_dirty) {
+        tile->view_dirty = false;
+        mpv_set_property_async(tile->mpv, reply, "video-zoom", MPV_FORMAT_DOUBLE,
+                               &tile->view.zoom);
+        mpv_set_property_async(tile->mpv, reply, "video-pan-x", MPV_FORMAT_DOUBLE,
+                               &tile->view.pan_x);
+        mpv_set_property_async(tile->mpv, reply, "video-pan-y", MPV_FORMAT_DOUBLE,
+                               &tile->view.pan_y);
+        if (input_notify_) {
+          pp::VarDictionary dst = InputNotice(tile->index, "view");
+          dst.Set("zoom", Var(tile->view.zoom));
+          dst.Set("pan_x", Var(tile->view.pan_x));
+          dst.Set("pan_y", Var(tile->view.pan_y));
+          PostMessage(dst);
+        }
+      }
+    }
+  }
+
+  pp::VarDictionary InputNotice(uint32_t tile, const char* kind) {
+    pp::VarDictionary dst;
+    dst.Set("event", Var("input"));
+    if (compositor_) {
+      dst.Set(keys_.tile, Var(static_cast<int32_t>(tile)));
+    }
+    dst.Set("kind", Var(kind));
+    return dst;
+  }
+
+  // The view follows the player too, so a crop() from the page or a
+  // binding that zooms is where the next wheel notch starts from.
+  void ObserveView(Tile* tile) {
+    if (!tile->mpv || tile->view_observed) {
+      return;
+    }
+    tile->view_observed = true;
+    uint64_t reply = InputReply(tile->index);
+    tile->observed.push_back(reply);
+    for (const char* name : {"video-zoom", "video-pan-x", "video-pan-y",
+                             "video-params/aspect"}) {
+      mpv_observe_property(tile->mpv, reply, name, MPV_FORMAT_DOUBLE);
+    }
+  }
+
+  void UpdateView(uint32_t tile_index, const mpv_event_property* prop) {
+    Tile* tile = tiles_[tile_index].get();
+    double value = prop->format == MPV_FORMAT_DOUBLE ? *static_cast<double*>(prop->data) : 0;
+    if (!strcmp(prop->name, "video-params/aspect")) {
+      tile->aspect = value;
+      return;
+    }
+    // our own changes echo back, possibly behind newer ones
+    if (tile->view_dirty || Now() - tile->view_changed < kViewSettle) {
+      return;
+    }
+    if (!strcmp(prop->name, "video-zoom")) {
+      tile->view.zoom = value;
+    } else if (!strcmp(prop->name, "video-pan-x")) {
+      tile->view.pan_x = value;
+    } else if (!strcmp(prop->name, "video-pan-y")) {
+      tile->view.pan_y = value;
+    }
+  }
+
+  // Replies and property changes of native input, never seen by the page.
+  static uint64_t InputReply(uint32_t tile) {
+    return kInputReply | tile_id(tile, 0);
+  }
+
+  mpv_handle* MpvFor(uint64_t id) {
+    return TileFor(id)->mpv;
+  }
+
+  // A setting of this handle the pool resets when it goes back.
+  static void Touch(Tile* tile, const std::string& name) {
+    static const char kOptions[] = "options/";
+    if (!name.compare(0, sizeof(kOptions) - 1, kOptions)) {
+      tile->touched.insert(name.substr(sizeof(kOptions) - 1));
+    } else {
+      tile->touched.insert(name);
+    }
+  }
+
+  // First change of a setting that must go back to its value before
+  // while the player runs, not only to mpv's default when it goes back
+  // to the pool: reads the value, a round trip to the core.
+  void SaveSetting(Tile* tile, const std::string& name) {
+    Touch(tile, name);
+    for (const auto &setting : tile->restore) {
+      if (setting.first == name) {
+        return;
+      }
+    }
+    char* value = mpv_get_property_string(tile->mpv, name.c_str());
+    if (value) {
+      tile->restore.emplace_back(name, value);
+      mpv_free(value);
+    }
+  }
+
+  // Replies carry the client's id, and the tile in compositor mode.
+  void SetReplyId(pp::VarDictionary* dst, uint64_t id) {
+    dst->Set(keys_.id, Var(client_id(id)));
+    if (compositor_) {
+      dst->Set(keys_.tile, Var(static_cast<int32_t>(tile_of(id))));
+    }
+  }
+
+  // Builds a command tree in node_arena_, valid until its next Reset().
+  bool BuildCommand(const Var& data, mpv_node* cmd) {
+    if (data.is_string()) {
+      // construct as node array
+      mpv_node* values = node_arena_.NewList(cmd, MPV_FORMAT_NODE_ARRAY, 1);
+      node_arena_.Build(data, &values[0]);
+    } else {
+      node_arena_.Build(data, cmd);
+    }
+    return cmd->format == MPV_FORMAT_NODE_ARRAY || cmd->format == MPV_FORMAT_NODE_MAP;
+  }
+
+  static void* GetProcAddressMPV(void* fn_ctx, const char* name) {
+    auto search = GL_CALLBACKS.find(name);
+    if (search == GL_CALLBACKS.end()) {
+      fprintf(stderr, "FIXME: missed GL function %s\n", name);
+      return NULL;
+    } else {
+      return search->second;
+    }
+  }
+
+  void HandleMPVEvents(int32_t tile) {
+    ScopedSpan span(&metrics_.event_drain, &trace_, "mpv events",
+                    Trace::THREAD_MAIN, tile);
+    mpv_handle* mpv = tiles_[tile]->mpv;
+    uint64_t count = 0;
+    for (;;) {
+      mpv_event* event = mpv_wait_event(mpv, 0);
+      // printf("@@@ EVENT %d\n", event->event_id);
+      if (event->event_id == MPV_EVENT_NONE) break;
+
+      const char* evname = mpv_event_name(event->event_id);
+      if (evname) {
+        DispatchEvent(event, evname, tile);
+      }
+      count++;
+    }
+
+    FlushEvents();
+
+    // wakeups come one per event or so; the earliest waited longest
+    int64_t wakeup_at = tiles_[tile]->wakeup_at.exchange(0);
+    if (wakeup_at && count) {
+      Trace::Clock::duration waited =
+          Trace::Clock::now().time_since_epoch() - Trace::Clock::duration(wakeup_at);
+      metrics_.event_latency.Add(std::chrono::duration<double>(waited).count());
+    }
+    metrics_.events.Add(count);
+    metrics_.events_per_drain.Set(count);
+  }
+
+  // An event ready for delivery: a Var, or its binary encoding when
+  // binary_events_ is on.
+  struct OutEvent {
+    Var var;
+    EventEncoder::Event encoded;
+
+    bool empty() const { return var.is_undefined() && encoded.empty(); }
+  };
+
+  OutEvent ConvertEvent(mpv_event* event, const char* evname, uint32_t tile) {
+    int32_t tag = compositor_ ? static_cast<int32_t>(tile) : -1;
+    OutEvent out;
+    if (binary_events_) {
+      encoder_.Encode(event, evname, tag, &out.encoded);
+    } else {
+      out.var = mpv_event_to_js(event, evname, tag);
+    }
+    return out;
+  }
+
+  void DispatchEvent(mpv_event* event, const char* evname, uint32_t tile) {
+    const char* prop_name = nullptr;
+
+    if (event->reply_userdata >= kBatchReplyBase && CompleteBatchItem(event)) {
+      return;
+    }
+    if (event->event_id == MPV_EVENT_HOOK &&
+        (event->reply_userdata & PlayerPool::kHookReply) &&
+        !RoutePoolHook(event, tile)) {
+      return;
+    }
+    if (event->reply_userdata & kInputReply) {
+      if (event->event_id == MPV_EVENT_PROPERTY_CHANGE) {
+        UpdateView(tile, static_cast<mpv_event_property*>(event->data));
+      }
+      return;
+    }
+    if (event->reply_userdata & kQualityReply) {
+      if (event->event_id == MPV_EVENT_PROPERTY_CHANGE) {
+        UpdateDrops(tile, static_cast<mpv_event_property*>(event->data));
+      }
+      return;
+    }
+    if (event->reply_userdata & kCacheReply) {
+      if (event->event_id == MPV_EVENT_GET_PROPERTY_REPLY) {
+        UpdateCache(tile, static_cast<mpv_event_property*>(event->data));
+      }
+      return;
+    }
+
+    if (event->event_id == MPV_EVENT_LOG_MESSAGE) {
+      if (log_.Add(tile, static_cast<mpv_event_log_message*>(event->data))) {
+        LogAdded();
+      }
+      return;
+    }
+
+    if (event->event_id == MPV_EVENT_PROPERTY_CHANGE) {
+      auto prop = static_cast<mpv_event_property*>(event->data);
+      prop_name = prop->name;
+
+      PropertyDiff* diff = FindDiff(event->reply_userdata, prop_name);
+      if (diff) {
+        DispatchDiff(diff, event, prop);
+        return;
+      }
+
+      PropertyThrottle* throttle = FindThrottle(event->reply_userdata, prop_name);
+      if (throttle && !throttle->Admit(prop, Now())) {
+        throttle->held = ConvertEvent(event, evname, tile);
+        ScheduleThrottleFlush(throttle->NextFlush());
+        return;
+      }
+    }
+
+    QueueEvent(ConvertEvent(event, evname, tile), event->reply_userdata, prop_name);
+  }
+
+  // A hook the pool added to the handle goes to the page's hook for it,
+  // or is continued at once if the page has none. False if it was.
+  bool RoutePoolHook(mpv_event* event, uint32_t tile) {
+    Tile* owner = tiles_[tile].get();
+    uint64_t index = event->reply_userdata & ~PlayerPool::kHookReply;
+    int32_t hook = index < PlayerPool::kHookCount ? owner->pool_hooks[index] : 0;
+    if (!hook) {
+      mpv_hook_continue(owner->mpv,
+                        static_cast<mpv_event_hook*>(event->data)->id);
+      return false;
+    }
+    event->reply_userdata = tile_id(tile, hook);
+    return true;
+  }
+
+  // Patches bypass throttling and coalescing: dropping one would leave the
+  // client applying the next to the wrong base.
+  void DispatchDiff(PropertyDiff* diff, mpv_event* event, mpv_event_property* prop) {
+    if (prop->format != MPV_FORMAT_NODE) {
+      diff->Clear();
+      QueueEvent(ConvertEvent(event, "property-change", tile_of(diff->id())),
+                 event->reply_userdata, nullptr);
+      return;
+    }
+
+    bool is_patch;
+    const mpv_node* value = diff->Update(static_cast<mpv_node*>(prop->data), &is_patch);
+    if (value) {
+      QueueProperty(diff, value, is_patch);
+    }
+  }
+
+  void QueueProperty(PropertyDiff* diff, const mpv_node* value, bool is_patch) {
+    mpv_event_property prop = {diff->name().c_str(), MPV_FORMAT_NODE, const_cast<mpv_node*>(value)};
+    mpv_event event = {};
+    event.event_id = MPV_EVENT_PROPERTY_CHANGE;
+    event.reply_userdata = diff->id();
+    event.data = &prop;
+
+    const char* evname = is_patch ? "property-patch" : "property-change";
+    QueueEvent(ConvertEvent(&event, evname, tile_of(diff->id())), diff->id(), nullptr);
+  }
+
+  PropertyDiff* FindDiff(uint64_t id, const char* name) {
+    for (auto &diff : diffs_) {
+      if (diff->id() == id && diff->name() == name) {
+        return diff.get();
+      }
+    }
+    return nullptr;
+  }
+
+  void RemoveDiffs(uint64_t id) {
+    for (auto it = diffs_.begin(); it != diffs_.end();) {
+      if ((*it)->id() == id) {
+        it = diffs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void QueueEvent(OutEvent ev, uint64_t id, const char* prop_name) {
+    if (!batch_events_) {
+      if (ev.encoded.empty()) {
+        PostMessage(ev.var);
+      } else {
+        encoder_.Append(ev.encoded);
+        PostMessage(encoder_.Take());
+      }
+      return;
+    }
+
+    // Keep only the latest change of each observed property, in the
+    // position of that latest change.
+    if (prop_name) {
+      for (auto &pending : pending_props_) {
+        if (pending.id == id && pending.name == prop_name) {
+          pending_events_[pending.index] = OutEvent();
+          pending.index = pending_events_.size();
+          pending_events_.push_back(std::move(ev));
+          return;
+        }
+      }
+      pending_props_.push_back({id, prop_name, pending_events_.size()});
+    }
+
+    pending_events_.push_back(std::move(ev));
+  }
+
+  // Batched mode: everything drained in one wakeup goes out as one array,
+  // or one ArrayBuffer in binary mode.
+  void FlushEvents() {
+    if (pending_events_.empty()) {
+      return;
+    }
+    metrics_.pending_events.Set(pending_events_.size());
+
+    pp::VarArray batch;
+    uint32_t n = 0;
+    for (const auto &ev : pending_events_) {
+      if (!ev.encoded.empty()) {
+        encoder_.Append(ev.encoded);
+      } else if (!ev.var.is_undefined()) {
+        batch.Set(n++, ev.var);
+      }
+    }
+    pending_events_.clear();
+    pending_props_.clear();
+
+    // both only while switching modes
+    if (n > 0) {
+      PostMessage(batch);
+    }
+    if (encoder_.has_pending()) {
+      PostMessage(encoder_.Take());
+    }
+  }
+
+  // Rate limit / change threshold of one observed property.
+  struct PropertyThrottle {
+    // held back by the threshold alone, a value still arrives this late
+    static constexpr double kThresholdFlush = 0.5;  // s
+
+    uint64_t id;
+    std::string name;
+    double interval{0};  // seconds, 0 = no rate limit
+    double epsilon{0};   // 0 = no threshold
+    bool sent{false};
+    PP_TimeTicks last_sent{0};
+    double last_value{0};
+    OutEvent held;  // latest change not yet forwarded
+    bool held_numeric{false};
+    double held_value{0};
+
+    bool Admit(const mpv_event_property* prop, PP_TimeTicks now) {
+      double value = 0;
+      bool numeric = property_to_double(prop, &value);
+
+      // becoming unavailable is a state change, never hold it back
+      bool pass = !sent || prop->format == MPV_FORMAT_NONE;
+      if (!pass && interval > 0) {
+        pass = now - last_sent >= interval;
+      }
+      if (!pass && epsilon > 0 && numeric) {
+        pass = fabs(value - last_value) > epsilon;
+      }
+      // threshold only, but not a number
+      if (!pass && interval <= 0 && !numeric) {
+        pass = true;
+      }
+
+      if (pass) {
+        sent = true;
+        last_sent = now;
+        if (numeric) {
+          last_value = value;
+        }
+        held = OutEvent();
+      } else {
+        held_numeric = numeric;
+        held_value = value;
+      }
+      return pass;
+    }
+
+    PP_TimeTicks NextFlush() const {
+      return last_sent + (interval > 0 ? interval : kThresholdFlush);
+    }
+  };
+
+  static PP_TimeTicks Now() {
+    return pp::Module::Get()->core()->GetTimeTicks();
+  }
+
+  void AddThrottle(uint64_t id, const std::string &name, const Var &rate, const Var &epsilon) {
+    PropertyThrottle throttle;
+    throttle.id = id;
+    throttle.name = name;
+    if (rate.is_number() && rate.AsDouble() > 0) {
+      throttle.interval = 1.0 / rate.AsDouble();
+    }
+    if (epsilon.is_number() && epsilon.AsDouble() > 0) {
+      throttle.epsilon = epsilon.AsDouble();
+    }
+    if (throttle.interval > 0 || throttle.epsilon > 0) {
+      throttles_.push_back(std::move(throttle));
+    }
+  }
+
+  void RemoveThrottles(uint64_t id) {
+    for (auto it = throttles_.begin(); it != throttles_.end();) {
+      if (it->id == id) {
+        it = throttles_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  PropertyThrottle* FindThrottle(uint64_t id, const char* name) {
+    for (auto &throttle : throttles_) {
+      if (throttle.id == id && throttle.name == name) {
+        return &throttle;
+      }
+    }
+    return nullptr;
+  }
+
+  // Held values are flushed once their interval expires, kThresholdFlush
+  // for threshold-only properties, so the last value always arrives.
+  void ScheduleThrottleFlush(PP_TimeTicks at) {
+    if (at <= 0 || (throttle_flush_at_ > 0 && throttle_flush_at_ <= at)) {
+      return;
+    }
+    throttle_flush_at_ = at;
+    int32_t delay = static_cast<int32_t>(ceil((at - Now()) * 1000));
+    pp::Module::Get()->core()->CallOnMainThread(delay > 0 ? delay : 0,
+        callback_factory_.NewCallback(&MPVInstance::FlushThrottled, ++throttle_generation_));
+  }
+
+  void FlushThrottled(int32_t, uint32_t generation) {
+    // superseded by an earlier flush
+    if (generation != throttle_generation_) {
+      return;
+    }
+    throttle_flush_at_ = 0;
+
+    // timers may fire a little early
+    PP_TimeTicks now = Now() + 0.001;
+    PP_TimeTicks next = 0;
+    for (auto &throttle : throttles_) {
+      if (throttle.held.empty()) {
+        continue;
+      }
+      PP_TimeTicks due = throttle.NextFlush();
+      if (due <= now) {
+        throttle.last_sent = Now();
+        if (throttle.held_numeric) {
+          throttle.last_value = throttle.held_value;
+        }
+        QueueEvent(std::move(throttle.held), throttle.id, throttle.name.c_str());
+        throttle.held = OutEvent();
+      } else if (next <= 0 || due < next) {
+        next = due;
+      }
+    }
+
+    FlushEvents();
+    ScheduleThrottleFlush(next);
+  }
+
+  // A batch is an array of {type, data, id} requests run in one call, in
+  // order, answered by one batch-reply with a {result} or {error} per
+  // item. Commands and property writes are issued async under reply ids
+  // from kBatchReplyBase up; the reply goes out once the last one is back.
+  // Other request types run as usual and count as done right away.
+  static constexpr uint64_t kBatchReplyBase = 1ull << 48;
+
+  struct PendingBatch {
+    uint64_t id;
+    uint64_t first_reply;
+    uint32_t count;
+    uint32_t remaining;
+    pp::VarArray results;
+  };
+
+  void RunBatch(uint64_t id, const Var& data) {
+    pp::VarArray items(data);
+    PendingBatch batch;
+    batch.id = id;
+    batch.count = items.GetLength();
+    batch.remaining = 0;
+    batch.first_reply = next_batch_reply_;
+    next_batch_reply_ += batch.count;
+
+    for (uint32_t i = 0; i < batch.count; i++) {
+      Var item = items.Get(i);
+      pp::VarDictionary item_dict(item);
+      RequestOp op = RequestOpOf(item_dict);
+      Var item_data = item_dict.Get(keys_.data);
+      uint64_t reply = batch.first_reply + i;
+      int rc = 0;
+
+      if (op == OP_COMMAND) {
+        mpv_node cmd;
+        if (!BuildCommand(item_data, &cmd)) {
+          rc = MPV_ERROR_INVALID_PARAMETER;
+        } else {
+          rc = mpv_command_node_async(MpvFor(id), reply, &cmd);
+        }
+        node_arena_.Reset();
+        if (rc >= 0) {
+          batch.remaining++;
+        }
+      } else if (op == OP_SET_PROPERTY) {
+        pp::VarDictionary data_dict(item_data);
+        std::string name = data_dict.Get(keys_.name).AsString();
+        PropertyValue value(data_dict.Get(keys_.value));
+        if (value.format == MPV_FORMAT_NONE) {
+          rc = MPV_ERROR_INVALID_PARAMETER;
+        } else {
+          Touch(TileFor(id), name);
+          rc = mpv_set_property_async(MpvFor(id), reply, name.c_str(), value.format, value.data());
+        }
+        if (rc >= 0) {
+          batch.remaining++;
+        }
+      } else if (op == OP_SET_OPTION) {
+        pp::VarDictionary data_dict(item_data);
+        std::string name = data_dict.Get(keys_.name).AsString();
+        std::string value = data_dict.Get(keys_.value).AsString();
+        Touch(TileFor(id), name);
+        rc = mpv_set_option_string(MpvFor(id), name.c_str(), value.c_str());
+      } else if (op == OP_BATCH || op == OP_NONE) {
+        rc = MPV_ERROR_INVALID_PARAMETER;
+      } else {
+        Var item_id = item_dict.Get(keys_.id);
+        uint64_t item = tile_id(tile_of(id), item_id.is_number() ? item_id.AsInt() : 0);
+        (this->*kRequestHandlers[op].handle)(item, item_data);
+      }
+
+      pp::VarDictionary result;
+      if (rc < 0) {
+        result.Set("error", Var(mpv_error_string(rc)));
+      }
+      batch.results.Set(i, result);
+    }
+
+    if (batch.remaining == 0) {
+      PostBatchReply(batch);
+    } else {
+      batches_.push_back(std::move(batch));
+    }
+  }
+
+  bool CompleteBatchItem(const mpv_event* event) {
+    if (event->event_id != MPV_EVENT_COMMAND_REPLY &&
+        event->event_id != MPV_EVENT_SET_PROPERTY_REPLY) {
+      return false;
+    }
+
+    for (auto it = batches_.begin(); it != batches_.end(); ++it) {
+      uint64_t index = event->reply_userdata - it->first_reply;
+      if (event->reply_userdata < it->first_reply || index >= it->count) {
+        continue;
+      }
+
+      pp::VarDictionary result;
+      if (event->error < 0) {
+        result.Set("error", Var(mpv_error_string(event->error)));
+      } else if (event->event_id == MPV_EVENT_COMMAND_REPLY) {
+        auto cmd = static_cast<mpv_event_command*>(event->data);
+        result.Set("result", node_to_var(&cmd->result));
+      }
+      it->results.Set(static_cast<uint32_t>(index), result);
+
+      if (--it->remaining == 0) {
+        PostBatchReply(*it);
+        batches_.erase(it);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void PostBatchReply(const PendingBatch& batch) {
+    pp::VarDictionary dst;
+    dst.Set("event", Var("batch-reply"));
+    SetReplyId(&dst, batch.id);
+    dst.Set("results", batch.results);
+
+    PostMessage(dst);
+  }
+
+  void PostCommandFail(uint64_t id, int code, const char* err) {
+    pp::VarDictionary dst;
+    dst.Set("event", Var("command-reply"));
+    SetReplyId(&dst, id);
+
+    if (err) {
+      dst.Set("error", Var(err));
+    } else {
+      dst.Set("error", Var(std::to_string(code)));
+    }
+
+    PostMessage(dst);
+  }
+
+  void PostDebugMsg(const std::string &msg) {
+    pp::VarDictionary dst;
+    dst.Set("error", Var(msg));
+
+    PostMessage(dst);
+  }
+
+  // ctx is the Tile
+  static void HandleMPVWakeup(void* ctx) {
+    auto tile = static_cast<Tile*>(ctx);
+    int64_t none = 0;
+    tile->wakeup_at.compare_exchange_strong(
+        none, Trace::Clock::now().time_since_epoch().count());
+    tile->owner->CallOnMainThread(0, &MPVInstance::HandleMPVEvents, tile->index);
+  }
+
+  // Called on an mpv thread, possibly many times per frame; one pending
+  // render thread call is enough for all tiles.
+  static void HandleMPVUpdate(void* ctx) {
+    static_cast<Tile*>(ctx)->owner->PostRenderUpdate();
+  }
+
+  bool InitGL() {
+    if (!glInitializePPAPI(pp::Module::Get()->get_browser_interface()))
+      DIE("unable to initialize GL PPAPI");
+
+    const int32_t attrib_list[] = {
+      PP_GRAPHICS3DATTRIB_ALPHA_SIZE, 8,
+      PP_GRAPHICS3DATTRIB_DEPTH_SIZE, 24,
+      PP_GRAPHICS3DATTRIB_NONE
+    };
+
+    context_ = pp::Graphics3D(this, attrib_list);
+    if (!BindGraphics(context_))
+      DIE("unable to bind 3d context");
+
+    return true;
+  }
+
+  bool InitMPV() {
+    for (auto &tile : tiles_) {
+      if (!InitPlayer(tile.get()))
+        return false;
+    }
+    return true;
+  }
+
+  // Options are set by the pool, the handle only needs its wakeup.
+  bool InitPlayer(Tile* tile) {
+    mpv_handle* mpv = pool_->Lease();
+    tile->mpv = mpv;
+    if (!mpv)
+      DIE("mpv init failed");
+
+#if defined(MPV_PEPPER_HEADLESS)
+    // Benchmark build: no GL context behind the fake Graphics3D, but the
+    // software renderer works.
+    if (!presenter_) {
+      Touch(tile, "vo");
+      mpv_set_option_string(mpv, "vo", "null");
+    }
+#endif
+
+    streams_->Register(mpv);
+    if (log_.enabled()) {
+      mpv_request_log_messages(mpv, log_.mpv_level());
+    }
+    mpv_set_wakeup_callback(mpv, HandleMPVWakeup, tile);
+    return true;
+  }
+
+  // Render thread. The GL context is made current here once and stays
+  // bound to this thread; mpv wants its render contexts created and used
+  // on the same thread.
+  bool InitRenderContext() {
+#if !defined(MPV_PEPPER_HEADLESS)
+    if (!presenter_) {
+      glSetCurrentContextPPAPI(context_.pp_resource());
+      // a single player needs it too, to upscale with dynamic resolution
+      if (!tile_compositor_.Init())
+        DIE("failed to initialize tile compositor");
+    }
+#endif
+
+    for (auto &tile : tiles_) {
+      if (!InitRenderContext(tile.get()))
+        return false;
+    }
+    rendering_ = tiles_[0]->render != nullptr;
+    return true;
+  }
+
+  bool InitRenderContext(Tile* tile) {
+    if (presenter_) {
+      mpv_render_param params[] = {
+          {MPV_RENDER_PARAM_API_TYPE, const_cast<char *>(MPV_RENDER_API_TYPE_SW)},
+          {MPV_RENDER_PARAM_INVALID, nullptr}
+      };
+
+      if (mpv_render_context_create(&tile->render, tile->mpv, params) < 0)
+        DIE("failed to initialize mpv software renderer");
+    } else {
+#if !defined(MPV_PEPPER_HEADLESS)
+      mpv_opengl_init_params gl_init_params{GetProcAddressMPV, nullptr};
+      mpv_render_param params[] = {
+          {MPV_RENDER_PARAM_API_TYPE, const_cast<char *>(MPV_RENDER_API_TYPE_OPENGL)},
+          {MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &gl_init_params},
+          {MPV_RENDER_PARAM_INVALID, nullptr}
+      };
+
+      if (mpv_render_context_create(&tile->render, tile->mpv, params) < 0)
+        DIE("failed to initialize mpv GL context");
+#endif
+    }
+
+    if (tile->render)
+      mpv_render_context_set_update_callback(tile->render, HandleMPVUpdate, tile);
+    return true;
+  }
+
+private:
+  void PostReady(bool result) {
+    pp::VarDictionary dict;
+    dict.Set(pp::Var("type"), pp::Var("ready"));
+    dict.Set(pp::Var("data"), Var(result));
+    PostMessage(dict);
+  }
+
+  void InitRender(int32_t) {
+    CallOnMainThread(0, &MPVInstance::RenderReady, InitRenderContext());
+  }
+
+  void RenderReady(int32_t result) {
+    PostReady(result != 0);
+  }
+
+  // Render thread. A buffer for a grab; the tile is drawn again so a
+  // paused player still delivers.
+  void AddGrabBuffer(int32_t, const GrabBuffer& lent) {
+    auto stream = std::find_if(grabs_.begin(), grabs_.end(), [&lent](const GrabStream& s) {
+      return s.request == lent.request;
+    });
+    if (stream == grabs_.end()) {
+      grabs_.push_back({lent.request, 0, false, {}});
+      stream = grabs_.end() - 1;
+    }
+    stream->buffers.push_back(lent);
+
+    if (!lent.request.every) {
+      RedrawTile(lent.request.tile);
+    }
+  }
+
+  void AddScreenshot(int32_t, const ShotRequest& request) {
+    EndScreenshot(0, request.frame.id);
+    shots_.push_back({request, 0, 0, 0, false});
+    if (!request.frame.every) {
+      RedrawTile(request.frame.tile);
+    }
+  }
+
+  void EndScreenshot(int32_t, uint64_t id) {
+    shots_.erase(std::remove_if(shots_.begin(), shots_.end(),
+                                [id](const ShotStream& s) {
+                                  return s.request.frame.id == id;
+                                }),
+                 shots_.end());
+  }
+
+  void RedrawTile(uint32_t tile) {
+    if (tile < tiles_.size()) {
+      tiles_[tile]->frame_due = true;
+      frame_due_ = true;
+      OnGetFrame(0);
+    }
+  }
+
+  void EndGrab(int32_t, uint64_t id) {
+    for (auto it = grabs_.begin(); it != grabs_.end();) {
+      if (it->request.id != id || !it->request.every) {
+        ++it;
+        continue;
+      }
+      for (const GrabBuffer& buffer : it->buffers) {
+        CallOnMainThread(0, &MPVInstance::GrabBufferReturned,
+                         static_cast<int32_t>(buffer.slot));
+      }
+      it = grabs_.erase(it);
+    }
+  }
+
+  void ShutdownRender(int32_t) {
+    if (!presenter_) {
+      glSetCurrentContextPPAPI(context_.pp_resource());
+    }
+    for (auto &tile : tiles_) {
+      if (tile->render) {
+        mpv_render_context_free(tile->render);
+        tile->render = nullptr;
+      }
+      if (!presenter_) {
+        tile_compositor_.Release(&tile->surface);
+      }
+    }
+    if (!presenter_) {
+      tile_compositor_.Destroy();
+    }
+    grabs_.clear();
+    shots_.clear();
+    rendering_ = false;
+    render_loop_.PostQuit(true);
+  }
+
+  // Any thread.
+  void PostRenderUpdate() {
+    if (!update_posted_.exchange(true)) {
+      render_loop_.PostWork(
+          callback_factory_.NewCallback(&MPVInstance::OnRenderUpdate));
+    }
+  }
+
+  // Everything from here to PaintFinished runs on the render thread, which
+  // owns the render state below; only view_state_ and update_posted_ are
+  // shared with other threads.
+  void OnRenderUpdate(int32_t) {
+    update_posted_ = false;
+    if (!rendering_) {
+      return;
+    }
+    ApplyView();
+    for (auto &tile : tiles_) {
+      // mpv wants update() after every update callback
+      if (mpv_render_context_update(tile->render) & MPV_RENDER_UPDATE_FRAME) {
+        tile->frame_due = true;
+        frame_due_ = true;
+      }
+    }
+    OnGetFrame(0);
+  }
+
+  void ApplyView() {
+    ViewState state = view_state_.load();
+    if (state == view_) {
+      return;
+    }
+    view_ = state;
+    // the last frame has to be drawn again at the new size
+    frame_due_ = true;
+    if (!state.width) {
+      return;
+    }
+    if (presenter_) {
+      ResizeSoftware();
+    } else if (!viewWidth_) {
+      ResizeBuffers();
+    } else {
+      resize_at_ = Now() + kResizeSettle;
+      if (!resize_posted_) {
+        resize_posted_ = true;
+        render_loop_.PostWork(
+            callback_factory_.NewCallback(&MPVInstance::ResizeDue),
+            static_cast<int64_t>(kResizeSettle * 1000));
+      }
+    }
+  }
+
+  // Window drags, fullscreen and relayouts change the size every frame.
+  // Meanwhile frames go to the old GL buffers, which the browser stretches
+  // over the view, and the buffers are sized once the view has kept its
+  // size for kResizeSettle.
+  void ResizeDue(int32_t) {
+    resize_posted_ = false;
+    if (!rendering_ || !view_.width) {
+      // shown again, the view is applied anew
+      return;
+    }
+    PP_TimeTicks left = resize_at_ - Now();
+    if (left > 0) {
+      resize_posted_ = true;
+      render_loop_.PostWork(
+          callback_factory_.NewCallback(&MPVInstance::ResizeDue),
+          static_cast<int64_t>(ceil(left * 1000)));
+      return;
+    }
+    ResizeBuffers();
+    OnGetFrame(0);
+  }
+
+  void ResizeBuffers() {
+    if (view_.width == viewWidth_ && view_.height == viewHeight_) {
+      return;
+    }
+    context_.ResizeBuffers(view_.width, view_.height);
+    viewWidth_ = view_.width;
+    viewHeight_ = view_.height;
+    metrics_.resizes.Add();
+    frame_due_ = true;
+  }
+
+  // The presenter allocates in steps and only paints the view's part, so
+  // this is cheap enough for every view change. With dynamic resolution
+  // the image is smaller and the browser stretches it.
+  void ResizeSoftware() {
+    int32_t width = view_scale_.Scaled(view_.width);
+    int32_t height = view_scale_.Scaled(view_.height);
+    presenter_->Resize(width, height, view_.scale * view_scale_.scale());
+    if (width != viewWidth_ || height != viewHeight_) {
+      metrics_.resizes.Add();
+    }
+    viewWidth_ = width;
+    viewHeight_ = height;
+  }
+
+  void ApplyResolution(int32_t, const ResolutionConfig& config) {
+    double share = presenter_ ? config.budget : config.budget / tiles_.size();
+    for (auto &tile : tiles_) {
+      tile->scale.Configure(share, config.min_scale);
+    }
+    view_scale_.Configure(config.budget, config.min_scale);
+    if (presenter_ && view_.width) {
+      ResizeSoftware();
+    }
+    frame_due_ = true;
+    OnGetFrame(0);
+  }
+
+  // Only rectangles change; players and their decoders stay as they are.
+  void ApplyLayout(int32_t, const std::vector<TileRect>& layout) {
+    for (size_t i = 0; i < tiles_.size() && i < layout.size(); i++) {
+      tiles_[i]->rect = layout[i];
+    }
+    frame_due_ = true;
+    OnGetFrame(0);
+  }
+
+  // The tile's part of the view in pixels, clipped to the view.
+  PixelRect AreaOf(const Tile& tile) const {
+    auto to_pixels = [](float v, int32_t size) {
+      return std::max(0, std::min(static_cast<int32_t>(lroundf(v * size)), size));
+    };
+    int32_t left = to_pixels(tile.rect.x, viewWidth_);
+    int32_t top = to_pixels(tile.rect.y, viewHeight_);
+    int32_t right = to_pixels(tile.rect.x + tile.rect.w, viewWidth_);
+    int32_t bottom = to_pixels(tile.rect.y + tile.rect.h, viewHeight_);
+    return {left, top, std::max(0, right - left), std::max(0, bottom - top)};
+  }
+
+  // Renders only when mpv has a new frame or the view changed. The swap
+  // paces rendering to vsync; a frame that comes due meanwhile is picked
+  // up by PaintFinished.
+  void OnGetFrame(int32_t) {
+    if (!frame_due_ || !rendering_) {
+      return;
+    }
+    if (is_painting_) {
+      metrics_.deferred.Add();
+      return;
+    }
+
+    frame_due_ = false;
+    if (!view_.width) {
+      metrics_.hidden.Add();
+      // hidden or zero size: let mpv drop the frames so playback keeps time
+      for (auto &tile : tiles_) {
+        SkipFrame(tile.get());
+      }
+      return;
+    }
+
+    is_painting_ = true;
+    Render();
+  }
+
+  void Render() {
+    ScopedSpan span(&metrics_.render, &trace_, "render", Trace::THREAD_RENDER);
+    if (presenter_) {
+      RenderSoftware();
+      return;
+    }
+
+    glSetCurrentContextPPAPI(context_.pp_resource());
+
+    if (compositor_) {
+      RenderTiles();
+    } else if (tiles_[0]->scale.scale() < 1) {
+      RenderScaled(tiles_[0].get());
+    } else {
+      tile_compositor_.Release(&tiles_[0]->surface);
+      RenderGL(tiles_[0].get(), 0, viewWidth_, viewHeight_, true);
+      if (GrabDue(tiles_[0].get())) {
+        GrabFrames(tiles_[0].get(), ReadPixels(viewWidth_, viewHeight_, true));
+      }
+    }
+
+    SwapBuffers();
+  }
+
+  // A single player under dynamic resolution draws into a smaller surface,
+  // which is stretched over the view.
+  void RenderScaled(Tile* tile) {
+    tile_compositor_.Prepare(&tile->surface, tile->scale.Scaled(viewWidth_),
+                             tile->scale.Scaled(viewHeight_));
+    RenderGL(tile, tile->surface.framebuffer, tile->surface.width,
+             tile->surface.height, false);
+    tile_compositor_.Begin(viewWidth_, viewHeight_);
+    tile_compositor_.Draw(tile->surface, 0, 0, viewWidth_, viewHeight_);
+    if (GrabDue(tile)) {
+      GrabFrames(tile, ReadPixels(viewWidth_, viewHeight_, true));
+    }
+  }
+
+  // Tiles without a new frame keep their surface and are only drawn.
+  void RenderTiles() {
+    for (auto &tile : tiles_) {
+      PixelRect area = AreaOf(*tile);
+      if (area.empty()) {
+        SkipFrame(tile.get());
+        tile_compositor_.Release(&tile->surface);
+        continue;
+      }
+      const TileCompositor::Surface& surface = tile->surface;
+      bool fresh = tile_compositor_.Prepare(&tile->surface,
+                                            tile->scale.Scaled(area.width),
+                                            tile->scale.Scaled(area.height));
+      if (!fresh && !tile->frame_due) {
+        tile->reused.Add();
+      } else {
+        RenderGL(tile.get(), surface.framebuffer, surface.width, surface.height, false);
+        if (GrabDue(tile.get())) {
+          // mpv drew it unflipped, rows come back top first
+          glBindFramebuffer(GL_FRAMEBUFFER, surface.framebuffer);
+          GrabFrames(tile.get(), ReadPixels(surface.width, surface.height, false));
+        }
+      }
+    }
+
+    tile_compositor_.Begin(viewWidth_, viewHeight_);
+    for (auto &tile : tiles_) {
+      PixelRect area = AreaOf(*tile);
+      if (!area.empty()) {
+        tile_compositor_.Draw(tile->surface, area.x, area.y, area.width, area.height);
+      }
+    }
+  }
+
+  void RenderGL(Tile* tile, GLuint framebuffer, int width, int height, bool flip) {
+    mpv_opengl_fbo mpfbo{static_cast<int>(framebuffer), width, height, 0};
+    int flip_y{flip ? 1 : 0};
+    // no waiting for the frame's target time, the swap already blocks for
+    // vsync
+    int block_for_target{0};
+    mpv_render_param params[] = {
+        {MPV_RENDER_PARAM_OPENGL_FBO, &mpfbo},
+        {MPV_RENDER_PARAM_FLIP_Y, &flip_y},
+        {MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &block_for_target},
+        {MPV_RENDER_PARAM_INVALID, nullptr}
+    };
+
+    if (tile->render) {
+      ScopedSpan span(&tile->render_time, &trace_, "render tile",
+                      Trace::THREAD_RENDER, tile->index);
+      mpv_render_context_render(tile->render, params);
+      tile->drawn.Add();
+      // the next frame comes at the new size
+      tile->scale.Add(span.elapsed());
+    }
+    tile->frame_due = false;
+  }
+
+  // Every tile renders straight into its part of the one image. Pooled
+  // images hold older frames, so all tiles are drawn every time.
+  void RenderSoftware() {
+    SoftwarePresenter::Target target;
+    if (!presenter_->Acquire(&target)) {
+      is_painting_ = false;
+      return;
+    }
+
+    if (compositor_) {
+      // gaps between tiles; mpv leaves the padding byte alone
+      for (int32_t y = 0; y < viewHeight_; y++) {
+        auto row = reinterpret_cast<uint32_t*>(
+            static_cast<uint8_t*>(target.pixels) + y * target.stride);
+        std::fill(row, row + viewWidth_, 0xff000000);
+      }
+    }
+
+    int block_for_target{0};
+    Trace::Clock::time_point begin = Trace::Clock::now();
+    for (auto &tile : tiles_) {
+      PixelRect area = AreaOf(*tile);
+      if (area.empty()) {
+        SkipFrame(tile.get());
+        continue;
+      }
+
+      int size[2] = {area.width, area.height};
+      void* pixels = static_cast<uint8_t*>(target.pixels) +
+                     area.y * target.stride + area.x * 4;
+      mpv_render_param params[] = {
+          {MPV_RENDER_PARAM_SW_SIZE, size},
+          {MPV_RENDER_PARAM_SW_FORMAT, const_cast<char *>(presenter_->format())},
+          {MPV_RENDER_PARAM_SW_STRIDE, &target.stride},
+          {MPV_RENDER_PARAM_SW_POINTER, pixels},
+          {MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &block_for_target},
+          {MPV_RENDER_PARAM_INVALID, nullptr}
+      };
+
+      {
+        ScopedSpan span(&tile->render_time, &trace_, "render tile",
+                        Trace::THREAD_RENDER, tile->index);
+        mpv_render_context_render(tile->render, params);
+      }
+      tile->drawn.Add();
+      tile->frame_due = false;
+      if (GrabDue(tile.get())) {
+        bool bgr = !strcmp(presenter_->format(), "bgr0");
+        GrabFrames(tile.get(), {static_cast<const uint8_t*>(pixels), area.width,
+                                area.height, target.stride, bgr, false});
+      }
+    }
+
+    swap_issued_ = Trace::Clock::now();
+    presenter_->Present(callback_factory_.NewCallback(&MPVInstance::PaintFinished));
+    // one image for all tiles, scaled as a whole
+    if (view_scale_.Add(std::chrono::duration<double>(swap_issued_ - begin).count())) {
+      ResizeSoftware();
+    }
+  }
+
+  // Counts a drawn frame for the tile's grabs; true if any wants it.
+  bool GrabDue(Tile* tile) {
+    bool due = false;
+    for (auto &grab : grabs_) {
+      if (grab.request.tile != tile->index) {
+        continue;
+      }
+      grab.frames++;
+      int32_t every = grab.request.every;
+      if (!grab.buffers.empty() && (!every || grab.frames % every == 0)) {
+        grab.due = true;
+        due = true;
+      }
+    }
+    for (auto &shot : shots_) {
+      if (shot.request.frame.tile != tile->index) {
+        continue;
+      }
+      shot.frames++;
+      int32_t every = shot.request.frame.every;
+      if (!every || shot.frames % every == 0) {
+        shot.due = true;
+        due = true;
+      }
+    }
+    return due;
+  }
+
+  // The bound framebuffer, read back into readback_.
+  FrameSource ReadPixels(int32_t width, int32_t height, bool flip) {
+    readback_.resize(static_cast<size_t>(width) * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, readback_.data());
+    return {readback_.data(), width, height, static_cast<size_t>(width) * 4,
+            false, flip};
+  }
+
+  // Straight into the page's ArrayBuffers, no copy in between.
+  void GrabFrames(Tile* tile, const FrameSource& source) {
+    for (auto it = grabs_.begin(); it != grabs_.end();) {
+      if (it->request.tile != tile->index || !it->due) {
+        ++it;
+        continue;
+      }
+      it->due = false;
+      GrabBuffer buffer = it->buffers.back();
+      it->buffers.pop_back();
+      const GrabRequest& request = buffer.request;
+      convert_frame(source.pixels, source.width, source.height, source.stride,
+                    source.bgr, source.flip, request.format, request.width,
+                    request.height, buffer.pixels);
+      CallOnMainThread(0, &MPVInstance::FrameGrabbed,
+                       static_cast<int32_t>(buffer.slot));
+
+      if (!request.every && it->buffers.empty()) {
+        it = grabs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    for (auto it = shots_.begin(); it != shots_.end();) {
+      if (it->request.frame.tile != tile->index || !it->due) {
+        ++it;
+        continue;
+      }
+      it->due = false;
+      // drop rather than wait for the workers; a single shot tries the
+      // next frame
+      if (!screenshot_encoder_->HasRoom()) {
+        it->dropped++;
+        ++it;
+        continue;
+      }
+      const GrabRequest& request = it->request.frame;
+      ScreenshotEncoder::Job job{request.id, request.width, request.height,
+                                 screenshot_encoder_->TakeBuffer(), "",
+                                 it->dropped};
+      job.pixels.resize(static_cast<size_t>(request.width) * request.height * 4);
+      convert_frame(source.pixels, source.width, source.height, source.stride,
+                    source.bgr, source.flip, FRAME_RGBA, request.width,
+                    request.height, job.pixels.data());
+      if (!it->request.prefix.empty()) {
+        char number[16];
+        snprintf(number, sizeof(number), "%04u.png", it->taken);
+        job.path = it->request.prefix + number;
+      }
+      it->taken++;
+      screenshot_encoder_->Submit(std::move(job));
+
+      if (!request.every) {
+        it = shots_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void SkipFrame(Tile* tile) {
+    if (!tile->render || !tile->frame_due)
+      return;
+
+    int skip{1};
+    int block_for_target{0};
+    mpv_render_param params[] = {
+        {MPV_RENDER_PARAM_SKIP_RENDERING, &skip},
+        {MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &block_for_target},
+        {MPV_RENDER_PARAM_INVALID, nullptr}
+    };
+
+    if (!presenter_)
+      glSetCurrentContextPPAPI(context_.pp_resource());
+    mpv_render_context_render(tile->render, params);
+    tile->skipped.Add();
+    tile->frame_due = false;
+  }
+
+  void SwapBuffers() {
+    swap_issued_ = Trace::Clock::now();
+    context_.SwapBuffers(
+        callback_factory_.NewCallback(&MPVInstance::PaintFinished));
+  }
+
+  void PaintFinished(int32_t) {
+    Trace::Clock::time_point now = Trace::Clock::now();
+    metrics_.swap.Add(std::chrono::duration<double>(now - swap_issued_).count());
+    if (trace_.enabled()) {
+      trace_.Add("swap", Trace::THREAD_RENDER, -1, swap_issued_, now);
+    }
+    if (last_paint_ != Trace::Clock::time_point()) {
+      metrics_.frame_interval.Add(
+          std::chrono::duration<double>(now - last_paint_).count());
+    }
+    last_paint_ = now;
+    metrics_.frames.Add();
+
+    // lets mpv measure the real display rate for display-resample and
+    // interpolation
+    for (auto &tile : tiles_) {
+      if (tile->render)
+        mpv_render_context_report_swap(tile->render);
+    }
+
+    is_painting_ = false;
+    OnGetFrame(0);
+  }
+
+  void ResetRenderMetrics(int32_t) {
+    metrics_.render.Reset();
+    metrics_.swap.Reset();
+    metrics_.frame_interval.Reset();
+    metrics_.frames.Reset();
+    metrics_.deferred.Reset();
+    metrics_.hidden.Reset();
+    metrics_.resizes.Reset();
+    last_paint_ = Trace::Clock::time_point();
+    for (auto &tile : tiles_) {
+      tile->render_time.Reset();
+      tile->drawn.Reset();
+      tile->reused.Reset();
+      tile->skipped.Reset();
+    }
+  }
+
+  template <typename Method>
+  void CallOnMainThread(int32_t delay_in_milliseconds,
+                        Method method,
+                        int32_t result = 0) {
+    pp::Module::Get()->core()->CallOnMainThread(delay_in_milliseconds, 
+        callback_factory_.NewCallback(method), result);
+  }
+
+private:
+  PlayerPool* pool_;  // owned by the module
+  JsStreams* streams_;  // owned by the module
+  QualityGovernor* governor_;  // owned by the module
+  CacheBudget* cache_budget_;  // owned by the module
+  // jsstream:// streams this instance pushed to, by name
+  std::unordered_map<std::string, std::shared_ptr<JsStream>> js_streams_;
+  pp::CompletionCallbackFactory<MPVInstance> callback_factory_;
+
+  NodeArena node_arena_;
+
+  pp::Graphics3D context_;
+  // software rendering, instead of context_
+  std::unique_ptr<SoftwarePresenter> presenter_;
+
+  bool compositor_{false};
+  std::vector<std::unique_ptr<Tile>> tiles_;
+  TileCompositor tile_compositor_;
+
+  // seek-bar previews, created on the first request
+  std::unique_ptr<Thumbnailer> thumbnailer_;
+
+  // grab_frame, main thread
+  std::vector<GrabRequest> grab_streams_;
+  std::unordered_map<uint32_t, GrabSlot> grab_slots_;  // lent out
+  std::vector<pp::VarArrayBuffer> grab_buffers_;  // free
+  uint32_t next_grab_slot_{0};
+  uint32_t shot_sequence_{0};  // saved screenshot requests, main thread
+
+  // configure {adaptive_quality}: drop counts and setting replies
+  static constexpr uint64_t kQualityReply = 1ull << 41;
+  // the cache budget's reads and limits
+  static constexpr uint64_t kCacheReply = 1ull << 42;
+  bool focused_{false};
+
+  // native input, configure {input}
+  static constexpr uint64_t kInputReply = 1ull << 40;
+  static constexpr int32_t kInputInterval = 16;  // ms between flushes
+  static constexpr double kViewSettle = 0.25;  // s before observed views count again
+  NativeInput input_;
+  bool input_notify_{false};
+  uint32_t input_tile_{0};  // under the pointer, gets the keys
+  double pointer_x_{0};  // device pixels of the view
+  double pointer_y_{0};
+  bool dragging_{false};
+  double drag_x_{0};  // pixels of the dragged player
+  double drag_y_{0};
+  double wheel_ticks_{0};
+  bool input_flush_posted_{false};
+  PP_TimeTicks last_input_flush_{0};
+
+  // scrcpy control connection, while a scrcpy stream is shown
+  std::unique_ptr<ScrcpyControl> scrcpy_;
+  uint64_t scrcpy_connect_id_{0};  // the connect not answered yet
+
+  LogBuffer log_;
+  bool log_notify_{false};
+  bool log_ready_posted_{false};
+
+  // screenshot, created on the first request; used by the render thread
+  std::unique_ptr<ScreenshotEncoder> screenshot_encoder_;
+
+  // DidChangeView -> render thread; width 0 while hidden.
+  struct ViewState {
+    uint16_t width;
+    uint16_t height;
+    float scale;
+
+    bool operator==(const ViewState& other) const {
+      return width == other.width && height == other.height &&
+             scale == other.scale;
+    }
+  };
+
+  pp::MessageLoop render_loop_;
+  std::thread render_thread_;
+  std::atomic<ViewState> view_state_{ViewState{}};
+  std::atomic<bool> update_posted_{false};
+
+  struct PendingProperty {
+    uint64_t id;
+    std::string name;
+    size_t index;
+  };
+
+  bool batch_events_{false};
+  bool binary_events_{false};
+  EventEncoder encoder_;
+  std::vector<OutEvent> pending_events_;
+  std::vector<PendingProperty> pending_props_;
+
+  std::vector<PropertyThrottle> throttles_;
+  std::vector<std::unique_ptr<PropertyDiff>> diffs_;
+
+  Keys keys_;
+  RequestStats request_stats_[OP_COUNT];
+
+  // get_stats; each member has one writing thread
+  struct Metrics {
+    // render thread
+    Histogram render;          // one Render(): due tiles drawn, swap issued
+    Histogram swap;            // swap or present issued until PaintFinished
+    Histogram frame_interval;  // PaintFinished to PaintFinished
+    Counter frames;
+    Counter deferred;  // frame came due while the last one was painting
+    Counter hidden;    // frames dropped while hidden
+    Counter resizes;   // buffers sized for a new view
+    // main thread
+    Histogram event_drain;    // one HandleMPVEvents()
+    Histogram event_latency;  // mpv wakeup until its events are posted
+    Counter events;
+    Depth events_per_drain;
+    Depth pending_events;  // batched mode, events in one message
+  };
+  Metrics metrics_;
+  Trace trace_;
+
+  std::vector<PendingBatch> batches_;
+  uint64_t next_batch_reply_{kBatchReplyBase};
+  PP_TimeTicks throttle_flush_at_{0};
+  uint32_t throttle_generation_{0};
+
+  // render thread only
+  bool rendering_{false};
+  bool is_painting_{false};
+  bool frame_due_{false};
+  ViewState view_{};
+  int32_t viewWidth_{0};  // of the GL buffers or the software image
   int32_t viewHeight_{0};
+  static constexpr double kResizeSettle = 0.15;  // s a new size has to hold
+  PP_TimeTicks resize_at_{0};
+  bool resize_posted_{false};
+  RenderScale view_scale_;  // software, configure {dynamic_resolution}
+  std::vector<GrabStream> grabs_;
+  std::vector<ShotStream> shots_;
+  std::vector<uint8_t> readback_;  // GL pixels for grabs
+  Trace::Clock::time_point swap_issued_;
+  Trace::Clock::time_point last_paint_;
+};
+
+const MPVInstance::RequestHandler MPVInstance::kRequestHandlers[] = {
+  {nullptr, nullptr},
+  {"command", &MPVInstance::HandleCommand},
+  {"set_property", &MPVInstance::HandleSetProperty},
+  {"observe_property", &MPVInstance::HandleObserveProperty},
+  {"unobserve_property", &MPVInstance::HandleUnobserveProperty},
+  {"get_property_async", &MPVInstance::HandleGetProperty},
+  {"resync_property", &MPVInstance::HandleResyncProperty},
+  {"hook_continue", &MPVInstance::HandleHookContinue},
+  {"hook_add", &MPVInstance::HandleHookAdd},
+  {"set_option", &MPVInstance::HandleSetOption},
+  {"configure", &MPVInstance::HandleConfigure},
+  {"batch", &MPVInstance::RunBatch},
+  {"get_request_stats", &MPVInstance::HandleGetRequestStats},
+  {"set_layout", &MPVInstance::HandleSetLayout},
+  {"thumbnail", &MPVInstance::HandleThumbnail},
+  {"grab_frame", &MPVInstance::HandleGrabFrame},
+  {"screenshot", &MPVInstance::HandleScreenshot},
+  {"stream_push", &MPVInstance::HandleStreamPush},
+  {"scrcpy", &MPVInstance::HandleScrcpy},
+  {"get_stats", &MPVInstance::HandleGetStats},
+  {"log", &MPVInstance::HandleLog},
 };
 
 class MPVModule : public pp::Module {
  public:
-  MPVModule() : pp::Module() {}
+  MPVModule() : pp::Module(), pool_(PoolSize()), cache_budget_(CacheBudgetTotal()) {}
   virtual ~MPVModule() {}
 
   virtual pp::Instance* CreateInstance(PP_Instance instance) {
-    return new MPVInstance(instance);
+    return new MPVInstance(instance, &pool_, &streams_, &governor_,
+                           &cache_budget_);
+  }
+
+ private:
+  // MPVJS_POOL=N keeps N idle players ready, 0 turns the pool off.
+  static size_t PoolSize() {
+    char* size = getenv("MPVJS_POOL");
+    return size && strlen(size) ? static_cast<size_t>(atoi(size)) : 2;
+  }
+
+  // MPVJS_CACHE_MB=N caps the demuxer caches of all players together at
+  // N MiB, 0 lifts the cap; pages can change it with configure.
+  static int64_t CacheBudgetTotal() {
+    char* total = getenv("MPVJS_CACHE_MB");
+    return total && strlen(total) ? static_cast<int64_t>(atoll(total)) << 20
+                                  : CacheBudget::kDefaultTotal;
   }
+
+  // declared first, it outlives the pooled players reading from it
+  JsStreams streams_;
+  PlayerPool pool_;
+  QualityGovernor governor_;
+  CacheBudget cache_budget_;
 };
 
 namespace pp {
@@ -0,0 +1,278 @@
+#include "player_pool.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// reply id of the pool's own idle-active observer
+constexpr uint64_t kIdleReply = ~0ull;
+
+// how long a reset may wait for playback to stop, seconds
+constexpr double kStopTimeout = 1.0;
+
+// Player state that commands and key bindings change as much as property
+// writes do (cycle mute, add speed, vf toggle), so it may not be touched.
+// Reset() puts it back to mpv's defaults.
+const char* const kPlayerState[] = {
+    "pause", "mute", "volume", "speed", "loop-file", "loop-playlist",
+    "ab-loop-a", "ab-loop-b", "af", "vf", "video-zoom", "video-pan-x",
+    "video-pan-y", "video-rotate", "video-aspect-override", "panscan",
+    "audio-delay", "sub-delay", "sub-visibility", "brightness", "contrast",
+    "saturation", "gamma", "hue", "deinterlace",
+};
+
+// Sets option |name| to mpv's default for it; false if there is no such
+// option.
+bool ResetOption(mpv_handle* mpv, const std::string& name) {
+  std::string info = "option-info/" + name + "/default-value";
+  mpv_node value;
+  if (mpv_get_property(mpv, info.c_str(), MPV_FORMAT_NODE, &value) < 0) {
+    return false;
+  }
+  std::string option = "options/" + name;
+  mpv_set_property(mpv, option.c_str(), MPV_FORMAT_NODE, &value);
+  mpv_free_node_contents(&value);
+  return true;
+}
+
+// Reset() runs with the pool's hooks still in place; nobody else
+// continues them.
+void ContinueHook(mpv_handle* mpv, mpv_event* event) {
+  if (event->event_id == MPV_EVENT_HOOK) {
+    mpv_hook_continue(mpv, static_cast<mpv_event_hook*>(event->data)->id);
+  }
+}
+
+}  // namespace
+
+int PlayerPool::HookIndex(const std::string& name) {
+  for (size_t i = 0; i < kHookCount; i++) {
+    if (name == kHooks[i]) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+PlayerPool::PlayerPool(size_t warm)
+    : warm_(warm)
+    , max_idle_(warm * 2) {
+  // mpv needs the C locale for number parsing
+  setlocale(LC_NUMERIC, "C");
+
+  char* terminal = getenv("MPVJS_TERMINAL");
+  if (terminal && strlen(terminal))
+    options_.push_back({"terminal", "yes", true});
+  char* verbose = getenv("MPVJS_VERBOSE");
+  if (verbose && strlen(verbose))
+    options_.push_back({"msg-level", "all=v", true});
+
+  // Can't be set after initialize in mpv 0.18.
+  options_.push_back({"input-default-bindings", "yes", true});
+  options_.push_back({"idle", "yes", true});
+#if defined(MPV_PEPPER_HEADLESS)
+  options_.push_back({"ao", "null", true});
+#endif
+
+  // Some convenient defaults. Can be always changed on ready event.
+  options_.push_back({"stop-playback-on-init-failure", "no", false});
+  options_.push_back({"audio-file-auto", "no", false});
+  options_.push_back({"sub-auto", "no", false});
+  options_.push_back({"volume-max", "100", false});
+  options_.push_back({"keep-open", "no", false});
+  options_.push_back({"keep-open-pause", "no", false});
+  options_.push_back({"osd-bar", "no", false});
+  options_.push_back({"reset-on-next-file", "pause", false});
+  options_.push_back({"force-window", "immediate", false});
+
+  worker_ = std::thread(&PlayerPool::Run, this);
+}
+
+PlayerPool::~PlayerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+
+  for (mpv_handle* mpv : idle_) {
+    mpv_terminate_destroy(mpv);
+  }
+  for (const Returned& returned : returned_) {
+    mpv_terminate_destroy(returned.mpv);
+  }
+}
+
+mpv_handle* PlayerPool::Lease() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!idle_.empty()) {
+      mpv_handle* mpv = idle_.back();
+      idle_.pop_back();
+      wake_.notify_one();
+      return mpv;
+    }
+  }
+  return Create();
+}
+
+void PlayerPool::Release(mpv_handle* mpv,
+                         std::vector<uint64_t> observed,
+                         Touched touched,
+                         bool reusable) {
+  if (!mpv) {
+    return;
+  }
+  // events must not reach the instance that is going away
+  mpv_set_wakeup_callback(mpv, nullptr, nullptr);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    returned_.push_back(
+        {mpv, std::move(observed), std::move(touched), reusable});
+  }
+  wake_.notify_one();
+}
+
+PlayerPool::Counts PlayerPool::counts() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {idle_.size(), reused_, destroyed_};
+}
+
+mpv_handle* PlayerPool::Create() {
+  mpv_handle* mpv = mpv_create();
+  if (!mpv) {
+    fprintf(stderr, "context init failed\n");
+    return nullptr;
+  }
+
+  for (const Option& option : options_) {
+    if (option.early) {
+      mpv_set_option_string(mpv, option.name.c_str(), option.value.c_str());
+    }
+  }
+
+  if (mpv_initialize(mpv) < 0) {
+    fprintf(stderr, "mpv init failed\n");
+    mpv_terminate_destroy(mpv);
+    return nullptr;
+  }
+
+  for (const Option& option : options_) {
+    if (!option.early) {
+      mpv_set_option_string(mpv, option.name.c_str(), option.value.c_str());
+    }
+  }
+  for (size_t i = 0; i < kHookCount; i++) {
+    mpv_hook_add(mpv, kHookReply | i, kHooks[i], 0);
+  }
+  return mpv;
+}
+
+// Back to the state Create() left it in: nothing playing, no observers,
+// no pending replies or events, kPlayerState and everything the player
+// touched at mpv's defaults, and the pool's options applied over them.
+bool PlayerPool::Reset(const Returned& returned) {
+  mpv_handle* mpv = returned.mpv;
+  if (!returned.reusable) {
+    return false;
+  }
+
+  mpv_request_log_messages(mpv, "no");
+  for (uint64_t id : returned.observed) {
+    mpv_unobserve_property(mpv, id);
+  }
+
+  const char* stop[] = {"stop", nullptr};
+  if (mpv_command(mpv, stop) < 0) {
+    return false;
+  }
+  // replies to the old player's requests come before anything below
+  mpv_wait_async_requests(mpv);
+
+  for (const char* name : kPlayerState) {
+    ResetOption(mpv, name);
+  }
+  // read here rather than saved when the player set them, which would be
+  // a round trip to the core on the main thread per write
+  for (const std::string& name : returned.touched) {
+    ResetOption(mpv, name);
+  }
+  // the ones above may include the pool's own
+  for (const Option& option : options_) {
+    mpv_set_property_string(mpv, ("options/" + option.name).c_str(),
+                            option.value.c_str());
+  }
+
+  // stop is done once the core is idle again; its end-file and friends
+  // are drained with everything else
+  mpv_observe_property(mpv, kIdleReply, "idle-active", MPV_FORMAT_FLAG);
+  bool idle = false;
+  int64_t deadline = mpv_get_time_us(mpv) + static_cast<int64_t>(kStopTimeout * 1e6);
+  while (!idle) {
+    double left = (deadline - mpv_get_time_us(mpv)) / 1e6;
+    if (left <= 0) {
+      break;
+    }
+    mpv_event* event = mpv_wait_event(mpv, left);
+    ContinueHook(mpv, event);
+    if (event->event_id == MPV_EVENT_PROPERTY_CHANGE &&
+        event->reply_userdata == kIdleReply) {
+      mpv_event_property* prop = static_cast<mpv_event_property*>(event->data);
+      idle = prop->format == MPV_FORMAT_FLAG && *static_cast<int*>(prop->data);
+    }
+  }
+  mpv_unobserve_property(mpv, kIdleReply);
+  for (mpv_event* event = mpv_wait_event(mpv, 0);
+       event->event_id != MPV_EVENT_NONE; event = mpv_wait_event(mpv, 0)) {
+    ContinueHook(mpv, event);
+  }
+  return idle;
+}
+
+// Worker thread: resets returned handles, then tops the pool up to warm_.
+void PlayerPool::Run() {
+  bool warming = warm_ > 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this, warming] {
+      return quit_ || !returned_.empty() || (warming && idle_.size() < warm_);
+    });
+    if (quit_) {
+      break;
+    }
+
+    if (!returned_.empty()) {
+      Returned returned = std::move(returned_.front());
+      returned_.pop_front();
+      bool keep = idle_.size() < max_idle_;
+      lock.unlock();
+      keep = keep && Reset(returned);
+      if (!keep) {
+        mpv_terminate_destroy(returned.mpv);
+      }
+      lock.lock();
+      if (keep) {
+        idle_.push_back(returned.mpv);
+        reused_++;
+      } else {
+        destroyed_++;
+      }
+      continue;
+    }
+
+    lock.unlock();
+    mpv_handle* mpv = Create();
+    lock.lock();
+    if (mpv) {
+      idle_.push_back(mpv);
+    } else {
+      // leave the errors to Lease()
+      warming = false;
+    }
+  }
+}
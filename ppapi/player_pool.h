@@ -0,0 +1,100 @@
+#pragma once
+
+#include "client.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Initialized mpv handles shared by all instances of the module.
+//
+// mpv_create() plus mpv_initialize() cost tens of milliseconds, paid on
+// the main thread whenever an element is created. The pool keeps a few
+// handles created ahead of time with the plugin's default options, on a
+// worker thread, so Lease() usually just pops one. Released handles are
+// stopped and reset on the same thread and kept for the next instance.
+//
+// Render contexts are not pooled: they belong to the instance's Graphics3D
+// and render thread, and must be freed before Release().
+class PlayerPool {
+ public:
+  // Options and properties a player set, without the "options/" prefix.
+  // Reset() puts each back to mpv's default, then the pool's options.
+  using Touched = std::unordered_set<std::string>;
+
+  // Hooks every handle gets on creation, as hooks can't be removed: a
+  // player that wants one of these routes its events instead of adding it
+  // again, which would keep the handle from being reused. The events come
+  // with reply id kHookReply | index in kHooks and must be continued.
+  static constexpr const char* kHooks[] = {"on_load_fail"};
+  static constexpr size_t kHookCount = sizeof(kHooks) / sizeof(kHooks[0]);
+  static constexpr uint64_t kHookReply = 1ull << 44;
+
+  // Index of |name| in kHooks, or -1.
+  static int HookIndex(const std::string& name);
+
+  struct Counts {
+    size_t idle;
+    size_t reused;     // released handles reset and kept
+    size_t destroyed;  // released handles that couldn't be
+  };
+
+  // Keeps |warm| idle handles ready; 0 creates every handle on Lease().
+  explicit PlayerPool(size_t warm);
+  ~PlayerPool();
+
+  PlayerPool(const PlayerPool &) = delete;
+  PlayerPool &operator=(const PlayerPool &) = delete;
+
+  // An initialized handle without wakeup callback, or null if mpv failed.
+  mpv_handle* Lease();
+
+  // Takes back a leased handle. |observed| are the reply ids the player
+  // observes properties with, |touched| the settings it changed. A handle
+  // that can't be reset (it has hooks other than kHooks) is destroyed
+  // instead.
+  void Release(mpv_handle* mpv,
+               std::vector<uint64_t> observed,
+               Touched touched,
+               bool reusable);
+
+  Counts counts();
+
+ private:
+  struct Returned {
+    mpv_handle* mpv;
+    std::vector<uint64_t> observed;
+    Touched touched;
+    bool reusable;
+  };
+
+  // an option the pool sets on every handle
+  struct Option {
+    std::string name;
+    std::string value;
+    bool early;  // before mpv_initialize()
+  };
+
+  mpv_handle* Create();
+  bool Reset(const Returned& returned);
+
+  void Run();
+
+  const size_t warm_;
+  // returned handles beyond this are destroyed
+  const size_t max_idle_;
+  std::vector<Option> options_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<mpv_handle*> idle_;
+  std::deque<Returned> returned_;
+  size_t reused_{0};
+  size_t destroyed_{0};
+  bool quit_{false};
+  std::thread worker_;
+};
@@ -0,0 +1,175 @@
+#include "property_diff.h"
+
+#include <string.h>
+
+static bool node_equal(const mpv_node *a, const mpv_node *b) {
+  if (a->format != b->format) {
+    return false;
+  }
+
+  switch (a->format) {
+    case MPV_FORMAT_STRING:
+      return strcmp(a->u.string, b->u.string) == 0;
+    case MPV_FORMAT_FLAG:
+      return a->u.flag == b->u.flag;
+    case MPV_FORMAT_INT64:
+      return a->u.int64 == b->u.int64;
+    case MPV_FORMAT_DOUBLE:
+      return a->u.double_ == b->u.double_;
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+      const mpv_node_list *la = a->u.list;
+      const mpv_node_list *lb = b->u.list;
+      if (la->num != lb->num) {
+        return false;
+      }
+      for (int i = 0; i < la->num; i++) {
+        if (a->format == MPV_FORMAT_NODE_MAP && strcmp(la->keys[i], lb->keys[i]) != 0) {
+          return false;
+        }
+        if (!node_equal(&la->values[i], &lb->values[i])) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case MPV_FORMAT_BYTE_ARRAY:
+      return a->u.ba->size == b->u.ba->size &&
+          memcmp(a->u.ba->data, b->u.ba->data, a->u.ba->size) == 0;
+    default:
+      return true;
+  }
+}
+
+static const mpv_node *map_find(const mpv_node *map, const char *key) {
+  const mpv_node_list *list = map->u.list;
+  for (int i = 0; i < list->num; i++) {
+    if (strcmp(list->keys[i], key) == 0) {
+      return &list->values[i];
+    }
+  }
+  return nullptr;
+}
+
+static void set_int(mpv_node *node, int64_t value) {
+  node->format = MPV_FORMAT_INT64;
+  node->u.int64 = value;
+}
+
+PropertyDiff::PropertyDiff(uint64_t id, const std::string &name)
+    : id_(id), name_(name), patch_arena_(1024) {}
+
+const mpv_node *PropertyDiff::Update(const mpv_node *value, bool *is_patch) {
+  *is_patch = false;
+
+  const mpv_node *from = snapshot();
+  if (from && node_equal(from, value)) {
+    return nullptr;
+  }
+
+  int next = 1 - current_;
+  arenas_[next].Reset();
+  arenas_[next].CopyNode(value, &snapshots_[next]);
+  const mpv_node *to = &snapshots_[next];
+
+  const mpv_node *patch = nullptr;
+  patch_arena_.Reset();
+  if (from && from->format == to->format) {
+    if (to->format == MPV_FORMAT_NODE_ARRAY) {
+      patch = DiffArray(from, to);
+    } else if (to->format == MPV_FORMAT_NODE_MAP) {
+      patch = DiffMap(from, to);
+    }
+  }
+
+  current_ = next;
+  has_snapshot_ = true;
+
+  *is_patch = patch != nullptr;
+  return patch ? patch : to;
+}
+
+// Trims the common head and tail; what is left in between becomes one
+// splice. A flipped "current" flag costs the entries between the two.
+const mpv_node *PropertyDiff::DiffArray(const mpv_node *from, const mpv_node *to) {
+  const mpv_node_list *a = from->u.list;
+  const mpv_node_list *b = to->u.list;
+
+  int head = 0;
+  while (head < a->num && head < b->num &&
+         node_equal(&a->values[head], &b->values[head])) {
+    head++;
+  }
+  int tail = 0;
+  while (tail < a->num - head && tail < b->num - head &&
+         node_equal(&a->values[a->num - 1 - tail], &b->values[b->num - 1 - tail])) {
+    tail++;
+  }
+
+  int remove = a->num - head - tail;
+  int insert = b->num - head - tail;
+  if (insert * 2 > b->num) {
+    return nullptr;
+  }
+
+  mpv_node *fields = patch_arena_.NewList(&patch_, MPV_FORMAT_NODE_MAP, 3);
+  char **keys = patch_.u.list->keys;
+  keys[0] = const_cast<char *>("at");
+  set_int(&fields[0], head);
+  keys[1] = const_cast<char *>("remove");
+  set_int(&fields[1], remove);
+  keys[2] = const_cast<char *>("insert");
+  mpv_node *items = patch_arena_.NewList(&fields[2], MPV_FORMAT_NODE_ARRAY, insert);
+  for (int i = 0; i < insert; i++) {
+    // shallow: the new snapshot outlives the patch
+    items[i] = b->values[head + i];
+  }
+  return &patch_;
+}
+
+const mpv_node *PropertyDiff::DiffMap(const mpv_node *from, const mpv_node *to) {
+  const mpv_node_list *a = from->u.list;
+  const mpv_node_list *b = to->u.list;
+
+  int set = 0;
+  for (int i = 0; i < b->num; i++) {
+    const mpv_node *old = map_find(from, b->keys[i]);
+    if (!old || !node_equal(old, &b->values[i])) {
+      set++;
+    }
+  }
+  int del = 0;
+  for (int i = 0; i < a->num; i++) {
+    if (!map_find(to, a->keys[i])) {
+      del++;
+    }
+  }
+  if (set * 2 > b->num) {
+    return nullptr;
+  }
+
+  mpv_node *fields = patch_arena_.NewList(&patch_, MPV_FORMAT_NODE_MAP, 2);
+  char **keys = patch_.u.list->keys;
+  keys[0] = const_cast<char *>("set");
+  keys[1] = const_cast<char *>("del");
+
+  mpv_node *set_values = patch_arena_.NewList(&fields[0], MPV_FORMAT_NODE_MAP, set);
+  int n = 0;
+  for (int i = 0; i < b->num; i++) {
+    const mpv_node *old = map_find(from, b->keys[i]);
+    if (!old || !node_equal(old, &b->values[i])) {
+      fields[0].u.list->keys[n] = b->keys[i];
+      set_values[n++] = b->values[i];
+    }
+  }
+
+  mpv_node *del_keys = patch_arena_.NewList(&fields[1], MPV_FORMAT_NODE_ARRAY, del);
+  n = 0;
+  for (int i = 0; i < a->num; i++) {
+    if (!map_find(to, a->keys[i])) {
+      del_keys[n].format = MPV_FORMAT_STRING;
+      del_keys[n++].u.string = a->keys[i];
+    }
+  }
+  return &patch_;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "client.h"
+#include "node_arena.h"
+#include <stdint.h>
+#include <string>
+
+// Keeps the last delivered value of a structured property (playlist,
+// track-list, metadata) and turns the next one into a patch against it:
+//   array: {at, remove, insert}  one splice covering every changed entry
+//   map:   {set, del}            changed or new keys, removed keys
+// A full value is sent for the first change, on a type change and when
+// the patch would not be much smaller than the value.
+class PropertyDiff {
+ public:
+  PropertyDiff(uint64_t id, const std::string &name);
+
+  PropertyDiff(const PropertyDiff &) = delete;
+  PropertyDiff &operator=(const PropertyDiff &) = delete;
+
+  uint64_t id() const { return id_; }
+  const std::string &name() const { return name_; }
+
+  // Returns what to deliver for |value|, a patch if |*is_patch| is set, or
+  // nullptr if nothing changed. Valid until the next Update() or Clear().
+  const mpv_node *Update(const mpv_node *value, bool *is_patch);
+
+  // The last delivered value, or nullptr.
+  const mpv_node *snapshot() const { return has_snapshot_ ? &snapshots_[current_] : nullptr; }
+
+  void Clear() { has_snapshot_ = false; }
+
+ private:
+  const mpv_node *DiffArray(const mpv_node *from, const mpv_node *to);
+  const mpv_node *DiffMap(const mpv_node *from, const mpv_node *to);
+
+  uint64_t id_;
+  std::string name_;
+
+  // double buffered: the previous value stays alive while diffing
+  NodeArena arenas_[2];
+  mpv_node snapshots_[2];
+  int current_{0};
+  bool has_snapshot_{false};
+
+  NodeArena patch_arena_;
+  mpv_node patch_;
+};
@@ -0,0 +1,148 @@
+#include "quality_governor.h"
+
+#include <ppapi/cpp/core.h>
+#include <ppapi/cpp/module.h>
+#include <algorithm>
+
+namespace {
+
+// device pixels under which a player gets no more than a level
+const int64_t kMediumArea = 960 * 540;  // level 1
+const int64_t kSmallArea = 480 * 270;   // level 2
+
+}  // namespace
+
+QualityGovernor::QualityGovernor() : callback_factory_(this) {}
+
+void QualityGovernor::Add(Client* client, uint32_t player) {
+  if (level(client, player) >= 0) {
+    return;
+  }
+  Sample sample = client->MeasureQuality(player);
+  players_.push_back({client, player, 0, FloorFor(sample.area), 0, kHold, false, sample});
+  Apply(&players_.back());
+  Schedule();
+}
+
+void QualityGovernor::Remove(Client* client) {
+  players_.erase(std::remove_if(players_.begin(), players_.end(),
+                                [client](const Player& player) {
+                                  return player.client == client;
+                                }),
+                 players_.end());
+}
+
+int QualityGovernor::level(const Client* client, uint32_t player) const {
+  for (const Player& entry : players_) {
+    if (entry.client == client && entry.id == player) {
+      return entry.level;
+    }
+  }
+  return -1;
+}
+
+int QualityGovernor::FloorFor(int64_t area) {
+  if (area <= 0) {
+    return kLevels - 1;
+  }
+  return area < kSmallArea ? 2 : area < kMediumArea ? 1 : 0;
+}
+
+void QualityGovernor::Schedule() {
+  if (scheduled_ || players_.empty()) {
+    return;
+  }
+  scheduled_ = true;
+  pp::Module::Get()->core()->CallOnMainThread(
+      kInterval, callback_factory_.NewCallback(&QualityGovernor::Tick));
+}
+
+void QualityGovernor::Tick(int32_t) {
+  scheduled_ = false;
+
+  size_t trouble = 0;
+  for (Player& player : players_) {
+    Sample sample = player.client->MeasureQuality(player.id);
+    const Sample& last = player.last;
+    // counters start over with a new file or a stats reset
+    bool restarted = sample.dropped < last.dropped || sample.renders < last.renders;
+    uint64_t dropped = restarted ? 0 : sample.dropped - last.dropped;
+    uint64_t renders = restarted ? 0 : sample.renders - last.renders;
+    double render_time = restarted ? 0 : sample.render_time - last.render_time;
+    // hidden players are at the last level already, whatever they drop
+    player.trouble = sample.area > 0 &&
+                     (dropped > 0 || (renders && render_time / renders > sample.budget));
+    player.last = sample;
+    player.floor = FloorFor(sample.area);
+    player.held++;
+    trouble += player.trouble;
+    Apply(&player);
+  }
+
+  since_up_++;
+  if (trouble) {
+    if (up_pending_) {
+      // the last up step was too much
+      calm_needed_ = std::min(calm_needed_ * 2, kMaxCalm);
+      up_pending_ = false;
+    }
+    calm_ = 0;
+    for (size_t n = 0; n < trouble; n++) {
+      Player* target = nullptr;
+      for (Player& player : players_) {
+        // a player in trouble goes down however recently it changed,
+        // though only once an interval
+        if (player.level >= kLevels - 1 || !player.held ||
+            (player.held < kHold && !player.trouble)) {
+          continue;
+        }
+        if (!target || player.last.area < target->last.area ||
+            (player.last.area == target->last.area && player.trouble && !target->trouble)) {
+          target = &player;
+        }
+      }
+      if (!target) {
+        break;
+      }
+      Step(target, target->level + 1);
+    }
+  } else {
+    if (up_pending_ && since_up_ >= calm_needed_) {
+      calm_needed_ = std::max(calm_needed_ / 2, kCalm);
+      up_pending_ = false;
+    }
+    if (++calm_ >= calm_needed_) {
+      Player* target = nullptr;
+      for (Player& player : players_) {
+        if (player.level <= player.floor || player.held < kHold) {
+          continue;
+        }
+        if (!target || player.last.area > target->last.area) {
+          target = &player;
+        }
+      }
+      if (target) {
+        Step(target, target->level - 1);
+        calm_ = 0;
+        up_pending_ = true;
+        since_up_ = 0;
+      }
+    }
+  }
+
+  Schedule();
+}
+
+void QualityGovernor::Step(Player* player, int pressure) {
+  player->pressure = pressure;
+  player->held = 0;
+  Apply(player);
+}
+
+void QualityGovernor::Apply(Player* player) {
+  int level = std::max(player->floor, player->pressure);
+  if (level != player->level) {
+    player->level = level;
+    player->client->ApplyQuality(player->id, level);
+  }
+}
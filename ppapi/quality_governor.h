@@ -0,0 +1,91 @@
+#pragma once
+
+#include <ppapi/utility/completion_callback_factory.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Trades picture quality for decode and render time across all players of
+// the module, so a wall of more streams than the CPU can fully decode
+// degrades where it shows least instead of dropping frames everywhere.
+//
+// A player has a level, 0 for full quality up to kLevels - 1; what a level
+// changes is up to its client. Every kInterval the governor measures all
+// players:
+//   - a player's size sets a floor: small tiles never get full quality
+//   - for each player that dropped frames or went over its render budget,
+//     the least visible player not at the last level yet goes one down
+//   - after calm_needed() intervals without trouble, the largest player
+//     above its floor goes one up. Trouble within as many intervals of
+//     that doubles the calm needed, up to kMaxCalm; an up step that
+//     holds halves it again.
+// Apart from size and its own trouble, a player changes level at most
+// once per kHold intervals. Main thread only.
+class QualityGovernor {
+ public:
+  static constexpr int kLevels = 4;
+  static constexpr int32_t kInterval = 1000;  // ms
+  static constexpr uint32_t kHold = 5;        // intervals
+  static constexpr uint32_t kCalm = 5;
+  static constexpr uint32_t kMaxCalm = 80;
+
+  // Totals since the player started; the governor takes differences.
+  struct Sample {
+    int64_t area;        // device pixels shown, 0 when hidden
+    uint64_t dropped;    // frames, by the decoder or the output
+    uint64_t renders;
+    double render_time;  // s, for all those renders
+    double budget;       // s a render may take
+  };
+
+  class Client {
+   public:
+    virtual Sample MeasureQuality(uint32_t player) = 0;
+    virtual void ApplyQuality(uint32_t player, int level) = 0;
+
+   protected:
+    ~Client() = default;
+  };
+
+  QualityGovernor();
+
+  QualityGovernor(const QualityGovernor &) = delete;
+  QualityGovernor &operator=(const QualityGovernor &) = delete;
+
+  // Starts |player| of |client| at its size's floor.
+  void Add(Client* client, uint32_t player);
+  // Every player of |client|; their levels are left as they are.
+  void Remove(Client* client);
+
+  // -1 if not governed.
+  int level(const Client* client, uint32_t player) const;
+  uint32_t calm_needed() const { return calm_needed_; }
+
+ private:
+  struct Player {
+    Client* client;
+    uint32_t id;
+    int level;
+    int floor;
+    int pressure;   // level asked for by trouble, under the floor's
+    uint32_t held;  // intervals since the last pressure change
+    bool trouble;
+    Sample last;
+  };
+
+  static int FloorFor(int64_t area);
+
+  void Schedule();
+  void Tick(int32_t);
+  void Step(Player* player, int pressure);
+  void Apply(Player* player);
+
+  std::vector<Player> players_;
+  uint32_t calm_{0};             // intervals without trouble
+  bool up_pending_{false};       // an up step, not yet known to hold
+  uint32_t since_up_{0};         // intervals since it
+  uint32_t calm_needed_{kCalm};
+  bool scheduled_{false};
+
+  pp::CompletionCallbackFactory<QualityGovernor> callback_factory_;
+};
@@ -0,0 +1,59 @@
+#include "render_scale.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// weight of the newest render in the average
+const double kSmoothing = 0.1;
+// a step up must be expected to stay this far under budget
+const double kHeadroom = 0.8;
+
+}  // namespace
+
+void RenderScale::Configure(double budget, float min_scale) {
+  budget_ = std::max(budget, 0.0);
+  min_scale_ = std::min(std::max(min_scale, kStep), 1.0f);
+  SetScale(budget_ > 0 ? std::max(scale(), min_scale_) : 1.0f);
+}
+
+bool RenderScale::Add(double seconds) {
+  if (!enabled()) {
+    return false;
+  }
+  average_ = samples_ ? average_ + (seconds - average_) * kSmoothing : seconds;
+  if (++samples_ < kSettleFrames) {
+    return false;
+  }
+
+  float scale = this->scale();
+  float next = scale;
+  if (average_ > budget_) {
+    // at least a step, rounded down to one
+    float fit = scale * static_cast<float>(std::sqrt(budget_ / average_));
+    next = std::min(std::floor(fit / kStep) * kStep, scale - kStep);
+  } else if (scale < 1) {
+    float up = scale + kStep;
+    double expected = average_ * (up * up) / (scale * scale);
+    if (expected < budget_ * kHeadroom) {
+      next = up;
+    }
+  }
+  next = std::min(std::max(next, min_scale_), 1.0f);
+  if (next == scale) {
+    return false;
+  }
+  SetScale(next);
+  return true;
+}
+
+int32_t RenderScale::Scaled(int32_t size) const {
+  return std::max(1, static_cast<int32_t>(std::lround(size * scale())));
+}
+
+void RenderScale::SetScale(float scale) {
+  scale_.store(scale, std::memory_order_relaxed);
+  average_ = 0;
+  samples_ = 0;
+}
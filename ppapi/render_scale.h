@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Dynamic resolution: the fraction of its size a view or tile renders at,
+// picked from how long mpv_render_context_render() takes.
+//
+// Render time goes roughly with the pixel count, the square of the scale.
+// Over budget the scale drops far enough to fit at once; well under it
+// the scale comes back one step at a time, and only if the next step is
+// expected to stay under budget too. Every change waits kSettleFrames
+// renders, measured at the new scale, so the scale does not flap.
+// Render thread; scale() may be read from any thread.
+class RenderScale {
+ public:
+  static constexpr float kStep = 0.125f;
+  static constexpr uint32_t kSettleFrames = 30;
+
+  // |budget| seconds per render, 0 turns scaling off and back to 1.
+  void Configure(double budget, float min_scale);
+  bool enabled() const { return budget_ > 0; }
+
+  // One render at the current scale; true if the scale changed.
+  bool Add(double seconds);
+
+  float scale() const { return scale_.load(std::memory_order_relaxed); }
+
+  // |size| pixels at the current scale, at least 1.
+  int32_t Scaled(int32_t size) const;
+
+ private:
+  void SetScale(float scale);
+
+  double budget_{0};
+  float min_scale_{1};
+  std::atomic<float> scale_{1};
+  double average_{0};  // seconds, moving average at the current scale
+  uint32_t samples_{0};
+};
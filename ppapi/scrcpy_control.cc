@@ -0,0 +1,204 @@
+#include "scrcpy_control.h"
+
+#include <ppapi/cpp/core.h>
+#include <ppapi/cpp/module.h>
+#include <ppapi/cpp/net_address.h>
+#include <ppapi/cpp/var.h>
+#include <algorithm>
+
+namespace {
+
+// scrcpy ControlMessage.TYPE_INJECT_TOUCH_EVENT
+constexpr uint8_t kTypeTouch = 2;
+constexpr size_t kTouchSize = 28;
+
+constexpr size_t kReadSize = 4096;
+
+void put_u16(std::vector<uint8_t>* out, uint32_t value) {
+  out->push_back(static_cast<uint8_t>(value >> 8));
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+  put_u16(out, value >> 16);
+  put_u16(out, value);
+}
+
+}  // namespace
+
+ScrcpyControl::ScrcpyControl(const pp::InstanceHandle& instance)
+    : instance_(instance)
+    , socket_(instance)
+    , read_buffer_(kReadSize)
+    , callback_factory_(this) {}
+
+void ScrcpyControl::Connect(uint16_t port,
+                            const pp::CompletionCallback& done,
+                            const pp::CompletionCallback& closed) {
+  done_ = done;
+  closed_ = closed;
+  // port in network byte order
+  PP_NetAddress_IPv4 address{static_cast<uint16_t>(port >> 8 | port << 8),
+                             {127, 0, 0, 1}};
+  int32_t result = socket_.Connect(
+      pp::NetAddress(instance_, address),
+      callback_factory_.NewCallback(&ScrcpyControl::OnConnect));
+  if (result != PP_OK_COMPLETIONPENDING) {
+    OnConnect(result);
+  }
+}
+
+void ScrcpyControl::OnConnect(int32_t result) {
+  if (result != PP_OK) {
+    failed_ = true;
+    done_.Run(result);
+    return;
+  }
+  connected_ = true;
+  // small writes are the point, don't let Nagle hold them
+  socket_.SetOption(PP_TCPSOCKET_OPTION_NO_DELAY, pp::Var(true),
+                    callback_factory_.NewCallback(&ScrcpyControl::OnNoDelay));
+  done_.Run(PP_OK);
+  Read();
+  Write();
+}
+
+void ScrcpyControl::OnNoDelay(int32_t) {}
+
+void ScrcpyControl::SendTouch(const Touch& touch) {
+  if (touch.action != ACTION_MOVE) {
+    // keep the order: the moves before a down or up land first
+    FlushMoves();
+    EncodeTouch(touch, &queued_);
+    Write();
+    return;
+  }
+
+  auto it = std::find_if(moves_.begin(), moves_.end(), [&touch](const Touch& t) {
+    return t.pointer == touch.pointer;
+  });
+  if (it != moves_.end()) {
+    *it = touch;
+  } else {
+    moves_.push_back(touch);
+  }
+  if (move_timer_) {
+    return;
+  }
+  // the first move after a pause goes right away
+  double now = pp::Module::Get()->core()->GetTimeTicks();
+  double wait_ms = kMoveInterval - (now - last_moves_) * 1000;
+  if (wait_ms <= 0) {
+    FlushMoves();
+    Write();
+    return;
+  }
+  move_timer_ = true;
+  pp::Module::Get()->core()->CallOnMainThread(
+      static_cast<int32_t>(wait_ms + 0.5),
+      callback_factory_.NewCallback(&ScrcpyControl::OnMoveTimer));
+}
+
+void ScrcpyControl::Send(const uint8_t* data, size_t size) {
+  FlushMoves();
+  queued_.insert(queued_.end(), data, data + size);
+  Write();
+}
+
+void ScrcpyControl::EncodeTouch(const Touch& touch, std::vector<uint8_t>* out) {
+  out->reserve(out->size() + kTouchSize);
+  out->push_back(kTypeTouch);
+  out->push_back(touch.action);
+  put_u32(out, static_cast<uint32_t>(touch.pointer >> 32));
+  put_u32(out, static_cast<uint32_t>(touch.pointer));
+  put_u32(out, static_cast<uint32_t>(touch.x));
+  put_u32(out, static_cast<uint32_t>(touch.y));
+  put_u16(out, touch.width);
+  put_u16(out, touch.height);
+  float pressure = std::max(0.0f, std::min(touch.pressure, 1.0f));
+  put_u16(out, static_cast<uint32_t>(pressure * 0xffff));
+  put_u32(out, touch.buttons);
+}
+
+void ScrcpyControl::FlushMoves() {
+  if (moves_.empty()) {
+    return;
+  }
+  for (const Touch& move : moves_) {
+    EncodeTouch(move, &queued_);
+  }
+  moves_.clear();
+  last_moves_ = pp::Module::Get()->core()->GetTimeTicks();
+}
+
+void ScrcpyControl::OnMoveTimer(int32_t) {
+  move_timer_ = false;
+  FlushMoves();
+  Write();
+}
+
+// One write in flight; what queues up meanwhile goes out with the next.
+void ScrcpyControl::Write() {
+  if (!connected_ || failed_ || write_pending_) {
+    return;
+  }
+  if (written_ == writing_.size()) {
+    if (queued_.empty()) {
+      return;
+    }
+    writing_.swap(queued_);
+    queued_.clear();
+    written_ = 0;
+  }
+  write_pending_ = true;
+  int32_t result = socket_.Write(
+      reinterpret_cast<const char*>(writing_.data() + written_),
+      static_cast<int32_t>(writing_.size() - written_),
+      callback_factory_.NewCallback(&ScrcpyControl::OnWrite));
+  if (result != PP_OK_COMPLETIONPENDING) {
+    OnWrite(result);
+  }
+}
+
+void ScrcpyControl::OnWrite(int32_t result) {
+  write_pending_ = false;
+  if (result < 0) {
+    Fail(result);
+    return;
+  }
+  written_ += static_cast<size_t>(result);
+  Write();
+}
+
+void ScrcpyControl::Read() {
+  int32_t result = socket_.Read(
+      read_buffer_.data(), static_cast<int32_t>(read_buffer_.size()),
+      callback_factory_.NewCallback(&ScrcpyControl::OnRead));
+  if (result != PP_OK_COMPLETIONPENDING) {
+    OnRead(result);
+  }
+}
+
+void ScrcpyControl::OnRead(int32_t result) {
+  if (result <= 0) {
+    Fail(result < 0 ? result : PP_ERROR_CONNECTION_CLOSED);
+    return;
+  }
+  Read();
+}
+
+void ScrcpyControl::Fail(int32_t result) {
+  if (failed_) {
+    return;
+  }
+  failed_ = true;
+  socket_.Close();
+  // Fail() can be deep in SendTouch() or OnConnect(); the callee may
+  // delete this
+  pp::Module::Get()->core()->CallOnMainThread(
+      0, callback_factory_.NewCallback(&ScrcpyControl::OnFailed), result);
+}
+
+void ScrcpyControl::OnFailed(int32_t result) {
+  closed_.Run(result);
+}
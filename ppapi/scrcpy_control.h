@@ -0,0 +1,93 @@
+#pragma once
+
+#include <ppapi/cpp/instance_handle.h>
+#include <ppapi/cpp/tcp_socket.h>
+#include <ppapi/utility/completion_callback_factory.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// The control connection of a scrcpy stream, held by the plugin.
+//
+// scrcpy takes input as binary control messages on a TCP port the stream
+// reports in its metadata. Touches are encoded here; other messages come
+// encoded from the page. Moves are coalesced: per pointer only the latest
+// position is kept, and moves go out at most once per kMoveInterval, the
+// display refresh. Everything queued while a write is in flight goes out
+// in the next write. Main thread only.
+class ScrcpyControl {
+ public:
+  // android.view.MotionEvent actions
+  enum Action : uint8_t {
+    ACTION_DOWN = 0,
+    ACTION_UP = 1,
+    ACTION_MOVE = 2,
+  };
+
+  struct Touch {
+    uint8_t action;
+    uint64_t pointer;
+    int32_t x;  // device pixels
+    int32_t y;
+    uint16_t width;  // device screen size
+    uint16_t height;
+    float pressure;  // 0..1
+    uint32_t buttons;
+  };
+
+  // milliseconds between move flushes
+  static constexpr int32_t kMoveInterval = 16;
+
+  explicit ScrcpyControl(const pp::InstanceHandle& instance);
+
+  ScrcpyControl(const ScrcpyControl &) = delete;
+  ScrcpyControl &operator=(const ScrcpyControl &) = delete;
+
+  // Connects to |port| on the local host; |done| gets the result.
+  // |closed| runs once the connection fails or the server hangs up, from
+  // a task of its own, so it may destroy the control. It doesn't run once
+  // the control is gone.
+  void Connect(uint16_t port,
+               const pp::CompletionCallback& done,
+               const pp::CompletionCallback& closed);
+
+  void SendTouch(const Touch& touch);
+  // An already encoded control message.
+  void Send(const uint8_t* data, size_t size);
+
+ private:
+  static void EncodeTouch(const Touch& touch, std::vector<uint8_t>* out);
+
+  void OnConnect(int32_t result);
+  void OnNoDelay(int32_t result);
+  void Read();
+  void OnRead(int32_t result);
+  void FlushMoves();
+  void OnMoveTimer(int32_t result);
+  void Write();
+  void OnWrite(int32_t result);
+  void Fail(int32_t result);
+  void OnFailed(int32_t result);
+
+  pp::InstanceHandle instance_;
+  pp::TCPSocket socket_;
+  pp::CompletionCallback done_;
+  pp::CompletionCallback closed_;
+  bool connected_{false};
+  bool failed_{false};
+
+  // latest move of each pointer, not sent yet
+  std::vector<Touch> moves_;
+  bool move_timer_{false};
+  double last_moves_{0};  // time ticks, seconds
+
+  std::vector<uint8_t> queued_;
+  std::vector<uint8_t> writing_;  // in flight
+  size_t written_{0};
+  bool write_pending_{false};
+
+  // device messages (clipboard) are read and dropped
+  std::vector<char> read_buffer_;
+
+  pp::CompletionCallbackFactory<ScrcpyControl> callback_factory_;
+};
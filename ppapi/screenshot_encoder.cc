@@ -0,0 +1,402 @@
+#include "screenshot_encoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// at most this many workers, whatever the core count
+constexpr unsigned kMaxWorkers = 4;
+
+// --- PNG -------------------------------------------------------------------
+//
+// 8-bit RGB, each row filtered with whichever of the PNG filters gives the
+// smallest sum of residuals, compressed with deflate using the fixed Huffman
+// codes and a greedy one-candidate match finder. Larger than zlib at its
+// default level, but fast and without a dependency.
+
+constexpr size_t kWindow = 32768;
+constexpr int kHashBits = 15;
+constexpr int kMinMatch = 3;
+constexpr int kMaxMatch = 258;
+
+const uint16_t kLengthBase[] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistanceBase[] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t kDistanceExtra[] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                  4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                  9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8_t>* out) : out_(out) {}
+
+  void Put(uint32_t bits, int count) {
+    bits_ |= static_cast<uint64_t>(bits) << count_;
+    count_ += count;
+    while (count_ >= 8) {
+      out_->push_back(static_cast<uint8_t>(bits_));
+      bits_ >>= 8;
+      count_ -= 8;
+    }
+  }
+
+  // Huffman codes go most significant bit first.
+  void PutCode(uint32_t code, int count) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < count; i++) {
+      reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    Put(reversed, count);
+  }
+
+  void Flush() {
+    if (count_ > 0) {
+      out_->push_back(static_cast<uint8_t>(bits_));
+    }
+    bits_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  std::vector<uint8_t>* out_;
+  uint64_t bits_{0};
+  int count_{0};
+};
+
+void put_literal(BitWriter* bits, int symbol) {
+  if (symbol < 144) {
+    bits->PutCode(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    bits->PutCode(0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    bits->PutCode(symbol - 256, 7);
+  } else {
+    bits->PutCode(0xc0 + symbol - 280, 8);
+  }
+}
+
+void put_match(BitWriter* bits, int length, int distance) {
+  int code = 28;
+  while (kLengthBase[code] > length) {
+    code--;
+  }
+  put_literal(bits, 257 + code);
+  bits->Put(length - kLengthBase[code], kLengthExtra[code]);
+
+  code = 29;
+  while (kDistanceBase[code] > distance) {
+    code--;
+  }
+  bits->PutCode(code, 5);
+  bits->Put(distance - kDistanceBase[code], kDistanceExtra[code]);
+}
+
+// zlib stream of |data|: header, one fixed-Huffman block, Adler-32.
+void deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>* out) {
+  out->push_back(0x78);
+  out->push_back(0x01);
+
+  BitWriter bits(out);
+  bits.Put(1, 1);  // final block
+  bits.Put(1, 2);  // fixed Huffman codes
+
+  std::vector<int32_t> head(1 << kHashBits, -1);
+  const uint8_t* p = data.data();
+  const int32_t size = static_cast<int32_t>(data.size());
+  int32_t i = 0;
+  while (i < size) {
+    int length = 0;
+    int32_t candidate = -1;
+    if (i + kMinMatch <= size) {
+      uint32_t hash = (p[i] << 16 | p[i + 1] << 8 | p[i + 2]) * 2654435761u >>
+                      (32 - kHashBits);
+      candidate = head[hash];
+      head[hash] = i;
+      if (candidate >= 0 && i - candidate <= static_cast<int32_t>(kWindow)) {
+        int limit = std::min(kMaxMatch, size - i);
+        while (length < limit && p[candidate + length] == p[i + length]) {
+          length++;
+        }
+      }
+    }
+    if (length >= kMinMatch) {
+      put_match(&bits, length, i - candidate);
+      i += length;
+    } else {
+      put_literal(&bits, p[i]);
+      i++;
+    }
+  }
+  put_literal(&bits, 256);
+  bits.Flush();
+
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (size_t n = 0; n < data.size();) {
+    // sums stay below 2^32 for 5552 bytes
+    size_t end = std::min(data.size(), n + 5552);
+    for (; n < end; n++) {
+      a += data[n];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  uint32_t adler = b << 16 | a;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out->push_back(static_cast<uint8_t>(adler >> shift));
+  }
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+  static const std::vector<uint32_t> table = [] {
+    std::vector<uint32_t> t(256);
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++) {
+        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      t[n] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (size_t n = 0; n < size; n++) {
+    crc = table[(crc ^ data[n]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out->push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+void put_chunk(std::vector<uint8_t>* out,
+               const char* type,
+               const std::vector<uint8_t>& data) {
+  put_u32(out, static_cast<uint32_t>(data.size()));
+  size_t start = out->size();
+  out->insert(out->end(), type, type + 4);
+  out->insert(out->end(), data.begin(), data.end());
+  put_u32(out, crc32(out->data() + start, out->size() - start, 0));
+}
+
+uint8_t paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return static_cast<uint8_t>(a);
+  }
+  return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Filtered RGB scanlines of RGBA |pixels|, each with its filter byte.
+std::vector<uint8_t> filter_rows(const std::vector<uint8_t>& pixels,
+                                 int32_t width,
+                                 int32_t height) {
+  const size_t row_size = static_cast<size_t>(width) * 3;
+  std::vector<uint8_t> out;
+  out.reserve((row_size + 1) * height);
+  std::vector<uint8_t> previous(row_size, 0);
+  std::vector<uint8_t> current(row_size);
+  std::vector<uint8_t> filtered[5];
+  for (auto &f : filtered) {
+    f.resize(row_size);
+  }
+
+  for (int32_t y = 0; y < height; y++) {
+    const uint8_t* src = pixels.data() + static_cast<size_t>(y) * width * 4;
+    for (int32_t x = 0; x < width; x++) {
+      memcpy(&current[x * 3], src + x * 4, 3);
+    }
+
+    int best = 0;
+    uint64_t best_sum = UINT64_MAX;
+    for (int type = 0; type < 5; type++) {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < row_size; i++) {
+        int left = i >= 3 ? current[i - 3] : 0;
+        int up = previous[i];
+        int up_left = i >= 3 ? previous[i - 3] : 0;
+        int predicted = 0;
+        switch (type) {
+          case 1: predicted = left; break;
+          case 2: predicted = up; break;
+          case 3: predicted = (left + up) / 2; break;
+          case 4: predicted = paeth(left, up, up_left); break;
+        }
+        uint8_t residual = static_cast<uint8_t>(current[i] - predicted);
+        filtered[type][i] = residual;
+        sum += residual < 128 ? residual : 256 - residual;
+      }
+      if (sum < best_sum) {
+        best_sum = sum;
+        best = type;
+      }
+    }
+    out.push_back(static_cast<uint8_t>(best));
+    out.insert(out.end(), filtered[best].begin(), filtered[best].end());
+    previous.swap(current);
+  }
+  return out;
+}
+
+void encode_png(const std::vector<uint8_t>& pixels,
+                int32_t width,
+                int32_t height,
+                std::vector<uint8_t>* out) {
+  static const uint8_t kSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  out->assign(kSignature, kSignature + sizeof(kSignature));
+
+  std::vector<uint8_t> header;
+  put_u32(&header, static_cast<uint32_t>(width));
+  put_u32(&header, static_cast<uint32_t>(height));
+  header.push_back(8);  // bits per sample
+  header.push_back(2);  // RGB
+  header.push_back(0);  // deflate
+  header.push_back(0);  // adaptive filtering
+  header.push_back(0);  // not interlaced
+  put_chunk(out, "IHDR", header);
+
+  std::vector<uint8_t> compressed;
+  deflate(filter_rows(pixels, width, height), &compressed);
+  put_chunk(out, "IDAT", compressed);
+  put_chunk(out, "IEND", {});
+}
+
+// Encoding yields to decoding and rendering when cores are short.
+void lower_thread_priority() {
+#if defined(_WIN32)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+}
+
+}  // namespace
+
+ScreenshotEncoder::ScreenshotEncoder(void (*wakeup)(void*), void* ctx)
+    : wakeup_(wakeup)
+    , wakeup_ctx_(ctx) {
+  // leave cores to decoding
+  unsigned workers = std::max(1u, std::min(kMaxWorkers,
+                                           std::thread::hardware_concurrency() / 2));
+  max_queued_ = workers * kQueuePerWorker;
+  for (unsigned i = 0; i < workers; i++) {
+    workers_.emplace_back(&ScreenshotEncoder::Run, this);
+  }
+}
+
+ScreenshotEncoder::~ScreenshotEncoder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+bool ScreenshotEncoder::HasRoom() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size() + busy_ < max_queued_;
+}
+
+std::vector<uint8_t> ScreenshotEncoder::TakeBuffer() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_buffers_.empty()) {
+    return {};
+  }
+  std::vector<uint8_t> buffer = std::move(free_buffers_.back());
+  free_buffers_.pop_back();
+  return buffer;
+}
+
+void ScreenshotEncoder::Submit(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(job));
+  }
+  wake_.notify_one();
+}
+
+std::vector<ScreenshotEncoder::Result> ScreenshotEncoder::Take() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Result> results;
+  results.swap(results_);
+  return results;
+}
+
+// Worker thread: encodes (and saves) queued frames, oldest first; jobs
+// still queued at quit are dropped.
+void ScreenshotEncoder::Run() {
+  lower_thread_priority();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return quit_ || !queue_.empty(); });
+    if (quit_) {
+      break;
+    }
+    Job job = std::move(queue_.front());
+    queue_.pop_front();
+    busy_++;
+
+    lock.unlock();
+    Result result = Encode(&job);
+    lock.lock();
+
+    busy_--;
+    if (free_buffers_.size() < max_queued_) {
+      free_buffers_.push_back(std::move(job.pixels));
+    }
+    results_.push_back(std::move(result));
+    wakeup_(wakeup_ctx_);
+  }
+}
+
+ScreenshotEncoder::Result ScreenshotEncoder::Encode(Job* job) {
+  Result result{job->id, job->width, job->height, {}, job->path, job->dropped,
+                nullptr};
+  encode_png(job->pixels, job->width, job->height, &result.data);
+  if (job->path.empty()) {
+    return result;
+  }
+
+  FILE* file = fopen(job->path.c_str(), "wb");
+  if (!file) {
+    result.error = "failed to open file";
+  } else {
+    if (fwrite(result.data.data(), 1, result.data.size(), file) !=
+        result.data.size()) {
+      result.error = "failed to write file";
+    }
+    if (fclose(file) != 0 && !result.error) {
+      result.error = "failed to write file";
+    }
+  }
+  result.data.clear();
+  return result;
+}
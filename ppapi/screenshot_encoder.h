@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Screenshots encoded and saved away from the main and render threads.
+//
+// The render thread copies a drawn frame into a buffer from TakeBuffer()
+// and queues it with Submit(); a few worker threads encode it as PNG and
+// either write the file or hand the bytes back through Take(). The queue
+// is bounded: when HasRoom() is false the caller drops the frame instead
+// of waiting, so a burst never holds up decoding or presenting.
+class ScreenshotEncoder {
+ public:
+  // frames waiting or being encoded, per worker
+  static constexpr size_t kQueuePerWorker = 2;
+
+  struct Job {
+    uint64_t id;
+    int32_t width;
+    int32_t height;
+    std::vector<uint8_t> pixels;  // RGBA, width * 4 bytes a row
+    std::string path;  // written there if set, else returned
+    uint32_t dropped;  // frames of |id| dropped before this one
+  };
+
+  struct Result {
+    uint64_t id;
+    int32_t width;
+    int32_t height;
+    std::vector<uint8_t> data;  // the PNG file, unless saved to |path|
+    std::string path;
+    uint32_t dropped;
+    const char* error;
+  };
+
+  // |wakeup| is called on a worker thread when results are ready to be
+  // picked up with Take().
+  ScreenshotEncoder(void (*wakeup)(void*), void* ctx);
+  ~ScreenshotEncoder();
+
+  ScreenshotEncoder(const ScreenshotEncoder &) = delete;
+  ScreenshotEncoder &operator=(const ScreenshotEncoder &) = delete;
+
+  // Whether Submit() would queue rather than exceed the bound. With a
+  // single submitting thread the answer holds until it submits.
+  bool HasRoom();
+
+  // A pixel buffer to fill, recycled from earlier jobs when possible.
+  std::vector<uint8_t> TakeBuffer();
+
+  void Submit(Job job);
+
+  // Finished jobs, in the order they finished.
+  std::vector<Result> Take();
+
+ private:
+  void Run();
+  static Result Encode(Job* job);
+
+  void (*wakeup_)(void*);
+  void* wakeup_ctx_;
+  size_t max_queued_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool quit_{false};
+  std::deque<Job> queue_;
+  size_t busy_{0};  // jobs taken by workers, not finished
+  std::vector<std::vector<uint8_t>> free_buffers_;
+  std::vector<Result> results_;
+
+  std::vector<std::thread> workers_;
+};
@@ -0,0 +1,89 @@
+#include "software_presenter.h"
+
+#include <ppapi/cpp/point.h>
+#include <ppapi/cpp/rect.h>
+
+SoftwarePresenter::SoftwarePresenter(pp::Instance* instance)
+    : instance_(instance)
+    , callback_factory_(this) {
+  image_format_ = pp::ImageData::GetNativeImageDataFormat();
+  // same byte order, the padding byte lands on alpha
+  format_ = image_format_ == PP_IMAGEDATAFORMAT_BGRA_PREMUL ? "bgr0" : "rgb0";
+}
+
+bool SoftwarePresenter::Resize(int32_t width, int32_t height, float scale) {
+  width_ = width;
+  height_ = height;
+
+  pp::Size size(RoundUp(width), RoundUp(height));
+  if (!graphics_.is_null() && graphics_.size().width() == size.width() &&
+      graphics_.size().height() == size.height()) {
+    if (scale != scale_) {
+      // takes effect with the next flush
+      graphics_.SetScale(1.0f / scale);
+      scale_ = scale;
+    }
+    return true;
+  }
+
+  graphics_ = pp::Graphics2D(instance_, size, true);
+  // the view is in DIPs, the context in pixels
+  graphics_.SetScale(1.0f / scale);
+  scale_ = scale;
+  return instance_->BindGraphics(graphics_);
+}
+
+bool SoftwarePresenter::Acquire(Target* target) {
+  if (width_ <= 0 || height_ <= 0) {
+    return false;
+  }
+
+  current_ = pp::ImageData();
+  while (!free_.empty()) {
+    pp::ImageData image = free_.back();
+    free_.pop_back();
+    // smaller ones are from before a resize, let them go
+    if (image.size().width() >= width_ && image.size().height() >= height_) {
+      current_ = image;
+      break;
+    }
+  }
+
+  if (current_.is_null()) {
+    pp::Size size(RoundUp(width_), RoundUp(height_));
+    current_ = pp::ImageData(instance_, image_format_, size, false);
+    if (current_.is_null()) {
+      return false;
+    }
+    allocations_++;
+
+    // mpv never writes the padding byte, so making it opaque once is
+    // enough for the buffer's lifetime
+    auto pixels = static_cast<uint32_t*>(current_.data());
+    size_t count = static_cast<size_t>(current_.stride() / 4) * size.height();
+    for (size_t i = 0; i < count; i++) {
+      pixels[i] = 0xff000000;
+    }
+  }
+
+  target->pixels = current_.data();
+  target->stride = static_cast<size_t>(current_.stride());
+  return true;
+}
+
+void SoftwarePresenter::Present(const pp::CompletionCallback& done) {
+  graphics_.PaintImageData(current_, pp::Point(0, 0), pp::Rect(0, 0, width_, height_));
+  in_flight_.push_back(current_);
+  current_ = pp::ImageData();
+
+  graphics_.Flush(callback_factory_.NewCallback(&SoftwarePresenter::Flushed, done));
+}
+
+void SoftwarePresenter::Flushed(int32_t result, pp::CompletionCallback done) {
+  // flushes complete in order
+  if (!in_flight_.empty()) {
+    free_.push_back(in_flight_.front());
+    in_flight_.erase(in_flight_.begin());
+  }
+  done.Run(result);
+}
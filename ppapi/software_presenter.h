@@ -0,0 +1,75 @@
+#pragma once
+
+#include <ppapi/cpp/graphics_2d.h>
+#include <ppapi/cpp/image_data.h>
+#include <ppapi/cpp/instance.h>
+#include <ppapi/utility/completion_callback_factory.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Shows frames from mpv's software renderer (MPV_RENDER_API_TYPE_SW)
+// through pp::Graphics2D, for hosts without a usable GPU.
+//
+// Frames are rendered straight into pooled pp::ImageData buffers, painted
+// and flushed; a buffer goes back to the pool when its flush completes.
+// Buffers and the Graphics2D are sized in steps of kSizeStep pixels and
+// only the view's part is painted, so resizing within a step, or
+// shrinking, allocates nothing.
+class SoftwarePresenter {
+ public:
+  static constexpr int32_t kSizeStep = 64;
+
+  struct Target {
+    void* pixels;
+    size_t stride;
+  };
+
+  explicit SoftwarePresenter(pp::Instance* instance);
+
+  SoftwarePresenter(const SoftwarePresenter &) = delete;
+  SoftwarePresenter &operator=(const SoftwarePresenter &) = delete;
+
+  // mpv sw-format matching the browser's native ImageData layout.
+  const char* format() const { return format_; }
+
+  // Sets the image size in pixels; |scale| of them make one DIP of the
+  // view, the device scale or less with dynamic resolution, which the
+  // browser stretches. False if the Graphics2D could not be created or
+  // bound.
+  bool Resize(int32_t width, int32_t height, float scale);
+
+  // A buffer to render the next frame into, or false if none could be
+  // allocated.
+  bool Acquire(Target* target);
+
+  // Shows the buffer from the last Acquire(). |done| runs once the
+  // browser has taken the frame.
+  void Present(const pp::CompletionCallback& done);
+
+  // Number of ImageData allocations, for tests.
+  uint32_t allocations() const { return allocations_; }
+
+ private:
+  static int32_t RoundUp(int32_t v) {
+    return (v + kSizeStep - 1) / kSizeStep * kSizeStep;
+  }
+
+  void Flushed(int32_t result, pp::CompletionCallback done);
+
+  pp::Instance* instance_;
+  const char* format_;
+  PP_ImageDataFormat image_format_;
+
+  pp::Graphics2D graphics_;
+  int32_t width_{0};
+  int32_t height_{0};
+  float scale_{0};
+
+  std::vector<pp::ImageData> free_;
+  pp::ImageData current_;  // acquired, not yet presented
+  std::vector<pp::ImageData> in_flight_;
+  uint32_t allocations_{0};
+
+  pp::CompletionCallbackFactory<SoftwarePresenter> callback_factory_;
+};
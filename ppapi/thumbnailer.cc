@@ -0,0 +1,337 @@
+#include "thumbnailer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// seconds to wait for a file to open and for a seek to land
+constexpr double kOpenTimeout = 10.0;
+constexpr double kSeekTimeout = 2.0;
+// mpv_wait_event slices, so a quitting worker does not hang around
+constexpr double kWaitSlice = 0.1;
+
+// a cached frame this close to a request is good enough, seconds; long
+// files use half the distance between index points
+constexpr double kMinTolerance = 1.0;
+
+}  // namespace
+
+Thumbnailer::Thumbnailer(void (*wakeup)(void*), void* ctx)
+    : wakeup_(wakeup)
+    , wakeup_ctx_(ctx) {
+  worker_ = std::thread(&Thumbnailer::Run, this);
+}
+
+Thumbnailer::~Thumbnailer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+}
+
+bool Thumbnailer::Request(uint64_t id,
+                          const std::string& url,
+                          double time,
+                          int32_t width,
+                          Thumbnail* out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (url == cache_url_ && width == cache_width_) {
+    Lru::iterator it = Find(time);
+    if (it != lru_.end()) {
+      lru_.splice(lru_.begin(), lru_, it);
+      *out = {id, time, width, it->height, it->pixels, nullptr};
+      return true;
+    }
+  }
+
+  if (pending_) {
+    Finish({pending_->id, pending_->time, pending_->width, 0, nullptr,
+            "superseded"});
+  }
+  pending_.reset(new Pending{id, url, time, width});
+  wake_.notify_one();
+  return false;
+}
+
+std::vector<Thumbnailer::Thumbnail> Thumbnailer::Take() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Thumbnail> results;
+  results.swap(results_);
+  return results;
+}
+
+void Thumbnailer::OnRenderUpdate(void* ctx) {
+  Thumbnailer* self = static_cast<Thumbnailer*>(ctx);
+  {
+    std::lock_guard<std::mutex> lock(self->frame_mutex_);
+    self->frame_due_ = true;
+  }
+  self->frame_ready_.notify_one();
+}
+
+// Worker thread: the waiting request first, then the index.
+void Thumbnailer::Run() {
+  bool ok = InitPlayer();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  failed_ = !ok;
+  while (!quit_) {
+    if (pending_) {
+      Pending request = std::move(*pending_);
+      pending_.reset();
+      if (failed_) {
+        Finish({request.id, request.time, request.width, 0, nullptr,
+                "thumbnailer unavailable"});
+        continue;
+      }
+
+      lock.unlock();
+      bool opened = request.url == open_url_ || Open(request.url);
+      lock.lock();
+      if (!opened) {
+        Finish({request.id, request.time, request.width, 0, nullptr,
+                "failed to open"});
+        continue;
+      }
+      if (request.width != cache_width_) {
+        lru_.clear();
+        by_time_.clear();
+        cache_width_ = request.width;
+        index_next_ = 0;
+      }
+
+      lock.unlock();
+      Entry entry{request.time, 0, nullptr};
+      bool rendered = Render(request.time, request.width, &entry);
+      lock.lock();
+      if (rendered) {
+        Insert(entry);
+        Finish({request.id, request.time, request.width, entry.height,
+                entry.pixels, nullptr});
+      } else {
+        Finish({request.id, request.time, request.width, 0, nullptr,
+                "failed to render"});
+      }
+      continue;
+    }
+
+    if (!failed_ && index_next_ < kIndexPoints && duration_ > 0) {
+      double time = duration_ * (index_next_ + 0.5) / kIndexPoints;
+      int32_t width = cache_width_;
+      index_next_++;
+      if (Find(time) != lru_.end()) {
+        continue;
+      }
+      lock.unlock();
+      Entry entry{time, 0, nullptr};
+      bool rendered = Render(time, width, &entry);
+      lock.lock();
+      if (rendered) {
+        Insert(entry);
+      }
+      continue;
+    }
+
+    wake_.wait(lock);
+  }
+  lock.unlock();
+
+  if (render_) {
+    mpv_render_context_free(render_);
+  }
+  if (mpv_) {
+    mpv_terminate_destroy(mpv_);
+  }
+}
+
+bool Thumbnailer::InitPlayer() {
+  mpv_ = mpv_create();
+  if (!mpv_) {
+    fprintf(stderr, "thumbnailer: context init failed\n");
+    return false;
+  }
+
+  // video only, decoded as cheaply as possible, never played
+  mpv_set_option_string(mpv_, "idle", "yes");
+  mpv_set_option_string(mpv_, "pause", "yes");
+  mpv_set_option_string(mpv_, "keep-open", "always");
+  mpv_set_option_string(mpv_, "ao", "null");
+  mpv_set_option_string(mpv_, "aid", "no");
+  mpv_set_option_string(mpv_, "sid", "no");
+  mpv_set_option_string(mpv_, "audio-display", "no");
+  mpv_set_option_string(mpv_, "osd-level", "0");
+  mpv_set_option_string(mpv_, "hr-seek", "no");
+  mpv_set_option_string(mpv_, "hwdec", "no");
+  mpv_set_option_string(mpv_, "vd-lavc-skiploopfilter", "all");
+  mpv_set_option_string(mpv_, "vd-lavc-fast", "yes");
+  mpv_set_option_string(mpv_, "sws-scaler", "fast-bilinear");
+  mpv_set_option_string(mpv_, "demuxer-max-bytes", "8MiB");
+  mpv_set_option_string(mpv_, "demuxer-readahead-secs", "0");
+  mpv_set_option_string(mpv_, "stop-playback-on-init-failure", "yes");
+
+  if (mpv_initialize(mpv_) < 0) {
+    fprintf(stderr, "thumbnailer: mpv init failed\n");
+    return false;
+  }
+
+  mpv_render_param params[] = {
+      {MPV_RENDER_PARAM_API_TYPE, const_cast<char *>(MPV_RENDER_API_TYPE_SW)},
+      {MPV_RENDER_PARAM_INVALID, nullptr}
+  };
+  if (mpv_render_context_create(&render_, mpv_, params) < 0) {
+    fprintf(stderr, "thumbnailer: failed to initialize software renderer\n");
+    render_ = nullptr;
+    return false;
+  }
+  mpv_render_context_set_update_callback(render_, OnRenderUpdate, this);
+  return true;
+}
+
+bool Thumbnailer::Open(const std::string& url) {
+  open_url_.clear();
+  const char* load[] = {"loadfile", url.c_str(), "replace", nullptr};
+  if (mpv_command(mpv_, load) < 0 ||
+      !WaitEvent(MPV_EVENT_FILE_LOADED, kOpenTimeout)) {
+    return false;
+  }
+  open_url_ = url;
+
+  double duration = 0;
+  int64_t width = 0;
+  int64_t height = 0;
+  mpv_get_property(mpv_, "duration", MPV_FORMAT_DOUBLE, &duration);
+  mpv_get_property(mpv_, "dwidth", MPV_FORMAT_INT64, &width);
+  mpv_get_property(mpv_, "dheight", MPV_FORMAT_INT64, &height);
+  video_width_ = static_cast<int32_t>(width);
+  video_height_ = static_cast<int32_t>(height);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  cache_url_ = url;
+  lru_.clear();
+  by_time_.clear();
+  duration_ = duration;
+  tolerance_ = std::max(kMinTolerance, duration / kIndexPoints / 2);
+  index_next_ = 0;
+  return true;
+}
+
+// Waits for |id|; false on timeout, quit, or the file failing.
+bool Thumbnailer::WaitEvent(mpv_event_id id, double timeout) {
+  int64_t deadline = mpv_get_time_us(mpv_) + static_cast<int64_t>(timeout * 1e6);
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (quit_) {
+        return false;
+      }
+    }
+    double left = (deadline - mpv_get_time_us(mpv_)) / 1e6;
+    if (left <= 0) {
+      return false;
+    }
+    mpv_event* event = mpv_wait_event(mpv_, std::min(left, kWaitSlice));
+    if (event->event_id == id) {
+      return true;
+    }
+    if (event->event_id == MPV_EVENT_SHUTDOWN) {
+      return false;
+    }
+    // the file before the one being opened ends with STOP
+    if (event->event_id == MPV_EVENT_END_FILE &&
+        static_cast<mpv_event_end_file*>(event->data)->reason !=
+            MPV_END_FILE_REASON_STOP) {
+      return false;
+    }
+  }
+}
+
+bool Thumbnailer::Render(double time, int32_t width, Entry* entry) {
+  // keep the video's aspect, even sizes scale cleaner
+  int32_t height = video_width_ > 0 && video_height_ > 0
+                       ? width * video_height_ / video_width_
+                       : width * 9 / 16;
+  height = std::max(2, height & ~1);
+
+  {
+    std::lock_guard<std::mutex> lock(frame_mutex_);
+    frame_due_ = false;
+  }
+  char target[32];
+  snprintf(target, sizeof(target), "%.3f", time);
+  const char* seek[] = {"seek", target, "absolute+keyframes", nullptr};
+  if (mpv_command(mpv_, seek) < 0 ||
+      !WaitEvent(MPV_EVENT_PLAYBACK_RESTART, kSeekTimeout)) {
+    return false;
+  }
+  {
+    std::unique_lock<std::mutex> lock(frame_mutex_);
+    frame_ready_.wait_for(lock, std::chrono::duration<double>(kSeekTimeout),
+                          [this] { return frame_due_; });
+  }
+  mpv_render_context_update(render_);
+
+  auto pixels = std::make_shared<std::vector<uint8_t>>(
+      static_cast<size_t>(width) * height * 4);
+  int size[] = {width, height};
+  size_t stride = static_cast<size_t>(width) * 4;
+  mpv_render_param params[] = {
+      {MPV_RENDER_PARAM_SW_SIZE, size},
+      {MPV_RENDER_PARAM_SW_FORMAT, const_cast<char *>("rgb0")},
+      {MPV_RENDER_PARAM_SW_STRIDE, &stride},
+      {MPV_RENDER_PARAM_SW_POINTER, pixels->data()},
+      {MPV_RENDER_PARAM_INVALID, nullptr}
+  };
+  if (mpv_render_context_render(render_, params) < 0) {
+    return false;
+  }
+  // the padding byte is undefined, canvas wants it opaque
+  for (size_t i = 3; i < pixels->size(); i += 4) {
+    (*pixels)[i] = 0xff;
+  }
+
+  entry->height = height;
+  entry->pixels = std::move(pixels);
+  return true;
+}
+
+Thumbnailer::Lru::iterator Thumbnailer::Find(double time) {
+  auto after = by_time_.lower_bound(time);
+  auto best = by_time_.end();
+  if (after != by_time_.end()) {
+    best = after;
+  }
+  if (after != by_time_.begin()) {
+    auto before = std::prev(after);
+    if (best == by_time_.end() || time - before->first < best->first - time) {
+      best = before;
+    }
+  }
+  if (best == by_time_.end() || fabs(best->first - time) > tolerance_) {
+    return lru_.end();
+  }
+  return best->second;
+}
+
+void Thumbnailer::Insert(Entry entry) {
+  auto it = by_time_.find(entry.time);
+  if (it != by_time_.end()) {
+    lru_.erase(it->second);
+  }
+  lru_.push_front(std::move(entry));
+  by_time_[lru_.front().time] = lru_.begin();
+
+  if (lru_.size() > kCacheSize) {
+    by_time_.erase(lru_.back().time);
+    lru_.pop_back();
+  }
+}
+
+void Thumbnailer::Finish(Thumbnail thumbnail) {
+  results_.push_back(std::move(thumbnail));
+  wakeup_(wakeup_ctx_);
+}
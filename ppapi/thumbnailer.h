@@ -0,0 +1,122 @@
+#pragma once
+
+#include "client.h"
+#include "render.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Seek-bar previews from a second, hidden mpv player.
+//
+// A worker thread owns an mpv handle with ao=null, no tracks but video and
+// a software render context. It opens the requested file paused, seeks to
+// keyframes and renders small RGBA frames, so scrubbing never touches the
+// player the user watches. Thumbnails are kept in an LRU cache; while no
+// request is waiting the worker fills it with kIndexPoints frames spread
+// over the file, so moving along the bar mostly hits the cache.
+//
+// Only the newest request is worked on: one still waiting when the next
+// comes in is answered with an error.
+class Thumbnailer {
+ public:
+  static constexpr int kIndexPoints = 100;
+  static constexpr size_t kCacheSize = 256;
+
+  struct Thumbnail {
+    uint64_t id;
+    double time;  // seconds, as requested
+    int32_t width;
+    int32_t height;
+    // RGBA, width * 4 bytes a row; shared with the cache
+    std::shared_ptr<const std::vector<uint8_t>> pixels;
+    const char* error;  // set when there are no pixels
+  };
+
+  // |wakeup| is called on the worker thread when results are ready to be
+  // picked up with Take().
+  Thumbnailer(void (*wakeup)(void*), void* ctx);
+  ~Thumbnailer();
+
+  Thumbnailer(const Thumbnailer &) = delete;
+  Thumbnailer &operator=(const Thumbnailer &) = delete;
+
+  // Queues a thumbnail of |url| at |time|, |width| pixels wide. Returns
+  // true with |out| filled if the cache already has one close enough.
+  bool Request(uint64_t id,
+               const std::string& url,
+               double time,
+               int32_t width,
+               Thumbnail* out);
+
+  // Finished requests, in order.
+  std::vector<Thumbnail> Take();
+
+ private:
+  struct Pending {
+    uint64_t id;
+    std::string url;
+    double time;
+    int32_t width;
+  };
+
+  struct Entry {
+    double time;
+    int32_t height;
+    std::shared_ptr<const std::vector<uint8_t>> pixels;
+  };
+
+  using Lru = std::list<Entry>;
+
+  static void OnRenderUpdate(void* ctx);
+
+  // worker thread
+  void Run();
+  bool InitPlayer();
+  bool Open(const std::string& url);
+  bool WaitEvent(mpv_event_id id, double timeout);
+  bool Render(double time, int32_t width, Entry* entry);
+
+  // mutex_ held
+  Lru::iterator Find(double time);
+  void Insert(Entry entry);
+  void Finish(Thumbnail thumbnail);
+
+  void (*wakeup_)(void*);
+  void* wakeup_ctx_;
+
+  // worker thread
+  mpv_handle* mpv_{nullptr};
+  mpv_render_context* render_{nullptr};
+  std::string open_url_;
+  int32_t video_width_{0};
+  int32_t video_height_{0};
+
+  std::mutex frame_mutex_;
+  std::condition_variable frame_ready_;
+  bool frame_due_{false};
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool quit_{false};
+  bool failed_{false};
+  std::unique_ptr<Pending> pending_;
+  std::vector<Thumbnail> results_;
+
+  // cache of (cache_url_, cache_width_), most recent first
+  std::string cache_url_;
+  int32_t cache_width_{0};
+  double duration_{0};
+  double tolerance_{0};  // seconds a cached frame may be off
+  int index_next_{kIndexPoints};
+  Lru lru_;
+  std::map<double, Lru::iterator> by_time_;
+
+  std::thread worker_;
+};
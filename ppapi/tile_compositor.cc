@@ -0,0 +1,155 @@
+#include "tile_compositor.h"
+
+#include <stdio.h>
+
+namespace {
+
+// mpv renders into a framebuffer object top row first (no FLIP_Y), so
+// the top of the quad samples t = 0.
+const char kVertexShader[] =
+    "attribute vec2 position;\n"
+    "varying vec2 texcoord;\n"
+    "void main() {\n"
+    "  texcoord = vec2(position.x + 1.0, 1.0 - position.y) * 0.5;\n"
+    "  gl_Position = vec4(position, 0.0, 1.0);\n"
+    "}\n";
+
+const char kFragmentShader[] =
+    "precision mediump float;\n"
+    "uniform sampler2D sampler;\n"
+    "varying vec2 texcoord;\n"
+    "void main() {\n"
+    "  gl_FragColor = texture2D(sampler, texcoord);\n"
+    "}\n";
+
+const GLfloat kQuad[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+
+GLuint CompileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+
+  GLint status = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (status != GL_TRUE) {
+    char log[512] = "";
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    fprintf(stderr, "tile compositor: shader: %s\n", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+}  // namespace
+
+bool TileCompositor::Init() {
+  GLuint vertex = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  GLuint fragment = CompileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+  if (!vertex || !fragment) {
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    return false;
+  }
+
+  program_ = glCreateProgram();
+  glAttachShader(program_, vertex);
+  glAttachShader(program_, fragment);
+  glLinkProgram(program_);
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+
+  GLint status = GL_FALSE;
+  glGetProgramiv(program_, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE) {
+    fprintf(stderr, "tile compositor: link failed\n");
+    Destroy();
+    return false;
+  }
+  position_ = glGetAttribLocation(program_, "position");
+  sampler_ = glGetUniformLocation(program_, "sampler");
+
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kQuad), kQuad, GL_STATIC_DRAW);
+  return true;
+}
+
+void TileCompositor::Destroy() {
+  if (buffer_) {
+    glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+  }
+  if (program_) {
+    glDeleteProgram(program_);
+    program_ = 0;
+  }
+}
+
+bool TileCompositor::Prepare(Surface* surface, int width, int height) {
+  if (surface->texture && surface->width == width &&
+      surface->height == height) {
+    return false;
+  }
+
+  if (!surface->texture) {
+    glGenTextures(1, &surface->texture);
+    glGenFramebuffers(1, &surface->framebuffer);
+  }
+  glBindTexture(GL_TEXTURE_2D, surface->texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, surface->framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         surface->texture, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  surface->width = width;
+  surface->height = height;
+  return true;
+}
+
+void TileCompositor::Release(Surface* surface) {
+  if (surface->framebuffer) {
+    glDeleteFramebuffers(1, &surface->framebuffer);
+  }
+  if (surface->texture) {
+    glDeleteTextures(1, &surface->texture);
+  }
+  *surface = Surface();
+}
+
+void TileCompositor::Begin(int view_width, int view_height) {
+  view_height_ = view_height;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, view_width, view_height);
+  glClearColor(0, 0, 0, 1);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  // mpv leaves its own state behind after every render
+  glUseProgram(program_);
+  glDisable(GL_BLEND);
+  glDisable(GL_SCISSOR_TEST);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+  glVertexAttribPointer(position_, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glEnableVertexAttribArray(position_);
+  glActiveTexture(GL_TEXTURE0);
+  glUniform1i(sampler_, 0);
+}
+
+void TileCompositor::Draw(const Surface& surface, int x, int y, int width,
+                          int height) {
+  if (!surface.texture) {
+    return;
+  }
+  // GL's origin is the bottom left corner
+  glViewport(x, view_height_ - y - height, width, height);
+  glBindTexture(GL_TEXTURE_2D, surface.texture);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GLES2/gl2.h>
+
+// Puts several mpv GL renders on one Graphics3D. Each player renders into
+// its own Surface, a texture backed framebuffer the size of its tile or
+// smaller with dynamic resolution; the surfaces are then drawn, scaled,
+// into their rectangles of the default framebuffer and presented with a
+// single SwapBuffers. A surface keeps its last frame, so tiles without a
+// new frame are only redrawn.
+//
+// Every call needs the Graphics3D current on the calling thread.
+class TileCompositor {
+ public:
+  struct Surface {
+    GLuint framebuffer{0};
+    GLuint texture{0};
+    int width{0};
+    int height{0};
+  };
+
+  TileCompositor() = default;
+
+  TileCompositor(const TileCompositor &) = delete;
+  TileCompositor &operator=(const TileCompositor &) = delete;
+
+  bool Init();
+  void Destroy();
+
+  // Sizes |surface| to width x height. True if its contents are new and
+  // need rendering regardless of whether mpv has a new frame.
+  bool Prepare(Surface* surface, int width, int height);
+  void Release(Surface* surface);
+
+  // Clears the default framebuffer of the view.
+  void Begin(int view_width, int view_height);
+  // Draws |surface| stretched to the width x height rectangle with its top
+  // left corner at x, y, in view pixels.
+  void Draw(const Surface& surface, int x, int y, int width, int height);
+
+ private:
+  GLuint program_{0};
+  GLuint buffer_{0};
+  GLint position_{-1};
+  GLint sampler_{-1};
+  int view_height_{0};
+};
@@ -100,6 +100,7 @@ export default class XControlBar extends LitElement {
     screenshotting: { type: Boolean, state: true },
     aiSwitch: { type: String, state: true },
     localDetection: { type: Boolean, state: true },
+    preview: { type: Object, state: true },
   }
 
   constructor () {
@@ -122,6 +123,7 @@ export default class XControlBar extends LitElement {
     this.screenshotting = false
     this.aiSwitch = ''
     this.localDetection = false
+    this.preview = null
   }
 
   connectedCallback () {
@@ -282,7 +284,7 @@ export default class XControlBar extends LitElement {
       title=${i18n.t('video.Full_screen')}
     ></x-btn>
 
-    <x-play-bar ?hidden=${this.scrcpy} ?idle=${this.idle} timePos=${this.timePos} duration=${this.duration}>
+    <x-play-bar ?hidden=${this.scrcpy} ?idle=${this.idle} timePos=${this.timePos} duration=${this.duration} .preview=${this.preview}>
     </x-play-bar>
     `
   }
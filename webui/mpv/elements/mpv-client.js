@@ -64,25 +64,248 @@ const observedProperties = [
   'metadata'
 ]
 
+// scalar properties are delivered natively, without an mpv_node tree
+const observeFormats = {
+  'width': 'int64',
+  'height': 'int64',
+  'pause': 'flag',
+  'speed': 'double',
+  'time-pos': 'double',
+  'duration': 'double',
+  'eof-reached': 'flag',
+  'filename': 'string',
+  'path': 'string',
+  'file-size': 'int64',
+  'file-format': 'string',
+  'mute': 'flag',
+  'volume': 'double',
+  'idle-active': 'flag',
+  'media-title': 'string',
+  'playlist-pos': 'int64',
+  'video-codec': 'string',
+  'audio-codec-name': 'string',
+  'estimated-vf-fps': 'double',
+  'estimated-frame-count': 'int64',
+  'hwdec-current': 'string',
+}
+
+// per-frame properties, the plugin holds back changes in between
+// rate: max updates per second, epsilon: min change to send immediately
+const observeLimits = {
+  'time-pos': { rate: 10, epsilon: 1 },
+  'estimated-vf-fps': { rate: 2, epsilon: 1 },
+  'estimated-frame-count': { rate: 2 },
+}
+
+// request opcodes, must match RequestOp in ppapi/pepper.cc
+const requestOps = {
+  'command': 1,
+  'set_property': 2,
+  'observe_property': 3,
+  'unobserve_property': 4,
+  'get_property_async': 5,
+  'resync_property': 6,
+  'hook_continue': 7,
+  'hook_add': 8,
+  'set_option': 9,
+  'configure': 10,
+  'batch': 11,
+  'get_request_stats': 12,
+  'set_layout': 13,
+  'thumbnail': 14,
+  'grab_frame': 15,
+  'screenshot': 16,
+  'stream_push': 17,
+  'scrcpy': 18,
+  'get_stats': 19,
+  'log': 20,
+}
+
+// structured properties, the plugin sends patches against the last value
+const observeDiffs = [
+  'playlist',
+  'track-list',
+  'metadata',
+]
+
+// patch from the plugin: {at, remove, insert} for arrays, {set, del} for
+// maps. Returns undefined if it doesn't fit the base.
+function applyPatch (base, patch) {
+  if (Array.isArray(base)) {
+    if (!Array.isArray(patch.insert)) {
+      return undefined
+    }
+    const value = base.slice()
+    value.splice(patch.at, patch.remove, ...patch.insert)
+    return value
+  }
+
+  if (base && typeof base === 'object' && patch.set) {
+    // keys come from the media, a __proto__ tag must stay a key
+    const value = Object.assign(Object.create(null), base, patch.set)
+    patch.del.forEach(key => delete value[key])
+    return value
+  }
+
+  return undefined
+}
+
 const profiles = {
   nodelay: nodelayOptions,
   sync: syncOptions,
   init: initOptions,
 }
 
+// value tags of the plugin's binary event format, see ppapi/event_encoder.h
+const TAG_NONE = 0
+const TAG_FALSE = 1
+const TAG_TRUE = 2
+const TAG_INT32 = 3
+const TAG_INT64 = 4
+const TAG_DOUBLE = 5
+const TAG_STRING = 6
+const TAG_ARRAY = 7
+const TAG_MAP = 8
+const TAG_BYTES = 9
+const TAG_ATOM = 10
+const TAG_ATOM_DEF = 11
+
+// Decodes ArrayBuffer event messages into the objects the plugin sends
+// otherwise. Atoms (keys, event and property names) are defined once and
+// then referenced by id, so one decoder must see every message in order.
+class EventDecoder {
+  constructor () {
+    this._atoms = []
+    this._text = new TextDecoder()
+  }
+
+  decode (buffer) {
+    this._view = new DataView(buffer)
+    this._bytes = new Uint8Array(buffer)
+    this._pos = 0
+
+    const events = []
+    while (this._pos < this._bytes.length) {
+      if (this._bytes[this._pos] === TAG_ATOM_DEF) {
+        const id = this._view.getUint16(this._pos + 1, true)
+        const len = this._view.getUint16(this._pos + 3, true)
+        this._pos += 5
+        this._atoms[id] = this._string(len)
+      } else {
+        events.push(this._value())
+      }
+    }
+    return events
+  }
+
+  _string (len) {
+    const s = this._text.decode(this._bytes.subarray(this._pos, this._pos + len))
+    this._pos += len
+    return s
+  }
+
+  _value () {
+    const view = this._view
+    const tag = this._bytes[this._pos++]
+    let v, n
+    switch (tag) {
+      case TAG_NONE:
+        return null
+      case TAG_FALSE:
+        return false
+      case TAG_TRUE:
+        return true
+      case TAG_INT32:
+        v = view.getInt32(this._pos, true)
+        this._pos += 4
+        return v
+      case TAG_INT64:
+        // full 64 bits, as BigInt when a Number would lose precision
+        v = view.getBigInt64(this._pos, true)
+        this._pos += 8
+        return Number.isSafeInteger(Number(v)) ? Number(v) : v
+      case TAG_DOUBLE:
+        v = view.getFloat64(this._pos, true)
+        this._pos += 8
+        return v
+      case TAG_STRING:
+        n = view.getUint32(this._pos, true)
+        this._pos += 4
+        return this._string(n)
+      case TAG_BYTES:
+        n = view.getUint32(this._pos, true)
+        this._pos += 4
+        v = this._bytes.slice(this._pos, this._pos + n).buffer
+        this._pos += n
+        return v
+      case TAG_ATOM:
+        v = this._atoms[view.getUint16(this._pos, true)]
+        this._pos += 2
+        return v
+      case TAG_ARRAY:
+        n = view.getUint32(this._pos, true)
+        this._pos += 4
+        v = []
+        for (let i = 0; i < n; i++) {
+          v.push(this._value())
+        }
+        return v
+      case TAG_MAP:
+        n = view.getUint32(this._pos, true)
+        this._pos += 4
+        // metadata keys come from the media file
+        v = Object.create(null)
+        for (let i = 0; i < n; i++) {
+          const key = this._value()
+          v[key] = this._value()
+        }
+        return v
+      default:
+        throw new Error(`bad event tag ${tag}`)
+    }
+  }
+}
+
+// One client per player. With the plugin in compositor mode (tiles embed
+// attribute) pass the tile index: requests carry it and events from other
+// tiles are ignored. A page hosting several clients on one element should
+// unpack each message once and hand every event to the client of e.tile.
 export default class MpvClient {
-  constructor (el) {
+  constructor (el, tile) {
     this.$el = el
+    this.tile = tile
 
     this._init()
   }
 
+  // plugin message -> list of events
+  unpack (data) {
+    if (data instanceof ArrayBuffer) {
+      return this._decoder.decode(data)
+    }
+    // batched delivery: all events of one plugin wakeup in one message
+    return Array.isArray(data) ? data : [data]
+  }
+
   onMessage (e) {
+    if (Array.isArray(e) || e instanceof ArrayBuffer) {
+      this.unpack(e).forEach(ev => this.onMessage(ev))
+      return
+    }
+
+    if (this.tile !== undefined && e.tile !== undefined && e.tile !== this.tile) {
+      return
+    }
+
     const handlers = this._eventHandlers[e.event]
     handlers && handlers.forEach(cb => cb(e))
   }
 
   onKeypress (e) {
+    // the plugin takes the keys itself
+    if (this._nativeKeys) {
+      return
+    }
     if (e.type === 'keydown') {
       this.keypress(e)
     }
@@ -131,11 +354,175 @@ export default class MpvClient {
     }
   }
 
+  // all options in one batch request, applied back to back; options mpv
+  // rejects are logged one by one, as property() does
   profile (name) {
     const options = profiles[name] || {}
-  
-    for (const name in options) {
-      this.option(name, options[name])
+    const names = Object.keys(options)
+
+    return this.batch(names.map(name => ({
+      type: 'set_property',
+      data: { name: `options/${name}`, value: options[name] }
+    })))
+      .then(results => {
+        results.forEach((result, i) => {
+          if (result && result.error) {
+            console.log('---------', names[i], result.error)
+          }
+        })
+      })
+      .catch(e => {
+        console.log('---------', name, e)
+      })
+  }
+
+  // requests: [{ type, data, id }], run by the plugin in one go. Resolves
+  // with one { result } or { error } per request.
+  batch (requests) {
+    const items = requests.map(({ type, ...request }) => ({ op: requestOps[type], ...request }))
+    return this._asyncToPromise((id) => this._postRequest('batch', items, id), 'batch', DEFAULT_TIMEOUTS)
+  }
+
+  // time the plugin spends per request type: { type: { count, total_ms, max_ms } }
+  requestStats () {
+    return this._asyncToPromise((id) => this._postRequest('get_request_stats', null, id), 'request stats', DEFAULT_TIMEOUTS)
+  }
+
+  // stage timings, counters and queue depths of the plugin, overall and per
+  // tile: { stats }. reset starts them over after this reply.
+  stats ({ reset = false } = {}) {
+    return this._asyncToPromise((id) => this._postRequest('get_stats', { reset }, id), 'stats', DEFAULT_TIMEOUTS)
+      .then(({ stats }) => stats)
+  }
+
+  // records the last spans of the main and render threads until
+  // stopTrace(), which resolves to Chrome trace_event JSON for
+  // chrome://tracing or Perfetto
+  startTrace () {
+    return this._asyncToPromise((id) => this._postRequest('get_stats', { trace: true }, id), 'stats', DEFAULT_TIMEOUTS)
+  }
+
+  stopTrace () {
+    return this._asyncToPromise((id) => this._postRequest('get_stats', { trace: false }, id), 'stats', DEFAULT_TIMEOUTS)
+      .then(({ trace }) => trace)
+  }
+
+  // mpv's log, held by the plugin until fetched. levels in mpv's
+  // msg-level syntax, 'all=warn,ffmpeg=v', or 'no' to stop; onready, if
+  // given, runs once lines are waiting and again after each fetchLog()
+  logLevels (levels, onready) {
+    this._logReady = onready || null
+    return this._asyncToPromise((id) => this._postRequest('log', { levels, notify: !!onready }, id), 'log', DEFAULT_TIMEOUTS)
+      .then(() => undefined)
+  }
+
+  // the oldest max lines not fetched yet, all by default:
+  // { lines: [{ tile, level, prefix, text }], dropped, pending }
+  fetchLog (max) {
+    return this._asyncToPromise((id) => this._postRequest('log', { fetch: max ?? true }, id), 'log', DEFAULT_TIMEOUTS)
+      .then(({ lines, dropped, pending }) => ({
+        lines: lines.map(([tile, level, prefix, text]) => ({ tile, level, prefix, text })),
+        dropped,
+        pending
+      }))
+  }
+
+  // compositor mode: rects: [{ x, y, w, h }] as fractions of the element,
+  // one per tile; tiles without a rect are hidden
+  setLayout (rects) {
+    this.$el.postMessage({ op: requestOps.set_layout, data: rects, id: 0 })
+  }
+
+  // a small frame of url near time (seconds) from the plugin's hidden
+  // preview player: { time, width, height, data }, RGBA pixels in data.
+  // Rejects once a newer request replaced it.
+  thumbnail (url, time, width = 160) {
+    return this._asyncToPromise((id) => this._postRequest('thumbnail', { url, time, width }, id), 'thumbnail', DEFAULT_TIMEOUTS)
+  }
+
+  // the next frame as drawn: { width, height, format, data }, scaled to
+  // opts.width x opts.height (default: as shown) in opts.format, 'rgba',
+  // 'bgra' or 'gray'
+  grabFrame (opts = {}) {
+    const { every, ...request } = opts
+    return this._asyncToPromise((id) => this._postRequest('grab_frame', request, id), 'grab frame', DEFAULT_TIMEOUTS)
+  }
+
+  // calls fn with every every-th frame, like grabFrame, until the returned
+  // function is called
+  streamFrames (opts, fn) {
+    const id = this._next_gid++
+    this._frameStreams[id] = fn
+    this._postRequest('grab_frame', { ...opts, every: opts.every || 1 }, id)
+    return () => {
+      delete this._frameStreams[id]
+      this._postRequest('grab_frame', { every: 0 }, id)
+    }
+  }
+
+  // the next frame as drawn, PNG-encoded off the render thread:
+  // { width, height, format, data } or with opts.save { file }, saved to
+  // opts.directory (default: the screenshot-directory option)
+  screenshot (opts = {}) {
+    const { every, ...request } = opts
+    return this._asyncToPromise((id) => this._postRequest('screenshot', request, id), 'screenshot', DEFAULT_TIMEOUTS)
+  }
+
+  // screenshots of every opts.every-th frame (default: each frame) until
+  // the returned function is called; fn gets each result with dropped,
+  // the frames skipped so far because encoding fell behind
+  screenshotBurst (opts, fn) {
+    const id = this._next_gid++
+    this._frameStreams[id] = fn
+    this._postRequest('screenshot', { ...opts, every: opts.every || 1 }, id)
+    return () => {
+      delete this._frameStreams[id]
+      this._postRequest('screenshot', { every: 0 }, id)
+    }
+  }
+
+  // media from the page's own connection, no local server in between:
+  // load stream.url, then await stream.push(chunk) for each ArrayBuffer and
+  // call stream.end(). push resolves once the plugin took the whole chunk,
+  // waiting while its buffer is full; it rejects once the player closed
+  // the stream.
+  createStream (name = `${Date.now().toString(36)}-${Math.random().toString(36).slice(2)}`) {
+    const waiters = this._streamWaiters[name] = []
+    const post = (data) => this._asyncToPromise((id) => this._postRequest('stream_push', { stream: name, ...data }, id), 'stream push', DEFAULT_TIMEOUTS)
+    return {
+      url: `jsstream://${name}`,
+      push: async (chunk) => {
+        while (chunk.byteLength) {
+          const { written } = await post({ data: chunk })
+          chunk = chunk.slice(written)
+          if (chunk.byteLength) {
+            await new Promise((resolve, reject) => waiters.push({ resolve, reject }))
+          }
+        }
+      },
+      end: () => {
+        delete this._streamWaiters[name]
+        return post({ eof: true })
+      }
+    }
+  }
+
+  // scrcpy control connection held by the plugin, resolves to
+  // { touch([action, pointerId, x, y, width, height, pressure, buttons]),
+  //   send(ArrayBuffer), close() }; onclose runs if the server goes away,
+  //   onerror(error) for a touch or message the plugin didn't send
+  async scrcpyConnect (port, onclose, onerror) {
+    const post = (data) => this._postRequest('scrcpy', data)
+    await this._asyncToPromise((id) => this._postRequest('scrcpy', { connect: port }, id), 'scrcpy connect', DEFAULT_TIMEOUTS)
+    this._scrcpyClosed = onclose
+    this._scrcpyError = onerror
+    return {
+      touch: (touch) => post({ touch }),
+      send: (message) => post({ message }),
+      close: () => {
+        this._scrcpyClosed = null
+        post({ close: true })
+      }
     }
   }
 
@@ -196,6 +583,40 @@ export default class MpvClient {
     this.command('keypress', key);
   }
 
+  // keyboard, mouse and wheel handled in the plugin, without a round trip
+  // per event: opts {keys, mouse, wheel, ignore, notify} where mouse and
+  // wheel are 'mpv' (passed on as they are) or 'view' (drag pans a zoomed
+  // video, wheel zooms about the pointer), ignore lists key names left to
+  // the page, and notify posts 'input' events {kind: 'key', key} and
+  // {kind: 'view', zoom, pan_x, pan_y}. null turns it off.
+  nativeInput (opts) {
+    this._nativeKeys = !!opts?.keys
+    this._postRequest('configure', { input: opts || false })
+  }
+
+  // dynamic resolution: while rendering takes longer than budgetMs a
+  // frame, players render at down to minScale of the element's
+  // resolution and are upscaled; null turns it off
+  dynamicResolution (opts) {
+    this._postRequest('configure', {
+      dynamic_resolution: opts ? { budget_ms: opts.budgetMs, min_scale: opts.minScale } : false
+    })
+  }
+
+  // lets the module's quality governor lower this player's scalers and
+  // decoder settings when the machine cannot keep up, and small players
+  // always; get_stats reports the level per tile
+  adaptiveQuality (on) {
+    this._postRequest('configure', { adaptive_quality: !!on })
+  }
+
+  // caps the demuxer caches of all players in the process together at mb
+  // MiB, split by focus and visibility; 0 lifts the cap. get_stats reports
+  // each tile's share
+  cacheBudget (mb) {
+    this._postRequest('configure', { cache_budget_mb: mb })
+  }
+
   togglePlay (disable_rtsp) {
     if (this._props['idle-active']) {
       this.play()
@@ -233,8 +654,7 @@ export default class MpvClient {
 
   property (...args) {
     if (args.length === 1) {
-      const name = args[0]
-      return this._asyncToPromise((id) => this._postRequest('get_property_async', name, id), `get property ${name}`, DEFAULT_TIMEOUTS)
+      return this.getProperty(args[0])
     } else if (args.length > 1) {
       const name = args[0]
       const value = args[1]
@@ -245,6 +665,12 @@ export default class MpvClient {
     }
   }
 
+  // format: double, flag, int64 or string; node tree by default
+  getProperty (name, format) {
+    const data = format ? { name, format } : name
+    return this._asyncToPromise((id) => this._postRequest('get_property_async', data, id), `get property ${name}`, DEFAULT_TIMEOUTS)
+  }
+
   option (name, value, postFix) {
     if (postFix) {
       this._postRequest('set_option', { name: `${name}-${postFix}`, value: value.toString() })
@@ -336,23 +762,42 @@ export default class MpvClient {
     return 0
   }
 
+  // type is a format (double, flag, int64, string) or an options object:
+  // { format, rate, epsilon, diff }
   observeProperty (name, type, fn) {
     let id
+    let opts
     if (typeof type === 'function') {
       fn = type
+    } else if (typeof type === 'string') {
+      opts = { format: type }
+    } else if (type && typeof type === 'object') {
+      opts = { ...type }
+      // an undefined format would still be sent as a key
+      if (opts.format === undefined) {
+        delete opts.format
+      }
     }
   
     if (fn) {
       id = this._next_oid++;
       this._observers[id] = fn;
     }
-    this._postRequest('observe_property', name, id);
+    if (opts && opts.diff) {
+      this._diffBases[`${id || 0}/${name}`] = undefined
+    }
+    this._postRequest('observe_property', opts ? { name, ...opts } : name, id);
   }
 
   unobserveProperty (fn) {
     for (const id in this._observers) {
       if (this._observers[id] === fn) {
         delete this._observers[id];
+        for (const key in this._diffBases) {
+          if (key.startsWith(`${id}/`)) {
+            delete this._diffBases[key]
+          }
+        }
         this._postRequest('unobserve_property', id);
       }
     }
@@ -371,6 +816,9 @@ export default class MpvClient {
     this._observers = {}; // items of id: fn
     this._eventHandlers = {}
     this._hooks = []; // array of callbacks, id is index+1
+    this._frameStreams = {}; // items of id: fn
+    this._streamWaiters = {}; // items of stream name: [{ resolve, reject }]
+    this._decoder = new EventDecoder()
 
     this._props = {
       loading: false,
@@ -387,18 +835,18 @@ export default class MpvClient {
       'options/osd-duration': 1000
     }
   
-    this.registerEventHandler('property-change', e => {
-      if (e.data === undefined) {
-        return
-      }
-      const cb = this._observers[e.id];
-      if (cb) {
-        cb(e.name, e.data);
-      }
+    this._diffBases = {} // items of id/name: last full value
+    this.registerEventHandler('property-change', e => this._onPropertyChange(e))
 
-      if (!e.error) {
-        this._props[e.name] = e.data
+    this.registerEventHandler('property-patch', e => {
+      const key = `${e.id || 0}/${e.name}`
+      const data = applyPatch(this._diffBases[key], e.data)
+      if (data === undefined) {
+        // lost track, ask for the whole value
+        this._postRequest('resync_property', { id: e.id || 0, name: e.name })
+        return
       }
+      this._onPropertyChange({ ...e, event: 'property-change', data })
     })
 
     this.registerEventHandler('get-property-reply', e => {
@@ -413,6 +861,82 @@ export default class MpvClient {
       this._resolveResponse(e, e => e.result)
     })
 
+    this.registerEventHandler('batch-reply', e => {
+      this._resolveResponse(e, e => e.results)
+    })
+
+    this.registerEventHandler('request-stats', e => {
+      this._resolveResponse(e, e => e.stats)
+    })
+
+    this.registerEventHandler('stats', e => {
+      this._resolveResponse(e, ({ stats, trace }) => trace === undefined ? { stats } : { stats, trace })
+    })
+
+    this.registerEventHandler('log-reply', e => {
+      this._resolveResponse(e, ({ lines, dropped, pending }) => ({ lines, dropped, pending }))
+    })
+
+    this.registerEventHandler('log-ready', () => {
+      this._logReady?.()
+    })
+
+    this.registerEventHandler('thumbnail', e => {
+      this._resolveResponse(e, ({ time, width, height, data }) => ({ time, width, height, data }))
+    })
+
+    this.registerEventHandler('frame', e => {
+      const frame = ({ width, height, format, data }) => ({ width, height, format, data })
+      const stream = this._frameStreams[e.id]
+      if (stream) {
+        stream(frame(e))
+      } else {
+        this._resolveResponse(e, frame)
+      }
+    })
+
+    this.registerEventHandler('screenshot', e => {
+      const stream = this._frameStreams[e.id]
+      if (stream) {
+        stream(e)
+      } else {
+        this._resolveResponse(e, ({ width, height, format, data, file }) => ({ width, height, format, data, file }))
+      }
+    })
+
+    this.registerEventHandler('stream-push-reply', e => {
+      this._resolveResponse(e, ({ written, free }) => ({ written, free }))
+    })
+
+    this.registerEventHandler('stream-drain', e => {
+      for (const { resolve } of (this._streamWaiters[e.stream] || []).splice(0)) {
+        resolve()
+      }
+    })
+
+    this.registerEventHandler('stream-closed', e => {
+      for (const { reject } of (this._streamWaiters[e.stream] || []).splice(0)) {
+        reject(new Error(`stream ${e.stream} closed`))
+      }
+      delete this._streamWaiters[e.stream]
+    })
+
+    this.registerEventHandler('scrcpy-reply', e => {
+      if (!e.id) {
+        // touch and send don't wait for replies, only errors come back
+        const onerror = this._scrcpyError
+        onerror ? onerror(e.error) : console.warn('scrcpy:', e.error)
+        return
+      }
+      this._resolveResponse(e, ({ connected }) => connected)
+    })
+
+    this.registerEventHandler('scrcpy-closed', () => {
+      const onclose = this._scrcpyClosed
+      this._scrcpyClosed = null
+      onclose?.()
+    })
+
     this.registerEventHandler('hook', e => {
       const self = this
       let state = 0; // 0:initial, 1:deferred, 2:continued
@@ -439,8 +963,16 @@ export default class MpvClient {
       return state === 0 ? do_cont() : true;
     })
 
+    this._postRequest('configure', { batch_events: true, binary_events: true })
+
     observedProperties.forEach(name => {
-      this.observeProperty(name)
+      const format = observeFormats[name]
+      const limits = observeLimits[name]
+      if (observeDiffs.includes(name)) {
+        this.observeProperty(name, { diff: true })
+      } else {
+        this.observeProperty(name, format || limits ? { ...limits, ...(format && { format }) } : undefined)
+      }
     })
 
     this.profile('init')
@@ -448,6 +980,25 @@ export default class MpvClient {
     // this.option('log-file', logPath)
   }
 
+  _onPropertyChange (e) {
+    const key = `${e.id || 0}/${e.name}`
+    if (key in this._diffBases) {
+      this._diffBases[key] = e.data
+    }
+
+    if (e.data === undefined) {
+      return
+    }
+    const cb = this._observers[e.id];
+    if (cb) {
+      cb(e.name, e.data);
+    }
+
+    if (!e.error) {
+      this._props[e.name] = e.data
+    }
+  }
+
   _asyncToPromise (fn, hint, timeouts) {
     return new Promise((resolve, reject) => {
       const id = this._next_gid++;
@@ -474,7 +1025,11 @@ export default class MpvClient {
   }
 
   _postRequest (type, data, id) {
-    this.$el.postMessage({ type, data, id });
+    const request = { op: requestOps[type], data, id }
+    if (this.tile !== undefined) {
+      request.tile = this.tile
+    }
+    this.$el.postMessage(request);
   }
 }
 
@@ -55,6 +55,17 @@ export default class XPlayBar extends LitElement {
     transform: scale(1);
   }
 
+  .bar-preview {
+    position: absolute;
+    left: 0px;
+    top: -120px;
+    width: 160px;
+    border-radius: 4px;
+    background-color: #000;
+    pointer-events: none;
+    z-index: 2;
+  }
+
   .bar-time {
     position: absolute;
     left: 0px;
@@ -78,6 +89,7 @@ export default class XPlayBar extends LitElement {
     idle: { type: Boolean },
     timePos: { type: Number },
     duration: { type: Number },
+    preview: { type: Object },
     _showTimeAnchor: { type: Boolean, state: true },
   }
 
@@ -87,6 +99,7 @@ export default class XPlayBar extends LitElement {
     this.idle = true
     this.timePos = 0
     this.duration = 0
+    this.preview = null
     this._showTimeAnchor = false
 
     this.addEventListener('mousedown', () => {
@@ -109,6 +122,13 @@ export default class XPlayBar extends LitElement {
         playedBarTimeEl.style.left = `${tx - (time >= 3600 ? 25 : 20)}px`;
         playedBarTimeEl.innerText = formatSeconds(time);
         this._showTimeAnchor = true
+
+        const previewEl = this.renderRoot.querySelector('.bar-preview')
+        previewEl.style.left = `${Math.max(tx - 80, 0)}px`;
+        previewEl.style.top = `${-28 - previewEl.offsetHeight}px`;
+        if (!this.idle) {
+          this.dispatchEvent(new CustomEvent('preview-request', { detail: time, bubbles: true, composed: true, }))
+        }
       }
     })
 
@@ -125,6 +145,7 @@ export default class XPlayBar extends LitElement {
     const playedPercentage = ((this.duration > 0 ? (this.timePos + (this.duration > duration_fix_thres ? duration_fix_delta : 0) >= this.duration ? 1 : this.timePos / this.duration) : 0) * 100)
 
     return html`
+      <canvas class="bar-preview" style=${styleMap({ opacity: this.preview && this._showTimeAnchor ? 1 : 0 })}></canvas>
       <div class="bar-time" style=${styleMap({ opacity: this.duration <= 0 || !this._showTimeAnchor ? 0 : 1 })}>00:00</div>
 
       <div class="bar">
@@ -135,6 +156,16 @@ export default class XPlayBar extends LitElement {
     `
   }
 
+  updated (changed) {
+    if (changed.has('preview') && this.preview) {
+      const { width, height, data } = this.preview
+      const canvas = this.renderRoot.querySelector('.bar-preview')
+      canvas.width = width
+      canvas.height = height
+      canvas.getContext('2d').putImageData(new ImageData(new Uint8ClampedArray(data), width, height), 0, 0)
+    }
+  }
+
   thumbMove = (e) => {
     if (this.duration > 0) {
       this.timePos = this.calcMouseTimePercentage(e) * this.duration
@@ -38,8 +38,9 @@ export default class ControlClient {
 
   keyboardEnabled = false
 
-  constructor (ws, props, el) {
-    this.ws = ws
+  // transport is the plugin's control connection from scrcpyConnect()
+  constructor (transport, props, el) {
+    this.transport = transport
     this.props = props
     this.el = el
     this.el.style['pointer-events'] = 'unset'
@@ -53,9 +54,9 @@ export default class ControlClient {
   }
 
   close () {
-    if (this.ws) {
-      this.ws.close()
-      this.ws = null
+    if (this.transport) {
+      this.transport.close()
+      this.transport = null
 
       this.el.style['pointer-events'] = 'none'
       this.el.removeEventListener('mousedown', this.onInteraction)
@@ -89,8 +90,15 @@ export default class ControlClient {
   }
 
   sendMessage (message) {
-    if (this.ws) {
-      this.ws.send(message.toBuffer())
+    if (this.transport) {
+      // touches go compact, the plugin encodes them and coalesces moves
+      if (message instanceof TouchControlMessage) {
+        const { point, screenSize } = message.position
+        this.transport.touch([message.action, message.pointerId, point.x, point.y,
+          screenSize.width, screenSize.height, message.pressure, message.buttons])
+      } else {
+        this.transport.send(message.toBuffer())
+      }
       return true
     }
     return false
@@ -113,7 +121,7 @@ export default class ControlClient {
   }
 
   isOpen () {
-    return !!this.ws
+    return !!this.transport
   }
 
   onKey (e) {
@@ -135,6 +135,9 @@ export default class XVideo extends LitElement {
   static properties = {
     enableKey: { type: Boolean, attribute: 'enable-key' },
     enableCrop: { type: Boolean, attribute: 'enable-crop' },
+    nativeInput: { type: Boolean, attribute: 'native-input' },
+    renderBudget: { type: Number, attribute: 'render-budget' },
+    adaptiveQuality: { type: Boolean, attribute: 'adaptive-quality' },
     showInfo: { type: String, reflect: true, attribute: 'show-info' },
     control: { type: Boolean },
     autoHideControl: { type: Boolean, attribute: 'auto-hide-control' },
@@ -264,6 +267,21 @@ export default class XVideo extends LitElement {
         break
       }
 
+      case 'native-input': {
+        this._updateNativeInput()
+        break
+      }
+
+      case 'render-budget': {
+        this._updateResolution()
+        break
+      }
+
+      case 'adaptive-quality': {
+        this._updateQuality()
+        break
+      }
+
       case 'src': {
         if (_old && !value) {
           this.stop()
@@ -406,6 +424,7 @@ export default class XVideo extends LitElement {
       @next-frame=${this._handleNextFrame}
       @repeat-mode=${this._handleRepeatMode}
       @timepos-change=${this._handleTimeposChange}
+      @preview-request=${this._handlePreviewRequest}
       @volume-change=${this._handleVolumeChange}
       @mute-change=${this._handleMuteChange}
       @speed-change=${this._handleSpeedChange}
@@ -475,9 +494,27 @@ export default class XVideo extends LitElement {
   
       if (each) {
         this._controlBar.screenshotting = !this._controlBar.screenshotting
+        // every frame is encoded and saved by the plugin's workers, frames
+        // they can't keep up with are dropped instead of stalling playback
+        this._stopBurst()
+        if (this._controlBar.screenshotting) {
+          this._burstStop = this._mpv.screenshotBurst({ save: true }, e => {
+            if (e.error) {
+              console.warn(`screenshot: ${e.error}`)
+            }
+          })
+        }
+        return
       }
       
-      return this.command('osd-auto', 'screenshot', (each ? 'each-frame+' : '') + (subtitles ? 'subtitles' : 'video'))
+      return this.command('osd-auto', 'screenshot', subtitles ? 'subtitles' : 'video')
+    }
+  }
+
+  _stopBurst () {
+    if (this._burstStop) {
+      this._burstStop()
+      this._burstStop = null
     }
   }
 
@@ -539,12 +576,14 @@ export default class XVideo extends LitElement {
     }
 
     if (this._mpv) {
-      const ev = e.data
+      const events = this._mpv.unpack(e.data)
 
-      this._mpv.onMessage(ev)
+      events.forEach(ev => this._mpv.onMessage(ev))
   
-      if (dispatchEvents.indexOf(ev.event >= 0)) {
-        this.dispatchEvent(new CustomEvent(ev.event, { detail: ev, bubbles: true, composed: true, }))
+      for (const ev of events) {
+        if (dispatchEvents.indexOf(ev.event >= 0)) {
+          this.dispatchEvent(new CustomEvent(ev.event, { detail: ev, bubbles: true, composed: true, }))
+        }
       }
     }
   }
@@ -552,22 +591,19 @@ export default class XVideo extends LitElement {
   _onPropertyChangeDefault (name, value) {
     switch (name) {
       case 'metadata': {
-        // scrcpy return a tcp/websocket server port
-        // client connect this port to send control message to scrcpy
+        // scrcpy return a tcp server port for control messages, the plugin
+        // holds the connection
         if (value?.['scrcpy_control_port']) {
           const port = parseInt(value['scrcpy_control_port'])
-          const ws = new WebSocket(`ws://127.0.0.1:${port}`)
-  
-          ws.addEventListener('error', () => {
-            this._closeScrcpy()
-          })
-          ws.addEventListener('open', () => {
-            this._scrcpyClient = new ControlClient(ws, this._mpv._props, this._mpv.$el)
+          this._mpv.scrcpyConnect(port, () => this._closeScrcpy()).then((transport) => {
+            this._scrcpyClient = new ControlClient(transport, this._mpv._props, this._mpv.$el)
             this.scrcpy = true
             this._controlBar.scrcpy = true
             this._autoHiderHandler.stop()
             this._updateLocalDetection()
             this.dispatchEvent(new CustomEvent('scrcpy-connect', { detail: this._scrcpyClient, bubbles: true, composed: true }))
+          }, () => {
+            this._closeScrcpy()
           })
         }
         break
@@ -744,6 +780,18 @@ export default class XVideo extends LitElement {
     this.seekPercent(e.detail)
   }
 
+  // seek bar hover: a frame from the plugin's preview player, never a
+  // seek on this one
+  _handlePreviewRequest (e) {
+    e.stopPropagation()
+    if (!this._mpv || !this.path || this.live) {
+      return
+    }
+    this._mpv.thumbnail(this.path, e.detail)
+      .then(thumbnail => { this._controlBar.preview = thumbnail })
+      .catch(() => {})
+  }
+
   _handleVolumeChange (e) {
     e.stopPropagation()
     if (this._mpv) {
@@ -780,13 +828,16 @@ export default class XVideo extends LitElement {
 
     this._mpv.registerEventHandler('start-file', () => {
       this._loading = true
+      this._controlBar.preview = null
       this._controlBar.screenshotting = false
+      this._stopBurst()
       this.unauthed = false
     })
 
     this._mpv.registerEventHandler('end-file', () => {
       this._loading = false
       this._controlBar.screenshotting = false
+      this._stopBurst()
       this._closeScrcpy()
     })
 
@@ -794,6 +845,16 @@ export default class XVideo extends LitElement {
       this._loading = false
     })
 
+    this._mpv.registerEventHandler('input', e => {
+      if (e.kind === 'view' && this._zooming !== (e.zoom > 0)) {
+        this._zooming = e.zoom > 0
+        this.dispatchEvent(new CustomEvent('prop-change', { detail: { name: 'zooming', value: this._zooming }, bubbles: true, composed: true, }))
+      }
+    })
+    this._updateNativeInput()
+    this._updateResolution()
+    this._updateQuality()
+
     this._mpv.addHook('on_load_fail', 0, async ({ defer, cont }) => {
       const path = this.path
       const parts = parseURL(path)
@@ -838,6 +899,34 @@ export default class XVideo extends LitElement {
     })
   }
 
+  _updateNativeInput () {
+    if (!this._mpv) {
+      return
+    }
+    this._mpv.nativeInput(this.nativeInput ? {
+      keys: true,
+      mouse: 'view',
+      wheel: 'view',
+      notify: true
+    } : null)
+  }
+
+  // render-budget, ms a frame: renders below the element's resolution
+  // while mpv takes longer than that
+  _updateResolution () {
+    if (!this._mpv) {
+      return
+    }
+    this._mpv.dynamicResolution(this.renderBudget > 0 ? { budgetMs: this.renderBudget } : null)
+  }
+
+  _updateQuality () {
+    if (!this._mpv) {
+      return
+    }
+    this._mpv.adaptiveQuality(this.adaptiveQuality)
+  }
+
   _closeScrcpy () {
     if (this._scrcpyClient) {
       this._scrcpyClient.close()